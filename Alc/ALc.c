@@ -36,6 +36,7 @@
 #include "alAuxEffectSlot.h"
 #include "alError.h"
 #include "bformatdec.h"
+#include "trace.h"
 #include "alu.h"
 
 #include "compat.h"
@@ -155,6 +156,7 @@ static const ALCfunction alcFunctions[] = {
     DECL(alcLoopbackOpenDeviceSOFT),
     DECL(alcIsRenderFormatSupportedSOFT),
     DECL(alcRenderSamplesSOFT),
+    DECL(alcRenderSamplesPlanarSOFT),
 
     DECL(alcDevicePauseSOFT),
     DECL(alcDeviceResumeSOFT),
@@ -164,6 +166,11 @@ static const ALCfunction alcFunctions[] = {
 
     DECL(alcGetInteger64vSOFT),
 
+    DECL(alcDumpTraceSOFT),
+
+    DECL(alcCaptureMapSamplesSOFT),
+    DECL(alcCaptureCommitSamplesSOFT),
+
     DECL(alEnable),
     DECL(alDisable),
     DECL(alIsEnabled),
@@ -292,6 +299,15 @@ static const ALCfunction alcFunctions[] = {
     DECL(alGetBufferSamplesSOFT),
     DECL(alIsBufferFormatSupportedSOFT),
 
+    DECL(alBufferDataStatic),
+
+    DECL(alBufferCallbackSOFT),
+
+    DECL(alGetSourcesOffsetsSOFT),
+
+    DECL(alEventControlSOFT),
+    DECL(alEventCallbackSOFT),
+
     { NULL, NULL }
 };
 #undef DECL
@@ -328,6 +344,28 @@ static const ALCenums enumeration[] = {
     DECL(ALC_FORMAT_CHANNELS_SOFT),
     DECL(ALC_FORMAT_TYPE_SOFT),
 
+    DECL(ALC_OUTPUT_BUS_SOFT),
+    DECL(ALC_DRY_BUS_SOFT),
+    DECL(ALC_DRY_BUS_CHANNELS_SOFT),
+
+    DECL(ALC_MIX_TIME_TOTAL_SOFT),
+    DECL(ALC_MIX_TIME_PARAMS_SOFT),
+    DECL(ALC_MIX_TIME_VOICES_SOFT),
+    DECL(ALC_MIX_TIME_EFFECTS_SOFT),
+    DECL(ALC_MIX_TIME_DECODE_SOFT),
+    DECL(ALC_MIX_TIME_OUTPUT_SOFT),
+    DECL(ALC_MIX_LOAD_SOFT),
+    DECL(ALC_MIX_TIME_COUNT_SOFT),
+
+    DECL(ALC_BACKEND_XRUNS_SOFT),
+    DECL(ALC_BACKEND_JITTER_HISTOGRAM_SIZE_SOFT),
+    DECL(ALC_BACKEND_JITTER_HISTOGRAM_SOFT),
+
+    DECL(ALC_MEMORY_TAG_COUNT_SOFT),
+    DECL(ALC_MEMORY_LIVE_BYTES_SOFT),
+    DECL(ALC_MEMORY_PEAK_BYTES_SOFT),
+    DECL(ALC_MEMORY_TAG_NAME_SOFT),
+
     DECL(ALC_MONO_SOFT),
     DECL(ALC_STEREO_SOFT),
     DECL(ALC_QUAD_SOFT),
@@ -554,6 +592,9 @@ static const ALCenums enumeration[] = {
     DECL(AL_DEFERRED_UPDATES_SOFT),
     DECL(AL_GAIN_LIMIT_SOFT),
 
+    DECL(AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT),
+    DECL(AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT),
+
     DECL(AL_INVERSE_DISTANCE),
     DECL(AL_INVERSE_DISTANCE_CLAMPED),
     DECL(AL_LINEAR_DISTANCE),
@@ -713,10 +754,13 @@ static const ALchar alExtList[] =
     "AL_EXT_ALAW AL_EXT_BFORMAT AL_EXT_DOUBLE AL_EXT_EXPONENT_DISTANCE "
     "AL_EXT_FLOAT32 AL_EXT_IMA4 AL_EXT_LINEAR_DISTANCE AL_EXT_MCFORMATS "
     "AL_EXT_MULAW AL_EXT_MULAW_BFORMAT AL_EXT_MULAW_MCFORMATS AL_EXT_OFFSET "
-    "AL_EXT_source_distance_model AL_EXT_SOURCE_RADIUS AL_EXT_STEREO_ANGLES "
-    "AL_LOKI_quadriphonic AL_SOFT_block_alignment AL_SOFT_deferred_updates "
+    "AL_EXT_source_distance_model AL_EXT_SOURCE_RADIUS AL_EXT_STATIC_BUFFER "
+    "AL_EXT_STEREO_ANGLES "
+    "AL_LOKI_quadriphonic AL_SOFT_block_alignment AL_SOFTX_callback_buffer "
+    "AL_SOFT_deferred_updates AL_SOFTX_events "
     "AL_SOFT_direct_channels AL_SOFTX_gain_clamp_ex AL_SOFT_loop_points "
-    "AL_SOFT_MSADPCM AL_SOFT_source_latency AL_SOFT_source_length";
+    "AL_SOFT_MSADPCM AL_SOFT_source_latency AL_SOFT_source_length "
+    "AL_SOFTX_source_offsets";
 
 static ATOMIC(ALCenum) LastNullDeviceError = ATOMIC_INIT_STATIC(ALC_NO_ERROR);
 
@@ -727,6 +771,8 @@ static ATOMIC(ALCcontext*) GlobalContext = ATOMIC_INIT_STATIC(NULL);
 
 /* Mixing thread piority level */
 ALint RTPrioLevel;
+/* CPUs to run mixing threads on, as a bitmask (none set for any) */
+ALuint RTCpuMask[MAX_RT_CPUS/32];
 
 FILE *LogFile;
 #ifdef _DEBUG
@@ -760,7 +806,12 @@ static const ALCchar alcExtensionList[] =
     "ALC_ENUMERATE_ALL_EXT ALC_ENUMERATION_EXT ALC_EXT_CAPTURE "
     "ALC_EXT_DEDICATED ALC_EXT_disconnect ALC_EXT_EFX "
     "ALC_EXT_thread_local_context ALC_SOFTX_device_clock ALC_SOFT_HRTF "
-    "ALC_SOFT_loopback ALC_SOFT_pause_device";
+    "ALC_SOFT_loopback ALC_SOFTX_loopback_planar ALC_SOFTX_mix_timing "
+#ifdef ALSOFT_TRACE
+    "ALC_SOFTX_mix_trace "
+#endif
+    "ALC_SOFTX_backend_stats ALC_SOFTX_capture_map ALC_SOFTX_memory_stats "
+    "ALC_SOFT_pause_device";
 static const ALCint alcMajorVersion = 1;
 static const ALCint alcMinorVersion = 1;
 
@@ -908,6 +959,9 @@ static void alc_initconfig(void)
         TRACE("Supported backends: %s\n", buf);
     }
     ReadALConfig();
+#ifdef ALSOFT_TRACE
+    TraceInit();
+#endif
 
     str = getenv("__ALSOFT_SUSPEND_CONTEXT");
     if(str && *str)
@@ -979,6 +1033,48 @@ static void alc_initconfig(void)
 #endif
     ConfigValueInt(NULL, NULL, "rt-prio", &RTPrioLevel);
 
+    if(ConfigValueStr(NULL, NULL, "rt-cpus", &str))
+    {
+        const char *next = str;
+        char *end;
+
+        do {
+            long first, last;
+
+            str = next;
+            while(isspace(str[0]))
+                str++;
+            next = strchr(str, ',');
+
+            if(!str[0] || str[0] == ',')
+                continue;
+
+            /* Each entry is a CPU index, or an inclusive range like 4-7. */
+            first = last = strtol(str, &end, 10);
+            if(end != str && *end == '-')
+                last = strtol(end+1, &end, 10);
+            while(isspace(*end))
+                end++;
+            if(end == str || (*end && *end != ',') || first < 0 || last < first ||
+               last >= MAX_RT_CPUS)
+            {
+                WARN("Invalid rt-cpus entry \"%.*s\"\n",
+                     (int)(next ? (size_t)(next-str) : strlen(str)), str);
+                continue;
+            }
+            for(;first <= last;first++)
+                RTCpuMask[first>>5] |= 1u<<(first&31);
+        } while(next++);
+    }
+
+    if(GetConfigValueBool(NULL, NULL, "rt-mlock", 0))
+    {
+        TRACE("Locking mixer memory\n");
+        al_set_locked_tags((1u<<AllocTag_Device) | (1u<<AllocTag_Voice) |
+                           (1u<<AllocTag_Effect) | (1u<<AllocTag_Hrtf) |
+                           (1u<<AllocTag_Ring));
+    }
+
     aluInitMixer();
 
     str = getenv("ALSOFT_TRAP_ERROR");
@@ -1189,6 +1285,9 @@ static void alc_deinit_safe(void)
 {
     alc_cleanup();
 
+#ifdef ALSOFT_TRACE
+    TraceDeinit();
+#endif
     FreeHrtfs();
     FreeALConfig();
 
@@ -1422,12 +1521,15 @@ extern inline void UnlockContext(ALCcontext *context);
 
 void ALCdevice_Lock(ALCdevice *device)
 {
+    /* The span includes the wait for the mixer to let go of the lock. */
+    TRACE_BEGIN("BackendLock", 0);
     V0(device->Backend,lock)();
 }
 
 void ALCdevice_Unlock(ALCdevice *device)
 {
     V0(device->Backend,unlock)();
+    TRACE_END("BackendLock");
 }
 
 
@@ -1672,6 +1774,23 @@ static void alcSetError(ALCdevice *device, ALCenum errorCode)
 }
 
 
+/* ResetMixTiming
+ *
+ * Clears the mixer timing statistics, since timings from an old device
+ * configuration aren't comparable to a new one.
+ */
+static void ResetMixTiming(ALCdevice *device)
+{
+    MixTiming *timing = &device->Timing;
+
+    IncrementRef(&timing->Seq);
+    timing->Count = 0;
+    memset(timing->Stage, 0, sizeof(timing->Stage));
+    memset(&timing->Load, 0, sizeof(timing->Load));
+    timing->LastLoad = 0;
+    IncrementRef(&timing->Seq);
+}
+
 /* UpdateClockBase
  *
  * Updates the device's base clock time with however many samples have been
@@ -1699,6 +1818,8 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
     ALCuint oldFreq;
     FPUCtl oldMode;
     ALCsizei hrtf_id = -1;
+    ALCint hrtf_appattr = ALC_DONT_CARE_SOFT;
+    ALCuint quantum, threads;
     size_t size;
 
     // Check for attributes
@@ -1780,6 +1901,7 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
             if(attrList[attrIdx] == ALC_HRTF_SOFT)
             {
                 TRACE_ATTR(ALC_HRTF_SOFT, attrList[attrIdx + 1]);
+                hrtf_appattr = attrList[attrIdx + 1];
                 if(attrList[attrIdx + 1] == ALC_FALSE)
                     hrtf_appreq = Hrtf_Disable;
                 else if(attrList[attrIdx + 1] == ALC_TRUE)
@@ -1865,6 +1987,7 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
             if(attrList[attrIdx] == ALC_HRTF_SOFT)
             {
                 TRACE_ATTR(ALC_HRTF_SOFT, attrList[attrIdx + 1]);
+                hrtf_appattr = attrList[attrIdx + 1];
                 if(attrList[attrIdx + 1] == ALC_FALSE)
                     hrtf_appreq = Hrtf_Disable;
                 else if(attrList[attrIdx + 1] == ALC_TRUE)
@@ -1906,6 +2029,13 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
     if((device->Flags&DEVICE_RUNNING))
         return ALC_NO_ERROR;
 
+    device->Hrtf.AppRequest = hrtf_appattr;
+    device->Hrtf.AppId = hrtf_id;
+
+    ALCbackend_logStats(device->Backend);
+
+    aluStopMixWorkers(device);
+
     al_free(device->Uhj_Encoder);
     device->Uhj_Encoder = NULL;
 
@@ -1921,6 +2051,7 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
     device->RealOut.NumChannels = 0;
 
     UpdateClockBase(device);
+    ResetMixTiming(device);
 
     /*************************************************************************
      * Update device format request if HRTF is requested
@@ -2039,6 +2170,15 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
         device->Frequency, device->UpdateSize, device->NumUpdates
     );
 
+    device->MixQuantum = BUFFERSIZE;
+    if(ConfigValueUInt(al_string_get_cstr(device->DeviceName), NULL, "mix-quantum", &quantum) &&
+       quantum > 0)
+    {
+        /* Keep it a multiple of 4 for the SIMD mixers. */
+        device->MixQuantum = clampu((quantum+3)&~3u, 16, BUFFERSIZE);
+        TRACE("Mixing in blocks of %u samples\n", device->MixQuantum);
+    }
+
     aluInitRenderer(device, hrtf_id, hrtf_appreq, hrtf_userreq);
 
     /* Allocate extra channels for any post-filter output. */
@@ -2049,7 +2189,7 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
         size += ChannelsFromDevFmt(device->FmtChans) * sizeof(device->Dry.Buffer[0]);
     else if(device->FmtChans > DevFmtAmbi1 && device->FmtChans <= DevFmtAmbi3)
         size += 4 * sizeof(device->Dry.Buffer[0]);
-    device->Dry.Buffer = al_calloc(16, size);
+    device->Dry.Buffer = al_calloc_tag(AllocTag_Device, 16, size);
     if(!device->Dry.Buffer)
     {
         ERR("Failed to allocate "SZFMT" bytes for mix buffer\n", size);
@@ -2082,6 +2222,10 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
         device->FOAOut.NumChannels = device->Dry.NumChannels;
     }
 
+    if(ConfigValueUInt(al_string_get_cstr(device->DeviceName), NULL, "mix-threads", &threads) &&
+       threads > 1)
+        aluStartMixWorkers(device, (ALsizei)minu(threads, MAX_MIX_THREADS)-1);
+
     SetMixerFPUMode(&oldMode);
     if(device->DefaultSlot)
     {
@@ -2153,6 +2297,7 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
 
     if(!(device->Flags&DEVICE_PAUSED))
     {
+        ALCbackend_resetWakeup(device->Backend);
         if(V0(device->Backend,start)() == ALC_FALSE)
             return ALC_INVALID_DEVICE;
         device->Flags |= DEVICE_RUNNING;
@@ -2161,6 +2306,190 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
     return ALC_NO_ERROR;
 }
 
+/* Latency control
+ *
+ * Every half second, checks the backend's glitch counters. Any underrun, or
+ * late wakeups for more than 2% of the updates in that time, raises the number
+ * of updates mixed ahead by half (at least one). After 30 seconds without
+ * glitches, it's lowered by one. Backends that can't adjust in place are reset
+ * through UpdateDeviceParams with the new NumUpdates.
+ */
+#define LATENCY_CHECK_MSEC 500
+#define LATENCY_DECAY_CHECKS 60
+
+static ALuint GetGlitchCount(ALCbackend *backend, ALuint *late)
+{
+    *late = ATOMIC_LOAD(&backend->mStats.Counts[BackendStat_LateWakeup], almemory_order_relaxed);
+    return ATOMIC_LOAD(&backend->mStats.Counts[BackendStat_Underrun], almemory_order_relaxed);
+}
+
+static void ApplyLatencyTarget(ALCdevice *device, ALuint target)
+{
+    ALCint attrs[5];
+    ALCenum err;
+
+    almtx_lock(&device->BackendLock);
+    if(device->Connected && (device->Flags&DEVICE_RUNNING))
+    {
+        TRACE("Resetting device %p for %u updates\n", device, target);
+        V0(device->Backend,stop)();
+        device->Flags &= ~DEVICE_RUNNING;
+        device->NumUpdates = target;
+
+        /* Keep the HRTF the app asked for. Other attributes default to the
+         * device's current values. */
+        attrs[0] = ALC_HRTF_SOFT;
+        attrs[1] = device->Hrtf.AppRequest;
+        attrs[2] = ALC_HRTF_ID_SOFT;
+        attrs[3] = device->Hrtf.AppId;
+        attrs[4] = 0;
+
+        TRACE_BEGIN("UpdateDeviceParams", 0);
+        err = UpdateDeviceParams(device, attrs);
+        TRACE_END("UpdateDeviceParams");
+        if(err != ALC_NO_ERROR)
+        {
+            ERR("Failed to reset device for new latency: %s\n", alcGetString(NULL, err));
+            V0(device->Backend,lock)();
+            aluHandleDisconnect(device);
+            V0(device->Backend,unlock)();
+        }
+    }
+    almtx_unlock(&device->BackendLock);
+}
+
+static int LatencyControlProc(void *arg)
+{
+    ALCdevice *device = arg;
+    LatencyControl *ctl = &device->LatencyCtl;
+    ALCbackend *backend = device->Backend;
+    ALuint underruns, late, lastUnderruns, lastLate;
+    ALuint clean, updates;
+    ALboolean settle;
+    struct timespec ts;
+
+    althrd_setname(althrd_current(), "alsoft-latency");
+
+    lastUnderruns = GetGlitchCount(backend, &lastLate);
+    clean = 0;
+    settle = AL_FALSE;
+
+    almtx_lock(&ctl->Mutex);
+    while(!ctl->Kill)
+    {
+        ALuint target = ctl->Target;
+
+        if(altimespec_get(&ts, AL_TIME_UTC) != AL_TIME_UTC)
+            break;
+        ts.tv_nsec += LATENCY_CHECK_MSEC * 1000000l;
+        ts.tv_sec += ts.tv_nsec / 1000000000l;
+        ts.tv_nsec %= 1000000000l;
+        alcnd_timedwait(&ctl->Cond, &ctl->Mutex, &ts);
+        if(ctl->Kill) break;
+
+        underruns = GetGlitchCount(backend, &late);
+        almtx_lock(&device->BackendLock);
+        ALCbackend_logStats(backend);
+        almtx_unlock(&device->BackendLock);
+        if(settle)
+        {
+            /* Ignore any glitch from restarting the device. */
+            settle = AL_FALSE;
+            lastUnderruns = underruns;
+            lastLate = late;
+            continue;
+        }
+
+        updates = (ALuint)((ALuint64)device->Frequency * LATENCY_CHECK_MSEC / 1000 /
+                           maxu(device->UpdateSize, 1));
+        if(underruns != lastUnderruns || (late-lastLate)*50 > updates)
+        {
+            clean = 0;
+            target = minu(target + maxu(target/2, 1), ctl->MaxUpdates);
+        }
+        else if(++clean >= LATENCY_DECAY_CHECKS)
+        {
+            clean = 0;
+            target = maxu(target-1, ctl->MinUpdates);
+        }
+        lastUnderruns = underruns;
+        lastLate = late;
+
+        if(backend->mMixAheadInPlace)
+            ATOMIC_STORE(&backend->mMixAhead, target, almemory_order_relaxed);
+        if(target == ctl->Target)
+            continue;
+
+        TRACE("Changing device %p latency from %u to %u updates\n", device, ctl->Target,
+              target);
+        ctl->Target = target;
+        if(!backend->mMixAheadInPlace)
+        {
+            almtx_unlock(&ctl->Mutex);
+            ApplyLatencyTarget(device, target);
+            almtx_lock(&ctl->Mutex);
+            settle = AL_TRUE;
+        }
+    }
+    almtx_unlock(&ctl->Mutex);
+
+    return 0;
+}
+
+static void StartLatencyControl(ALCdevice *device, const char *devname)
+{
+    LatencyControl *ctl = &device->LatencyCtl;
+
+    ctl->Enabled = AL_FALSE;
+    if(!GetConfigValueBool(devname, NULL, "adaptive-latency", 0))
+        return;
+
+    ctl->MinUpdates = device->NumUpdates;
+    ctl->MaxUpdates = 16;
+    ConfigValueUInt(devname, NULL, "min-periods", &ctl->MinUpdates);
+    ConfigValueUInt(devname, NULL, "max-periods", &ctl->MaxUpdates);
+    ctl->MinUpdates = clampu(ctl->MinUpdates, 2, 16);
+    ctl->MaxUpdates = clampu(ctl->MaxUpdates, ctl->MinUpdates, 16);
+    ctl->Target = clampu(device->NumUpdates, ctl->MinUpdates, ctl->MaxUpdates);
+    device->NumUpdates = ctl->Target;
+    ctl->Kill = AL_FALSE;
+    /* Backends that honor it in place start out limited to the target, rather
+     * than filling as far ahead as they can. */
+    ATOMIC_STORE(&device->Backend->mMixAhead, ctl->Target, almemory_order_relaxed);
+
+    almtx_init(&ctl->Mutex, almtx_plain);
+    alcnd_init(&ctl->Cond);
+    if(althrd_create(&ctl->Thread, LatencyControlProc, device) != althrd_success)
+    {
+        ERR("Failed to start latency control thread\n");
+        alcnd_destroy(&ctl->Cond);
+        almtx_destroy(&ctl->Mutex);
+        return;
+    }
+    ctl->Enabled = AL_TRUE;
+    TRACE("Adaptive latency enabled, %u to %u updates\n", ctl->MinUpdates, ctl->MaxUpdates);
+}
+
+static void StopLatencyControl(ALCdevice *device)
+{
+    LatencyControl *ctl = &device->LatencyCtl;
+    int res;
+
+    if(!ctl->Enabled)
+        return;
+
+    almtx_lock(&ctl->Mutex);
+    ctl->Kill = AL_TRUE;
+    alcnd_signal(&ctl->Cond);
+    almtx_unlock(&ctl->Mutex);
+    althrd_join(ctl->Thread, &res);
+
+    alcnd_destroy(&ctl->Cond);
+    almtx_destroy(&ctl->Mutex);
+    ctl->Enabled = AL_FALSE;
+}
+
+
 /* FreeDevice
  *
  * Frees the device structure, and destroys any objects the app failed to
@@ -2168,12 +2497,25 @@ static ALCenum UpdateDeviceParams(ALCdevice *device, const ALCint *attrList)
  */
 static ALCvoid FreeDevice(ALCdevice *device)
 {
+    size_t live, peak;
+    ALsizei i;
+
     TRACE("%p\n", device);
 
+    for(i = 0;i < AllocTag_Count;i++)
+    {
+        al_get_alloc_stats(i, &live, &peak);
+        if(peak > 0)
+            TRACE("%s memory: "SZFMT" bytes live, "SZFMT" peak\n", al_get_alloc_tag_name(i),
+                  live, peak);
+    }
+
     V0(device->Backend,close)();
     DELETE_OBJ(device->Backend);
     device->Backend = NULL;
 
+    aluStopMixWorkers(device);
+
     almtx_destroy(&device->BackendLock);
 
     if(device->DefaultSlot)
@@ -2231,6 +2573,9 @@ static ALCvoid FreeDevice(ALCdevice *device)
     device->RealOut.Buffer = NULL;
     device->RealOut.NumChannels = 0;
 
+    al_free(device->CaptureStage.Buffer);
+    device->CaptureStage.Buffer = NULL;
+
     al_free(device);
 }
 
@@ -2332,6 +2677,15 @@ static ALvoid InitContext(ALCcontext *Context)
     Context->SpeedOfSound = SPEEDOFSOUNDMETRESPERSEC;
     ATOMIC_INIT(&Context->DeferUpdates, AL_FALSE);
 
+    ATOMIC_INIT(&Context->EnabledEvts, 0);
+    Context->EventsLostPending = 0;
+    ATOMIC_INIT(&Context->EventsLostTotal, 0);
+    alsem_init(&Context->EventSem, 0);
+    Context->EventThreadStarted = AL_FALSE;
+    almtx_init(&Context->EventCbLock, almtx_plain);
+    Context->EventCb = NULL;
+    Context->EventParam = NULL;
+
     Context->ExtensionList = alExtList;
 }
 
@@ -2386,6 +2740,15 @@ static void FreeContext(ALCcontext *context)
     }
     TRACE("Freed "SZFMT" listener property object%s\n", count, (count==1)?"":"s");
 
+    StopEventThrd(context);
+    if(ATOMIC_LOAD(&context->EventsLostTotal, almemory_order_relaxed) > 0)
+        WARN("(%p) Lost %u events from a full event queue\n", context,
+             ATOMIC_LOAD(&context->EventsLostTotal, almemory_order_relaxed));
+    ll_ringbuffer_free(context->AsyncEvents);
+    context->AsyncEvents = NULL;
+    alsem_destroy(&context->EventSem);
+    almtx_destroy(&context->EventCbLock);
+
     ALCdevice_DecRef(context->Device);
     context->Device = NULL;
 
@@ -2733,6 +3096,7 @@ static ALCsizei GetIntegerv(ALCdevice *device, ALCenum param, ALCsizei size, ALC
             case ALC_CAPTURE_SAMPLES:
             case ALC_FORMAT_CHANNELS_SOFT:
             case ALC_FORMAT_TYPE_SOFT:
+            case ALC_DRY_BUS_CHANNELS_SOFT:
                 alcSetError(NULL, ALC_INVALID_DEVICE);
                 return 0;
 
@@ -2749,7 +3113,8 @@ static ALCsizei GetIntegerv(ALCdevice *device, ALCenum param, ALCsizei size, ALC
         {
             case ALC_CAPTURE_SAMPLES:
                 almtx_lock(&device->BackendLock);
-                values[0] = V0(device->Backend,availableSamples)();
+                values[0] = V0(device->Backend,availableSamples)() +
+                            device->CaptureStage.Len - device->CaptureStage.Pos;
                 almtx_unlock(&device->BackendLock);
                 return 1;
 
@@ -2877,6 +3242,15 @@ static ALCsizei GetIntegerv(ALCdevice *device, ALCenum param, ALCsizei size, ALC
             values[0] = device->FmtType;
             return 1;
 
+        case ALC_DRY_BUS_CHANNELS_SOFT:
+            if(device->Type != Loopback)
+            {
+                alcSetError(device, ALC_INVALID_DEVICE);
+                return 0;
+            }
+            values[0] = device->Dry.NumChannels;
+            return 1;
+
         case ALC_MONO_SOURCES:
             values[0] = device->NumMonoSources;
             return 1;
@@ -2930,6 +3304,134 @@ ALC_API void ALC_APIENTRY alcGetIntegerv(ALCdevice *device, ALCenum param, ALCsi
     if(device) ALCdevice_DecRef(device);
 }
 
+static ALuint64 GetMixStatPercentile(const MixStat *stat, ALuint64 count, ALuint pct)
+{
+    ALuint64 target = (count*pct + 99) / 100;
+    ALuint64 total = 0;
+    ALuint i;
+
+    for(i = 0;i < MIXSTAT_BUCKETS;i++)
+    {
+        total += stat->Hist[i];
+        if(total >= target)
+        {
+            ALuint shift;
+            ALuint64 upper;
+            if(i < (1<<MIXSTAT_SUB_BITS))
+                return i;
+            /* Report the top of the bucket, so the result doesn't understate
+             * the percentile. */
+            shift = (i>>MIXSTAT_SUB_BITS) - 1;
+            upper = ((ALuint64)((1<<MIXSTAT_SUB_BITS) | (i&((1<<MIXSTAT_SUB_BITS)-1))) << shift) +
+                    ((U64(1)<<shift) - 1);
+            return minu64(upper, stat->Max);
+        }
+    }
+    return stat->Max;
+}
+
+/* Gets the min, avg, max, and 99th percentile of the given timing statistic.
+ * The load statistic additionally gets the load of the last update.
+ */
+static void GetMixTimingStat(ALCdevice *device, ALCenum pname, ALCsizei size, ALCint64SOFT *values)
+{
+    MixTiming *timing = &device->Timing;
+    ALCint64SOFT stats[5];
+    const MixStat *src;
+    MixStat stat;
+    ALuint64 count, last;
+    ALuint refcount;
+    ALsizei i;
+
+    switch(pname)
+    {
+        case ALC_MIX_TIME_PARAMS_SOFT: src = &timing->Stage[MixStage_Params]; break;
+        case ALC_MIX_TIME_VOICES_SOFT: src = &timing->Stage[MixStage_Voices]; break;
+        case ALC_MIX_TIME_EFFECTS_SOFT: src = &timing->Stage[MixStage_Effects]; break;
+        case ALC_MIX_TIME_DECODE_SOFT: src = &timing->Stage[MixStage_Decode]; break;
+        case ALC_MIX_TIME_OUTPUT_SOFT: src = &timing->Stage[MixStage_Output]; break;
+        case ALC_MIX_LOAD_SOFT: src = &timing->Load; break;
+        default: src = &timing->Stage[MixStage_Total]; break;
+    }
+
+    do {
+        while(((refcount=ReadRef(&timing->Seq))&1) != 0)
+            althrd_yield();
+        count = timing->Count;
+        last = timing->LastLoad;
+        stat = *src;
+    } while(refcount != ReadRef(&timing->Seq));
+
+    if(count == 0)
+        memset(stats, 0, sizeof(stats));
+    else
+    {
+        stats[0] = stat.Min;
+        stats[1] = stat.Sum / count;
+        stats[2] = stat.Max;
+        stats[3] = GetMixStatPercentile(&stat, count, 99);
+        stats[4] = last;
+    }
+
+    size = mini(size, (pname == ALC_MIX_LOAD_SOFT) ? 5 : 4);
+    for(i = 0;i < size;i++)
+        values[i] = stats[i];
+}
+
+/* Gets the backend's xrun counts or wakeup jitter histogram, which are
+ * available for playback and capture devices alike.
+ */
+static void GetBackendStats(ALCdevice *device, ALCenum pname, ALCsizei size, ALCint64SOFT *values)
+{
+    const BackendStats *stats = &device->Backend->mStats;
+    ALsizei i;
+
+    switch(pname)
+    {
+        case ALC_BACKEND_XRUNS_SOFT:
+            size = mini(size, BackendStat_Count);
+            for(i = 0;i < size;i++)
+                values[i] = ATOMIC_LOAD(&stats->Counts[i], almemory_order_relaxed);
+            break;
+
+        case ALC_BACKEND_JITTER_HISTOGRAM_SIZE_SOFT:
+            values[0] = BACKEND_JITTER_BUCKETS;
+            break;
+
+        case ALC_BACKEND_JITTER_HISTOGRAM_SOFT:
+            size = mini(size, BACKEND_JITTER_BUCKETS);
+            for(i = 0;i < size;i++)
+                values[i] = ATOMIC_LOAD(&stats->Jitter[i], almemory_order_relaxed);
+            break;
+    }
+}
+
+/* Gets the library-wide memory use for each allocation tag, which don't need
+ * a device.
+ */
+static void GetMemoryStats(ALCenum pname, ALCsizei size, ALCint64SOFT *values)
+{
+    size_t live, peak;
+    ALsizei i;
+
+    switch(pname)
+    {
+        case ALC_MEMORY_TAG_COUNT_SOFT:
+            values[0] = AllocTag_Count;
+            break;
+
+        case ALC_MEMORY_LIVE_BYTES_SOFT:
+        case ALC_MEMORY_PEAK_BYTES_SOFT:
+            size = mini(size, AllocTag_Count);
+            for(i = 0;i < size;i++)
+            {
+                al_get_alloc_stats(i, &live, &peak);
+                values[i] = (pname == ALC_MEMORY_LIVE_BYTES_SOFT) ? live : peak;
+            }
+            break;
+    }
+}
+
 ALC_API void ALC_APIENTRY alcGetInteger64vSOFT(ALCdevice *device, ALCenum pname, ALCsizei size, ALCint64SOFT *values)
 {
     ALCint *ivals;
@@ -2938,6 +3440,13 @@ ALC_API void ALC_APIENTRY alcGetInteger64vSOFT(ALCdevice *device, ALCenum pname,
     VerifyDevice(&device);
     if(size <= 0 || values == NULL)
         alcSetError(device, ALC_INVALID_VALUE);
+    else if(device && (pname == ALC_BACKEND_XRUNS_SOFT ||
+                       pname == ALC_BACKEND_JITTER_HISTOGRAM_SIZE_SOFT ||
+                       pname == ALC_BACKEND_JITTER_HISTOGRAM_SOFT))
+        GetBackendStats(device, pname, size, values);
+    else if(pname == ALC_MEMORY_TAG_COUNT_SOFT || pname == ALC_MEMORY_LIVE_BYTES_SOFT ||
+            pname == ALC_MEMORY_PEAK_BYTES_SOFT)
+        GetMemoryStats(pname, size, values);
     else if(!device || device->Type == Capture)
     {
         ivals = malloc(size * sizeof(ALCint));
@@ -3048,6 +3557,25 @@ ALC_API void ALC_APIENTRY alcGetInteger64vSOFT(ALCdevice *device, ALCenum pname,
                 }
                 break;
 
+            case ALC_MIX_TIME_TOTAL_SOFT:
+            case ALC_MIX_TIME_PARAMS_SOFT:
+            case ALC_MIX_TIME_VOICES_SOFT:
+            case ALC_MIX_TIME_EFFECTS_SOFT:
+            case ALC_MIX_TIME_DECODE_SOFT:
+            case ALC_MIX_TIME_OUTPUT_SOFT:
+            case ALC_MIX_LOAD_SOFT:
+                GetMixTimingStat(device, pname, size, values);
+                break;
+
+            case ALC_MIX_TIME_COUNT_SOFT:
+                do {
+                    while(((refcount=ReadRef(&device->Timing.Seq))&1) != 0)
+                        althrd_yield();
+                    basecount = device->Timing.Count;
+                } while(refcount != ReadRef(&device->Timing.Seq));
+                *values = basecount;
+                break;
+
             default:
                 ivals = malloc(size * sizeof(ALCint));
                 size = GetIntegerv(device, pname, size, ivals);
@@ -3174,7 +3702,7 @@ ALC_API ALCcontext* ALC_APIENTRY alcCreateContext(ALCdevice *device, const ALCin
 
     ATOMIC_STORE(&device->LastError, ALC_NO_ERROR);
 
-    ALContext = al_calloc(16, sizeof(ALCcontext)+sizeof(ALlistener));
+    ALContext = al_calloc_tag(AllocTag_Context, 16, sizeof(ALCcontext)+sizeof(ALlistener));
     if(ALContext)
     {
         InitRef(&ALContext->ref, 1);
@@ -3184,14 +3712,23 @@ ALC_API ALCcontext* ALC_APIENTRY alcCreateContext(ALCdevice *device, const ALCin
 
         ALContext->VoiceCount = 0;
         ALContext->MaxVoices = 256;
-        ALContext->Voices = al_calloc(16, ALContext->MaxVoices * sizeof(ALContext->Voices[0]));
+        ALContext->Voices = al_calloc_tag(AllocTag_Voice, 16,
+            ALContext->MaxVoices * sizeof(ALContext->Voices[0])
+        );
+        /* Room for a buffer completion and a state change from every source
+         * in one update. */
+        ALContext->AsyncEvents = ll_ringbuffer_create(maxu(device->SourcesMax, 32)*2,
+                                                      sizeof(AsyncEvent));
     }
-    if(!ALContext || !ALContext->Voices)
+    if(!ALContext || !ALContext->Voices || !ALContext->AsyncEvents)
     {
         almtx_unlock(&device->BackendLock);
 
         if(ALContext)
         {
+            ll_ringbuffer_free(ALContext->AsyncEvents);
+            ALContext->AsyncEvents = NULL;
+
             al_free(ALContext->Voices);
             ALContext->Voices = NULL;
 
@@ -3204,10 +3741,16 @@ ALC_API ALCcontext* ALC_APIENTRY alcCreateContext(ALCdevice *device, const ALCin
         return NULL;
     }
 
-    if((err=UpdateDeviceParams(device, attrList)) != ALC_NO_ERROR)
+    TRACE_BEGIN("UpdateDeviceParams", 0);
+    err = UpdateDeviceParams(device, attrList);
+    TRACE_END("UpdateDeviceParams");
+    if(err != ALC_NO_ERROR)
     {
         almtx_unlock(&device->BackendLock);
 
+        ll_ringbuffer_free(ALContext->AsyncEvents);
+        ALContext->AsyncEvents = NULL;
+
         al_free(ALContext->Voices);
         ALContext->Voices = NULL;
 
@@ -3389,7 +3932,7 @@ ALC_API ALCdevice* ALC_APIENTRY alcOpenDevice(const ALCchar *deviceName)
     ))
         deviceName = NULL;
 
-    device = al_calloc(16, sizeof(ALCdevice)+sizeof(ALeffectslot));
+    device = al_calloc_tag(AllocTag_Device, 16, sizeof(ALCdevice)+sizeof(ALeffectslot));
     if(!device)
     {
         alcSetError(NULL, ALC_OUT_OF_MEMORY);
@@ -3407,10 +3950,13 @@ ALC_API ALCdevice* ALC_APIENTRY alcOpenDevice(const ALCchar *deviceName)
     device->Uhj_Encoder = NULL;
     VECTOR_INIT(device->Hrtf.List);
     AL_STRING_INIT(device->Hrtf.Name);
+    device->Hrtf.AppRequest = ALC_DONT_CARE_SOFT;
+    device->Hrtf.AppId = -1;
     device->Render_Mode = NormalRender;
     AL_STRING_INIT(device->DeviceName);
     device->Dry.Buffer = NULL;
     device->Dry.NumChannels = 0;
+    device->MixQuantum = BUFFERSIZE;
     device->FOAOut.Buffer = NULL;
     device->FOAOut.NumChannels = 0;
     device->RealOut.Buffer = NULL;
@@ -3551,6 +4097,8 @@ ALC_API ALCdevice* ALC_APIENTRY alcOpenDevice(const ALCchar *deviceName)
         return NULL;
     }
     almtx_init(&device->BackendLock, almtx_plain);
+    /* The backend's mixing or capture thread gets its trace ring now. */
+    TRACE_RESERVE_RINGS(1);
 
     if(ConfigValueStr(al_string_get_cstr(device->DeviceName), NULL, "ambi-format", &fmt))
     {
@@ -3591,6 +4139,8 @@ ALC_API ALCdevice* ALC_APIENTRY alcOpenDevice(const ALCchar *deviceName)
         } while(!ATOMIC_COMPARE_EXCHANGE_WEAK(ALCdevice*, &DeviceList, &head, device));
     }
 
+    StartLatencyControl(device, al_string_get_cstr(device->DeviceName));
+
     TRACE("Created device %p, \"%s\"\n", device, al_string_get_cstr(device->DeviceName));
     return device;
 }
@@ -3616,6 +4166,8 @@ ALC_API ALCboolean ALC_APIENTRY alcCloseDevice(ALCdevice *device)
         UnlockLists();
         return ALC_FALSE;
     }
+    /* The latency controller takes the backend lock, so stop it first. */
+    StopLatencyControl(device);
     almtx_lock(&device->BackendLock);
 
     origdev = device;
@@ -3673,7 +4225,7 @@ ALC_API ALCdevice* ALC_APIENTRY alcCaptureOpenDevice(const ALCchar *deviceName,
     if(deviceName && (!deviceName[0] || strcasecmp(deviceName, alcDefaultName) == 0 || strcasecmp(deviceName, "openal-soft") == 0))
         deviceName = NULL;
 
-    device = al_calloc(16, sizeof(ALCdevice));
+    device = al_calloc_tag(AllocTag_Device, 16, sizeof(ALCdevice));
     if(!device)
     {
         alcSetError(NULL, ALC_OUT_OF_MEMORY);
@@ -3687,10 +4239,13 @@ ALC_API ALCdevice* ALC_APIENTRY alcCaptureOpenDevice(const ALCchar *deviceName,
 
     VECTOR_INIT(device->Hrtf.List);
     AL_STRING_INIT(device->Hrtf.Name);
+    device->Hrtf.AppRequest = ALC_DONT_CARE_SOFT;
+    device->Hrtf.AppId = -1;
 
     AL_STRING_INIT(device->DeviceName);
     device->Dry.Buffer = NULL;
     device->Dry.NumChannels = 0;
+    device->MixQuantum = BUFFERSIZE;
     device->FOAOut.Buffer = NULL;
     device->FOAOut.NumChannels = 0;
     device->RealOut.Buffer = NULL;
@@ -3738,6 +4293,8 @@ ALC_API ALCdevice* ALC_APIENTRY alcCaptureOpenDevice(const ALCchar *deviceName,
         return NULL;
     }
     almtx_init(&device->BackendLock, almtx_plain);
+    /* The backend's mixing or capture thread gets its trace ring now. */
+    TRACE_RESERVE_RINGS(1);
 
     {
         ALCdevice *head = ATOMIC_LOAD(&DeviceList);
@@ -3794,6 +4351,7 @@ ALC_API void ALC_APIENTRY alcCaptureStart(ALCdevice *device)
             alcSetError(device, ALC_INVALID_DEVICE);
         else if(!(device->Flags&DEVICE_RUNNING))
         {
+            ALCbackend_resetWakeup(device->Backend);
             if(V0(device->Backend,start)())
                 device->Flags |= DEVICE_RUNNING;
             else
@@ -3818,6 +4376,7 @@ ALC_API void ALC_APIENTRY alcCaptureStop(ALCdevice *device)
         if((device->Flags&DEVICE_RUNNING))
             V0(device->Backend,stop)();
         device->Flags &= ~DEVICE_RUNNING;
+        ALCbackend_logStats(device->Backend);
         almtx_unlock(&device->BackendLock);
     }
 
@@ -3831,10 +4390,136 @@ ALC_API void ALC_APIENTRY alcCaptureSamples(ALCdevice *device, ALCvoid *buffer,
     else
     {
         ALCenum err = ALC_INVALID_VALUE;
+        ALCuint staged;
+
+        almtx_lock(&device->BackendLock);
+        staged = device->CaptureStage.Len - device->CaptureStage.Pos;
+        if(samples >= 0 && V0(device->Backend,availableSamples)()+staged >= (ALCuint)samples)
+        {
+            err = ALC_NO_ERROR;
+            if(staged > 0)
+            {
+                ALsizei frame_size = FrameSizeFromDevFmt(device->FmtChans, device->FmtType);
+                ALCuint todo = minu(staged, samples);
+
+                memcpy(buffer, (char*)device->CaptureStage.Buffer +
+                               device->CaptureStage.Pos*frame_size, todo*frame_size);
+                device->CaptureStage.Pos += todo;
+                buffer = (char*)buffer + todo*frame_size;
+                samples -= todo;
+            }
+            if(samples > 0)
+                err = V(device->Backend,captureSamples)(buffer, samples);
+        }
+        almtx_unlock(&device->BackendLock);
+
+        if(err != ALC_NO_ERROR)
+            alcSetError(device, err);
+    }
+    if(device) ALCdevice_DecRef(device);
+}
+
+/* alcCaptureMapSamplesSOFT
+ *
+ * Provides the captured samples in up to two regions, to be read in place.
+ * They remain valid until committed, or until capture is stopped.
+ */
+ALC_API void ALC_APIENTRY alcCaptureMapSamplesSOFT(ALCdevice *device, ALCvoid **buffer1, ALCsizei *samples1, ALCvoid **buffer2, ALCsizei *samples2)
+{
+    if(!VerifyDevice(&device) || device->Type != Capture)
+        alcSetError(device, ALC_INVALID_DEVICE);
+    else if(!buffer1 || !samples1 || !buffer2 || !samples2)
+        alcSetError(device, ALC_INVALID_VALUE);
+    else
+    {
+        ALCbackend *backend = device->Backend;
+        ALsizei frame_size = FrameSizeFromDevFmt(device->FmtChans, device->FmtType);
+        ALCenum err = ALC_NO_ERROR;
+        ALCuint avail;
+
+        *buffer1 = *buffer2 = NULL;
+        *samples1 = *samples2 = 0;
+
+        almtx_lock(&device->BackendLock);
+        /* Some backends only pull in what was captured when asked for what's
+         * available, so this needs to be done even with a mappable ring.
+         */
+        avail = V0(backend,availableSamples)();
+        if(backend->mCaptureRing)
+        {
+            ll_ringbuffer_data_t vec[2];
+
+            ll_ringbuffer_get_read_vector(backend->mCaptureRing, vec);
+            *buffer1 = vec[0].buf;
+            *samples1 = (ALCsizei)vec[0].len;
+            *buffer2 = vec[1].buf;
+            *samples2 = (ALCsizei)vec[1].len;
+        }
+        else
+        {
+            /* Otherwise, copy what's available into the stage once what was
+             * there is committed.
+             */
+            if(device->CaptureStage.Pos == device->CaptureStage.Len && avail > 0)
+            {
+                device->CaptureStage.Pos = device->CaptureStage.Len = 0;
+                if(avail > device->CaptureStage.Size)
+                {
+                    al_free(device->CaptureStage.Buffer);
+                    device->CaptureStage.Buffer = al_malloc_tag(AllocTag_Device, 16,
+                                                                avail*frame_size);
+                    device->CaptureStage.Size = device->CaptureStage.Buffer ? avail : 0;
+                }
+                if(!device->CaptureStage.Buffer)
+                    err = ALC_OUT_OF_MEMORY;
+                else if((err=V(backend,captureSamples)(device->CaptureStage.Buffer, avail)) == ALC_NO_ERROR)
+                    device->CaptureStage.Len = avail;
+            }
+            if(device->CaptureStage.Pos < device->CaptureStage.Len)
+            {
+                *buffer1 = (char*)device->CaptureStage.Buffer +
+                           device->CaptureStage.Pos*frame_size;
+                *samples1 = device->CaptureStage.Len - device->CaptureStage.Pos;
+            }
+        }
+        almtx_unlock(&device->BackendLock);
+
+        if(err != ALC_NO_ERROR)
+            alcSetError(device, err);
+    }
+    if(device) ALCdevice_DecRef(device);
+}
+
+/* alcCaptureCommitSamplesSOFT
+ *
+ * Releases the given number of samples from the start of the mapped regions.
+ */
+ALC_API void ALC_APIENTRY alcCaptureCommitSamplesSOFT(ALCdevice *device, ALCsizei samples)
+{
+    if(!VerifyDevice(&device) || device->Type != Capture)
+        alcSetError(device, ALC_INVALID_DEVICE);
+    else
+    {
+        ALCbackend *backend = device->Backend;
+        ALCenum err = ALC_INVALID_VALUE;
 
         almtx_lock(&device->BackendLock);
-        if(samples >= 0 && V0(device->Backend,availableSamples)() >= (ALCuint)samples)
-            err = V(device->Backend,captureSamples)(buffer, samples);
+        if(samples >= 0)
+        {
+            if(backend->mCaptureRing)
+            {
+                if((size_t)samples <= ll_ringbuffer_read_space(backend->mCaptureRing))
+                {
+                    ll_ringbuffer_read_advance(backend->mCaptureRing, samples);
+                    err = ALC_NO_ERROR;
+                }
+            }
+            else if((ALCuint)samples <= device->CaptureStage.Len-device->CaptureStage.Pos)
+            {
+                device->CaptureStage.Pos += samples;
+                err = ALC_NO_ERROR;
+            }
+        }
         almtx_unlock(&device->BackendLock);
 
         if(err != ALC_NO_ERROR)
@@ -3866,7 +4551,7 @@ ALC_API ALCdevice* ALC_APIENTRY alcLoopbackOpenDeviceSOFT(const ALCchar *deviceN
         return NULL;
     }
 
-    device = al_calloc(16, sizeof(ALCdevice));
+    device = al_calloc_tag(AllocTag_Device, 16, sizeof(ALCdevice));
     if(!device)
     {
         alcSetError(NULL, ALC_OUT_OF_MEMORY);
@@ -3882,12 +4567,15 @@ ALC_API ALCdevice* ALC_APIENTRY alcLoopbackOpenDeviceSOFT(const ALCchar *deviceN
     device->Flags = 0;
     VECTOR_INIT(device->Hrtf.List);
     AL_STRING_INIT(device->Hrtf.Name);
+    device->Hrtf.AppRequest = ALC_DONT_CARE_SOFT;
+    device->Hrtf.AppId = -1;
     device->Bs2b = NULL;
     device->Uhj_Encoder = NULL;
     device->Render_Mode = NormalRender;
     AL_STRING_INIT(device->DeviceName);
     device->Dry.Buffer = NULL;
     device->Dry.NumChannels = 0;
+    device->MixQuantum = BUFFERSIZE;
     device->FOAOut.Buffer = NULL;
     device->FOAOut.NumChannels = 0;
     device->RealOut.Buffer = NULL;
@@ -3992,6 +4680,41 @@ FORCE_ALIGN ALC_API void ALC_APIENTRY alcRenderSamplesSOFT(ALCdevice *device, AL
     if(device) ALCdevice_DecRef(device);
 }
 
+/* alcRenderSamplesPlanarSOFT
+ *
+ * Renders some samples into separate float buffers, one per channel of the
+ * requested bus. ALC_OUTPUT_BUS_SOFT gives the device output channels, in the
+ * same order they'd be interleaved, while ALC_DRY_BUS_SOFT gives the internal
+ * mixing buffer (e.g. ambisonics) before it's decoded to the output.
+ */
+FORCE_ALIGN ALC_API void ALC_APIENTRY alcRenderSamplesPlanarSOFT(ALCdevice *device, ALCenum bus, ALCfloat *const *buffers, ALCsizei numchans, ALCsizei samples)
+{
+    ALCsizei i;
+
+    if(!VerifyDevice(&device) || device->Type != Loopback)
+        alcSetError(device, ALC_INVALID_DEVICE);
+    else if(bus != ALC_OUTPUT_BUS_SOFT && bus != ALC_DRY_BUS_SOFT)
+        alcSetError(device, ALC_INVALID_ENUM);
+    else if(samples < 0 || (samples > 0 && buffers == NULL) ||
+            numchans != (ALCsizei)((bus == ALC_DRY_BUS_SOFT) ? device->Dry.NumChannels :
+                                                               device->RealOut.NumChannels))
+        alcSetError(device, ALC_INVALID_VALUE);
+    else
+    {
+        for(i = 0;samples > 0 && i < numchans;i++)
+        {
+            if(!buffers[i])
+            {
+                alcSetError(device, ALC_INVALID_VALUE);
+                goto done;
+            }
+        }
+        aluMixDataPlanar(device, buffers, bus == ALC_DRY_BUS_SOFT, samples);
+    }
+done:
+    if(device) ALCdevice_DecRef(device);
+}
+
 
 /************************************************
  * ALC DSP pause/resume functions
@@ -4033,6 +4756,7 @@ ALC_API void ALC_APIENTRY alcDeviceResumeSOFT(ALCdevice *device)
             device->Flags &= ~DEVICE_PAUSED;
             if(ATOMIC_LOAD(&device->ContextList) != NULL)
             {
+                ALCbackend_resetWakeup(device->Backend);
                 if(V0(device->Backend,start)() != ALC_FALSE)
                     device->Flags |= DEVICE_RUNNING;
                 else
@@ -4050,6 +4774,36 @@ ALC_API void ALC_APIENTRY alcDeviceResumeSOFT(ALCdevice *device)
 }
 
 
+/************************************************
+ * ALC trace functions
+ ************************************************/
+
+/* alcDumpTraceSOFT
+ *
+ * Writes the mixer trace recorded by every thread as Chrome trace-event JSON.
+ * Fails if the library was built without the trace recorder.
+ */
+ALC_API ALCboolean ALC_APIENTRY alcDumpTraceSOFT(ALCdevice *device, const ALCchar *filename)
+{
+    ALCboolean ret = ALC_FALSE;
+
+    VerifyDevice(&device);
+    if(!filename || !filename[0])
+        alcSetError(device, ALC_INVALID_VALUE);
+    else
+    {
+#ifdef ALSOFT_TRACE
+        ret = TraceDump(filename) ? ALC_TRUE : ALC_FALSE;
+#endif
+        if(!ret)
+            alcSetError(device, ALC_INVALID_VALUE);
+    }
+    if(device) ALCdevice_DecRef(device);
+
+    return ret;
+}
+
+
 /************************************************
  * ALC HRTF functions
  ************************************************/
@@ -4073,6 +4827,13 @@ ALC_API const ALCchar* ALC_APIENTRY alcGetStringiSOFT(ALCdevice *device, ALCenum
                 alcSetError(device, ALC_INVALID_VALUE);
             break;
 
+        case ALC_MEMORY_TAG_NAME_SOFT:
+            if(index >= 0 && index < AllocTag_Count)
+                str = al_get_alloc_tag_name(index);
+            else
+                alcSetError(device, ALC_INVALID_VALUE);
+            break;
+
         default:
             alcSetError(device, ALC_INVALID_ENUM);
             break;
@@ -4101,7 +4862,9 @@ ALC_API ALCboolean ALC_APIENTRY alcResetDeviceSOFT(ALCdevice *device, const ALCi
     almtx_lock(&device->BackendLock);
     UnlockLists();
 
+    TRACE_BEGIN("UpdateDeviceParams", 0);
     err = UpdateDeviceParams(device, attribs);
+    TRACE_END("UpdateDeviceParams");
     almtx_unlock(&device->BackendLock);
 
     if(err != ALC_NO_ERROR)
@@ -36,6 +36,8 @@
 #include "hrtf.h"
 #include "uhjfilter.h"
 #include "bformatdec.h"
+#include "trace.h"
+#include "rtaudit.h"
 #include "static_assert.h"
 
 #include "mixer_defs.h"
@@ -93,6 +95,8 @@ extern inline void aluMatrixfSet(aluMatrixf *matrix,
                                  ALfloat m20, ALfloat m21, ALfloat m22, ALfloat m23,
                                  ALfloat m30, ALfloat m31, ALfloat m32, ALfloat m33);
 
+extern inline ALfloatBUFFERSIZE *GetMixBuffer(const ALCdevice *device, MixBuffers *mix, ALfloatBUFFERSIZE *buffer);
+
 const aluMatrixf IdentityMatrixf = {{
     { 1.0f, 0.0f, 0.0f, 0.0f },
     { 0.0f, 1.0f, 0.0f, 0.0f },
@@ -169,7 +173,7 @@ static aluVector aluMatrixfVector(const aluMatrixf *mtx, const aluVector *vec)
  * modified for use with an interpolated increment for buttery-smooth pitch
  * changes.
  */
-static ALboolean BsincPrepare(const ALuint increment, BsincState *state)
+ALboolean BsincPrepare(const ALuint increment, BsincState *state)
 {
     static const ALfloat scaleBase = 1.510578918e-01f, scaleRange = 1.177936623e+00f;
     static const ALuint m[BSINC_SCALE_COUNT] = { 24, 24, 24, 24, 24, 24, 24, 20, 20, 20, 16, 16, 16, 12, 12, 12 };
@@ -1298,7 +1302,8 @@ static void CalcAttnSourceParams(ALvoice *voice, const struct ALsourceProps *pro
 static void CalcSourceParams(ALvoice *voice, ALCcontext *context, ALboolean force)
 {
     ALsource *source = voice->Source;
-    const ALbufferlistitem *BufferListItem;
+    ALbufferqueue *BufferQueue;
+    ALuint BufferListItem, QueueTail;
     struct ALsourceProps *first;
     struct ALsourceProps *props;
 
@@ -1321,11 +1326,13 @@ static void CalcSourceParams(ALvoice *voice, ALCcontext *context, ALboolean forc
                 &source->FreeList, &first, props) == 0);
     }
 
-    BufferListItem = ATOMIC_LOAD(&source->queue, almemory_order_relaxed);
-    while(BufferListItem != NULL)
+    QueueTail = ATOMIC_LOAD(&source->queue_tail);
+    BufferListItem = ATOMIC_LOAD(&source->queue_head, almemory_order_relaxed);
+    BufferQueue = ATOMIC_LOAD(&source->queue);
+    for(;BufferListItem != QueueTail;BufferListItem++)
     {
         const ALbuffer *buffer;
-        if((buffer=BufferListItem->buffer) != NULL)
+        if((buffer=GetBufferQueueItem(BufferQueue, BufferListItem)->buffer) != NULL)
         {
             if(buffer->FmtChannels == FmtMono)
                 CalcAttnSourceParams(voice, &voice->Props, buffer, context);
@@ -1333,11 +1340,68 @@ static void CalcSourceParams(ALvoice *voice, ALCcontext *context, ALboolean forc
                 CalcNonAttnSourceParams(voice, &voice->Props, buffer, context);
             break;
         }
-        BufferListItem = BufferListItem->next;
     }
 }
 
 
+/* Tells the app how many events were dropped since the last report, so it
+ * knows to poll its sources instead. */
+static void SendLostEvents(ALCcontext *ctx)
+{
+    AsyncEvent evt;
+    evt.EnumType = EventType_EventsLost;
+    evt.ObjectId = 0;
+    evt.Param = ctx->EventsLostPending;
+    if(ll_ringbuffer_write(ctx->AsyncEvents, (const char*)&evt, 1) == 1)
+    {
+        ctx->EventsLostPending = 0;
+        alsem_post(&ctx->EventSem);
+    }
+}
+
+static void SendAsyncEvent(ALCcontext *ctx, ALuint type, ALuint id, ALuint param)
+{
+    AsyncEvent evt;
+
+    if(ctx->EventsLostPending > 0)
+        SendLostEvents(ctx);
+
+    evt.EnumType = type;
+    evt.ObjectId = id;
+    evt.Param = param;
+    if(ll_ringbuffer_write(ctx->AsyncEvents, (const char*)&evt, 1) == 1)
+        alsem_post(&ctx->EventSem);
+    else
+    {
+        ctx->EventsLostPending++;
+        ATOMIC_ADD(ALuint, &ctx->EventsLostTotal, 1, almemory_order_relaxed);
+    }
+}
+
+/* Reports the buffers completed and any state change for a source that was
+ * just mixed, given the buffer it was on before mixing. */
+static void SendSourceEvents(ALCcontext *ctx, ALsource *source, ALuint oldbuffer)
+{
+    ALuint enabledevts = ATOMIC_LOAD(&ctx->EnabledEvts, almemory_order_acquire);
+    ALuint curbuffer = ATOMIC_LOAD(&source->current_buffer, almemory_order_relaxed);
+
+    if((enabledevts&EventType_BufferCompleted) && curbuffer != oldbuffer)
+    {
+        ALuint head = ATOMIC_LOAD(&source->queue_head, almemory_order_relaxed);
+        ALuint tail = ATOMIC_LOAD(&source->queue_tail, almemory_order_relaxed);
+        ALuint count;
+
+        /* A looping source may have wrapped back to the head. */
+        if(curbuffer-head < oldbuffer-head)
+            count = (tail-oldbuffer) + (curbuffer-head);
+        else
+            count = curbuffer - oldbuffer;
+        SendAsyncEvent(ctx, EventType_BufferCompleted, source->id, count);
+    }
+    if((enabledevts&EventType_SourceStateChange) && source->state == AL_STOPPED)
+        SendAsyncEvent(ctx, EventType_SourceStateChange, source->id, AL_STOPPED);
+}
+
 static void UpdateContextSources(ALCcontext *ctx, ALeffectslot *slot)
 {
     ALvoice *voice, *voice_end;
@@ -1424,21 +1488,404 @@ DECL_TEMPLATE(ALbyte, aluF2B)
 #undef DECL_TEMPLATE
 
 
+static ALuint MixStatBucket(ALuint64 val)
+{
+    ALuint msb = 0;
+    if(val < (1<<MIXSTAT_SUB_BITS))
+        return (ALuint)val;
+    while((val>>msb) > 1)
+        msb++;
+    /* The top bits after the leading one select the sub-bucket. */
+    return ((msb-MIXSTAT_SUB_BITS+1)<<MIXSTAT_SUB_BITS) |
+           (ALuint)((val>>(msb-MIXSTAT_SUB_BITS)) & ((1<<MIXSTAT_SUB_BITS)-1));
+}
+
+static void RecordMixStat(MixStat *stat, ALuint64 count, ALuint64 val)
+{
+    if(count == 0 || val < stat->Min) stat->Min = val;
+    if(count == 0 || val > stat->Max) stat->Max = val;
+    stat->Sum += val;
+    stat->Hist[MixStatBucket(val)]++;
+}
+
+static void RecordMixTiming(ALCdevice *device, const ALuint64 *stagetimes, ALsizei size)
+{
+    MixTiming *timing = &device->Timing;
+    ALuint64 duration, load;
+    ALuint i;
+
+    /* Load is the time taken relative to the time the samples play for. */
+    duration = (ALuint64)size * DEVICE_CLOCK_RES / device->Frequency;
+    load = duration ? stagetimes[MixStage_Total]*U64(1000000) / duration : 0;
+
+    IncrementRef(&timing->Seq);
+    for(i = 0;i < MixStage_Count;i++)
+        RecordMixStat(&timing->Stage[i], timing->Count, stagetimes[i]);
+    RecordMixStat(&timing->Load, timing->Count, load);
+    timing->LastLoad = load;
+    timing->Count++;
+    IncrementRef(&timing->Seq);
+}
+
+/* Adds the time since the last mark to the given stage. */
+static inline void MarkMixStage(ALuint64 *stagetimes, ALuint64 *lastmark, enum MixStage stage)
+{
+    ALuint64 now = GetMonotonicTime();
+    stagetimes[stage] += now - *lastmark;
+    *lastmark = now;
+}
+#define MARK_STAGE(stage) MarkMixStage(stagetimes, &lastmark, (stage))
+
+/* Mixes a context's voices and effect slots, into mix's buffers if given or
+ * the device's otherwise. Stage times are only recorded if stagetimes is
+ * given.
+ */
+static void MixContext(ALCdevice *device, ALCcontext *ctx, MixBuffers *mix, ALuint SamplesToDo,
+                       ALuint64 clocktime, ALuint64 *stagetimes, ALuint64 *lastmark)
+{
+    ALvoice *voice, *voice_end;
+    ALeffectslot *slotroot, *slot;
+    ALsource *source;
+    ALuint i;
+
+    slotroot = ATOMIC_LOAD(&ctx->ActiveAuxSlotList);
+    TRACE_BEGIN("UpdateContextSources", ctx->VoiceCount);
+    UpdateContextSources(ctx, slotroot);
+    TRACE_END("UpdateContextSources");
+
+    slot = slotroot;
+    while(slot)
+    {
+        for(i = 0;i < slot->NumChannels;i++)
+            memset(slot->WetBuffer[i], 0, SamplesToDo*sizeof(ALfloat));
+        slot = ATOMIC_LOAD(&slot->next, almemory_order_relaxed);
+    }
+    if(stagetimes) MarkMixStage(stagetimes, lastmark, MixStage_Params);
+
+    /* source processing */
+    voice = ctx->Voices;
+    voice_end = voice + ctx->VoiceCount;
+    for(;voice != voice_end;++voice)
+    {
+        ALboolean IsVoiceInit = (voice->Step > 0);
+        source = voice->Source;
+        if(source && source->state == AL_PLAYING && IsVoiceInit)
+        {
+            ALuint oldbuffer = ATOMIC_LOAD(&source->current_buffer, almemory_order_relaxed);
+#ifdef ALSOFT_TRACE
+            ALuint64 voicestart = GetMonotonicTime();
+            MixSource(voice, source, device, mix, SamplesToDo);
+            TraceEventCost("MixSource", source->id, voicestart, TraceVoiceThreshold);
+#else
+            MixSource(voice, source, device, mix, SamplesToDo);
+#endif
+            UpdateSourcePosSnapshot(source, clocktime);
+            if(ATOMIC_LOAD(&ctx->EnabledEvts, almemory_order_relaxed))
+                SendSourceEvents(ctx, source, oldbuffer);
+        }
+    }
+    if(ctx->EventsLostPending > 0)
+        SendLostEvents(ctx);
+    if(stagetimes) MarkMixStage(stagetimes, lastmark, MixStage_Voices);
+
+    /* effect slot processing */
+    slot = slotroot;
+    while(slot)
+    {
+        const ALeffectslot *cslot = slot;
+        ALeffectState *state = cslot->Params.EffectState;
+        TRACE_BEGIN("EffectProcess", cslot->id);
+        V(state,process)(SamplesToDo, cslot->WetBuffer,
+                         GetMixBuffer(device, mix, state->OutBuffer), state->OutChannels);
+        TRACE_END("EffectProcess");
+        slot = ATOMIC_LOAD(&slot->next, almemory_order_relaxed);
+    }
+    if(stagetimes) MarkMixStage(stagetimes, lastmark, MixStage_Effects);
+}
+
+
+/* How many times the mixer checks for the workers to finish a block before
+ * blocking on them.
+ */
+#define MIX_WORKER_SPINS 4096
+
+/* A thread mixing contexts into its own buffers, alongside the device's
+ * mixer.
+ */
+typedef struct MixWorker {
+    MixBuffers Buffers;
+
+    ALCdevice *Device;
+    struct MixPool *Pool;
+    althrd_t Thread;
+    alsem_t Sem;
+} MixWorker;
+
+struct MixPool {
+    /* The next context to be mixed, and the block being mixed. */
+    ATOMIC(ALCcontext*) NextContext;
+    ALuint SamplesToDo;
+    ALuint64 ClockTime;
+
+    /* The number of workers that haven't finished the current block. The
+     * last one to finish posts Done if the mixer set Waiting.
+     */
+    ATOMIC(ALuint) Pending;
+    ATOMIC(ALenum) Waiting;
+    alsem_t Done;
+    ATOMIC(ALenum) Kill;
+
+    ALsizei NumWorkers;
+    MixWorker Workers[];
+};
+
+/* Takes the next context to be mixed for the current block, if any. */
+static ALCcontext *ClaimContext(struct MixPool *pool)
+{
+    ALCcontext *ctx = ATOMIC_LOAD(&pool->NextContext, almemory_order_acquire);
+    while(ctx && !ATOMIC_COMPARE_EXCHANGE_WEAK(ALCcontext*, &pool->NextContext, &ctx, ctx->next,
+                                                almemory_order_acq_rel, almemory_order_acquire))
+    {
+        /* ctx is updated with the current value on failure. */
+    }
+    return ctx;
+}
+
+static int MixWorkerProc(void *arg)
+{
+    MixWorker *worker = arg;
+    struct MixPool *pool = worker->Pool;
+    ALCdevice *device = worker->Device;
+    MixBuffers *mix = &worker->Buffers;
+    ALCcontext *ctx;
+    FPUCtl oldMode;
+    ALuint c;
+
+    SetRTPriority();
+    althrd_setname(althrd_current(), MIX_WORKER_THREAD_NAME);
+    SetMixerFPUMode(&oldMode);
+
+    while(alsem_wait(&worker->Sem) == althrd_success)
+    {
+        if(ATOMIC_LOAD(&pool->Kill, almemory_order_acquire))
+            break;
+
+        RT_AUDIT_ENTER();
+        while((ctx=ClaimContext(pool)) != NULL)
+        {
+            if(!mix->Used)
+            {
+                for(c = 0;c < mix->NumChannels;c++)
+                    memset(mix->Buffer[c], 0, pool->SamplesToDo*sizeof(ALfloat));
+                if(device->DefaultSlot)
+                {
+                    for(c = 0;c < device->DefaultSlot->NumChannels;c++)
+                        memset(mix->DefaultWet[c], 0, pool->SamplesToDo*sizeof(ALfloat));
+                }
+                mix->Used = AL_TRUE;
+            }
+            MixContext(device, ctx, mix, pool->SamplesToDo, pool->ClockTime, NULL, NULL);
+        }
+        RT_AUDIT_LEAVE();
+
+        if(ATOMIC_SUB(ALuint, &pool->Pending, 1) == 1 &&
+           ATOMIC_EXCHANGE(ALenum, &pool->Waiting, AL_FALSE))
+            alsem_post(&pool->Done);
+    }
+
+    RestoreFPUMode(&oldMode);
+    return 0;
+}
+
+/* Mixes the device's contexts for a block, with the mixing workers and this
+ * thread each taking contexts until there are none left. The workers' buffers
+ * are then added to the device's. This waits for the workers to finish, which
+ * is the only waiting allowed while mixing.
+ *
+ * Only the contexts mixed on this thread are timed by stage. Waiting for the
+ * workers and adding in their buffers is counted as voice mixing.
+ */
+static void MixContextsParallel(ALCdevice *device, ALCcontext *ctx, ALuint SamplesToDo,
+                                ALuint64 clocktime, ALuint64 *stagetimes, ALuint64 *lastmark)
+{
+    struct MixPool *pool = device->MixPool;
+    ALuint spins, c, j;
+    ALsizei i;
+
+    pool->SamplesToDo = SamplesToDo;
+    pool->ClockTime = clocktime;
+    ATOMIC_STORE(&pool->NextContext, ctx, almemory_order_relaxed);
+    ATOMIC_STORE(&pool->Pending, pool->NumWorkers, almemory_order_release);
+    for(i = 0;i < pool->NumWorkers;i++)
+        alsem_post(&pool->Workers[i].Sem);
+
+    while((ctx=ClaimContext(pool)) != NULL)
+        MixContext(device, ctx, NULL, SamplesToDo, clocktime, stagetimes, lastmark);
+
+    /* The workers should be finishing their last context by now, so spin a
+     * little before blocking. Having to block means a worker fell behind,
+     * which is counted with the backend's stats.
+     */
+    for(spins = 0;ATOMIC_LOAD(&pool->Pending, almemory_order_acquire) > 0;spins++)
+    {
+        if(spins >= MIX_WORKER_SPINS)
+        {
+            ALenum waiting = AL_TRUE;
+            ALCbackend_countStat(device->Backend, BackendStat_MixerWait);
+            ATOMIC_STORE(&pool->Waiting, AL_TRUE);
+            /* If the last worker finished before seeing Waiting, take it back.
+             * Otherwise it has or will post Done. This fallback wait is
+             * expected to block, so it's left out of the real-time audit.
+             */
+            if(ATOMIC_LOAD(&pool->Pending) > 0 ||
+               !ATOMIC_COMPARE_EXCHANGE_STRONG(ALenum, &pool->Waiting, &waiting, AL_FALSE))
+            {
+                RT_AUDIT_LEAVE();
+                alsem_wait(&pool->Done);
+                RT_AUDIT_ENTER();
+            }
+            break;
+        }
+    }
+
+    for(i = 0;i < pool->NumWorkers;i++)
+    {
+        MixBuffers *mix = &pool->Workers[i].Buffers;
+        if(!mix->Used) continue;
+
+        for(c = 0;c < mix->NumChannels;c++)
+        {
+            for(j = 0;j < SamplesToDo;j++)
+                device->Dry.Buffer[c][j] += mix->Buffer[c][j];
+        }
+        if(device->DefaultSlot)
+        {
+            ALeffectslot *slot = device->DefaultSlot;
+            for(c = 0;c < slot->NumChannels;c++)
+            {
+                for(j = 0;j < SamplesToDo;j++)
+                    slot->WetBuffer[c][j] += mix->DefaultWet[c][j];
+            }
+        }
+        mix->Used = AL_FALSE;
+    }
+}
+
+static void DestroyMixPool(struct MixPool *pool)
+{
+    ALsizei i;
+    int res;
+
+    ATOMIC_STORE(&pool->Kill, AL_TRUE, almemory_order_release);
+    for(i = 0;i < pool->NumWorkers;i++)
+    {
+        alsem_post(&pool->Workers[i].Sem);
+        althrd_join(pool->Workers[i].Thread, &res);
+        alsem_destroy(&pool->Workers[i].Sem);
+        al_free(pool->Workers[i].Buffers.Buffer);
+    }
+    alsem_destroy(&pool->Done);
+    al_free(pool);
+}
+
+void aluStartMixWorkers(ALCdevice *device, ALsizei count)
+{
+    struct MixPool *pool;
+    ALuint numchans;
+    ALsizei i;
+
+    aluStopMixWorkers(device);
+    if(count <= 0) return;
+
+    /* Workers need room for each channel of the dry buffer allocation, which
+     * the FOAOut and RealOut channels are either part of or follow.
+     */
+    numchans = maxu(device->Dry.NumChannels, maxu(
+        (ALuint)(device->FOAOut.Buffer-device->Dry.Buffer) + device->FOAOut.NumChannels,
+        (ALuint)(device->RealOut.Buffer-device->Dry.Buffer) + device->RealOut.NumChannels
+    ));
+
+    pool = al_calloc_tag(AllocTag_Device, 16, sizeof(*pool) + count*sizeof(pool->Workers[0]));
+    if(!pool)
+    {
+        ERR("Failed to allocate %d mixing workers\n", count);
+        return;
+    }
+    ATOMIC_INIT(&pool->NextContext, NULL);
+    ATOMIC_INIT(&pool->Pending, 0);
+    ATOMIC_INIT(&pool->Waiting, AL_FALSE);
+    ATOMIC_INIT(&pool->Kill, AL_FALSE);
+    if(alsem_init(&pool->Done, 0) != althrd_success)
+    {
+        ERR("Failed to create mixing worker semaphore\n");
+        al_free(pool);
+        return;
+    }
+    TRACE_RESERVE_RINGS(count);
+
+    for(i = 0;i < count;i++)
+    {
+        MixWorker *worker = &pool->Workers[i];
+
+        worker->Buffers.Buffer = al_calloc_tag(AllocTag_Device, 16,
+                                               numchans*sizeof(worker->Buffers.Buffer[0]));
+        worker->Buffers.NumChannels = numchans;
+        worker->Buffers.Used = AL_FALSE;
+        worker->Device = device;
+        worker->Pool = pool;
+        if(!worker->Buffers.Buffer || alsem_init(&worker->Sem, 0) != althrd_success)
+        {
+            al_free(worker->Buffers.Buffer);
+            break;
+        }
+        if(althrd_create(&worker->Thread, MixWorkerProc, worker) != althrd_success)
+        {
+            alsem_destroy(&worker->Sem);
+            al_free(worker->Buffers.Buffer);
+            break;
+        }
+        pool->NumWorkers++;
+    }
+    if(pool->NumWorkers < count)
+    {
+        ERR("Failed to start mixing worker %d of %d\n", pool->NumWorkers+1, count);
+        DestroyMixPool(pool);
+        return;
+    }
+
+    device->MixPool = pool;
+    TRACE("Mixing contexts with %d extra thread%s\n", count, (count==1)?"":"s");
+}
+
+void aluStopMixWorkers(ALCdevice *device)
+{
+    if(!device->MixPool)
+        return;
+    DestroyMixPool(device->MixPool);
+    device->MixPool = NULL;
+}
+
 ALvoid aluMixData(ALCdevice *device, ALvoid *buffer, ALsizei size)
 {
+    ALuint64 stagetimes[MixStage_Count] = { 0 };
+    ALuint64 starttime, lastmark;
+    ALsizei totalsize = size;
     ALuint SamplesToDo;
-    ALvoice *voice, *voice_end;
+    ALuint64 samplesdone, clocktime;
     ALeffectslot *slot;
-    ALsource *source;
     ALCcontext *ctx;
     FPUCtl oldMode;
     ALuint i, c;
 
     SetMixerFPUMode(&oldMode);
+    /* Nothing in here may allocate or wait on another thread. */
+    RT_AUDIT_ENTER();
+    TRACE_BEGIN("aluMixData", size);
 
+    starttime = lastmark = GetMonotonicTime();
     while(size > 0)
     {
-        SamplesToDo = minu(size, BUFFERSIZE);
+        SamplesToDo = minu(size, device->MixQuantum ? device->MixQuantum : BUFFERSIZE);
         for(c = 0;c < device->Dry.NumChannels;c++)
             memset(device->Dry.Buffer[c], 0, SamplesToDo*sizeof(ALfloat));
         if(device->Dry.Buffer != device->RealOut.Buffer)
@@ -1451,51 +1898,30 @@ ALvoid aluMixData(ALCdevice *device, ALvoid *buffer, ALsizei size)
         IncrementRef(&device->MixCount);
         V0(device->Backend,lock)();
 
+        /* The device clock time at the end of this update, which source
+         * positions are published with. */
+        samplesdone = device->SamplesDone + SamplesToDo;
+        clocktime = device->ClockBase +
+                    (samplesdone/device->Frequency * DEVICE_CLOCK_RES) +
+                    (samplesdone%device->Frequency * DEVICE_CLOCK_RES / device->Frequency);
+
         if((slot=device->DefaultSlot) != NULL)
         {
             CalcEffectSlotParams(device->DefaultSlot, device);
             for(i = 0;i < slot->NumChannels;i++)
                 memset(slot->WetBuffer[i], 0, SamplesToDo*sizeof(ALfloat));
         }
+        MARK_STAGE(MixStage_Params);
 
         ctx = ATOMIC_LOAD(&device->ContextList);
-        while(ctx)
+        if(device->MixPool && ctx && ctx->next)
         {
-            ALeffectslot *slotroot;
-
-            slotroot = ATOMIC_LOAD(&ctx->ActiveAuxSlotList);
-            UpdateContextSources(ctx, slotroot);
-
-            slot = slotroot;
-            while(slot)
-            {
-                for(i = 0;i < slot->NumChannels;i++)
-                    memset(slot->WetBuffer[i], 0, SamplesToDo*sizeof(ALfloat));
-                slot = ATOMIC_LOAD(&slot->next, almemory_order_relaxed);
-            }
-
-            /* source processing */
-            voice = ctx->Voices;
-            voice_end = voice + ctx->VoiceCount;
-            for(;voice != voice_end;++voice)
-            {
-                ALboolean IsVoiceInit = (voice->Step > 0);
-                source = voice->Source;
-                if(source && source->state == AL_PLAYING && IsVoiceInit)
-                    MixSource(voice, source, device, SamplesToDo);
-            }
-
-            /* effect slot processing */
-            slot = slotroot;
-            while(slot)
-            {
-                const ALeffectslot *cslot = slot;
-                ALeffectState *state = cslot->Params.EffectState;
-                V(state,process)(SamplesToDo, cslot->WetBuffer, state->OutBuffer,
-                                 state->OutChannels);
-                slot = ATOMIC_LOAD(&slot->next, almemory_order_relaxed);
-            }
-
+            MixContextsParallel(device, ctx, SamplesToDo, clocktime, stagetimes, &lastmark);
+            MARK_STAGE(MixStage_Voices);
+        }
+        else while(ctx)
+        {
+            MixContext(device, ctx, NULL, SamplesToDo, clocktime, stagetimes, &lastmark);
             ctx = ctx->next;
         }
 
@@ -1503,9 +1929,12 @@ ALvoid aluMixData(ALCdevice *device, ALvoid *buffer, ALsizei size)
         {
             const ALeffectslot *slot = device->DefaultSlot;
             ALeffectState *state = slot->Params.EffectState;
+            TRACE_BEGIN("EffectProcess", slot->id);
             V(state,process)(SamplesToDo, slot->WetBuffer, state->OutBuffer,
                              state->OutChannels);
+            TRACE_END("EffectProcess");
         }
+        MARK_STAGE(MixStage_Effects);
 
         /* Increment the clock time. Every second's worth of samples is
          * converted and added to clock base so that large sample counts don't
@@ -1579,6 +2008,7 @@ ALvoid aluMixData(ALCdevice *device, ALvoid *buffer, ALsizei size)
                                 device->RealOut.Buffer[ridx], SamplesToDo);
             }
         }
+        MARK_STAGE(MixStage_Decode);
 
         if(buffer)
         {
@@ -1615,12 +2045,51 @@ ALvoid aluMixData(ALCdevice *device, ALvoid *buffer, ALsizei size)
             }
 #undef WRITE
         }
+        MARK_STAGE(MixStage_Output);
 
         size -= SamplesToDo;
     }
 
+    stagetimes[MixStage_Total] = lastmark - starttime;
+    RecordMixTiming(device, stagetimes, totalsize);
+
+    TRACE_END("aluMixData");
+    RT_AUDIT_LEAVE();
     RestoreFPUMode(&oldMode);
 }
+#undef MARK_STAGE
+
+ALvoid aluMixDataPlanar(ALCdevice *device, ALfloat *const *buffers, ALboolean drybus, ALsizei size)
+{
+    ALsizei done = 0;
+    ALuint c;
+
+    while(done < size)
+    {
+        ALsizei todo = mini(size-done, device->MixQuantum ? device->MixQuantum : BUFFERSIZE);
+        ALfloat (*OutBuffer)[BUFFERSIZE];
+        ALuint OutChannels;
+
+        /* Mixing without an output buffer leaves the last block's samples in
+         * the device's mixing buffers, to be copied out directly. */
+        aluMixData(device, NULL, todo);
+
+        if(drybus)
+        {
+            OutBuffer = device->Dry.Buffer;
+            OutChannels = device->Dry.NumChannels;
+        }
+        else
+        {
+            OutBuffer = device->RealOut.Buffer;
+            OutChannels = device->RealOut.NumChannels;
+        }
+        for(c = 0;c < OutChannels;c++)
+            memcpy(buffers[c]+done, OutBuffer[c], todo*sizeof(ALfloat));
+
+        done += todo;
+    }
+}
 
 
 ALvoid aluHandleDisconnect(ALCdevice *device)
@@ -1644,9 +2113,10 @@ ALvoid aluHandleDisconnect(ALCdevice *device)
             if(source && source->state == AL_PLAYING)
             {
                 source->state = AL_STOPPED;
-                ATOMIC_STORE(&source->current_buffer, NULL);
+                ATOMIC_STORE(&source->current_buffer, ATOMIC_LOAD(&source->queue_tail));
                 ATOMIC_STORE(&source->position, 0);
                 ATOMIC_STORE(&source->position_fraction, 0);
+                UpdateSourcePosSnapshot(source, GetDeviceClockTime(device));
             }
 
             voice++;
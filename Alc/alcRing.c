@@ -33,10 +33,22 @@
  * to include an element size. Consequently, parameters and return values for a
  * size or count is in 'elements', not bytes. Additionally, it only supports
  * single-consumer/single-provider operation. */
+
+/* The writer's and reader's positions are kept on separate cache lines, so
+ * each side only touches the other's when it needs to see its progress.
+ */
+#define RING_CACHE_LINE_SIZE 64
+
 struct ll_ringbuffer {
-    volatile size_t write_ptr;
-    volatile size_t read_ptr;
-    size_t size;
+    /* Only changed by the writer, along with the last read pointer it saw. */
+    alignas(RING_CACHE_LINE_SIZE) ATOMIC(size_t) write_ptr;
+    size_t cached_read_ptr;
+
+    /* Only changed by the reader, along with the last write pointer it saw. */
+    alignas(RING_CACHE_LINE_SIZE) ATOMIC(size_t) read_ptr;
+    size_t cached_write_ptr;
+
+    alignas(RING_CACHE_LINE_SIZE) size_t size;
     size_t size_mask;
     size_t elem_size;
     int mlocked;
@@ -55,14 +67,16 @@ ll_ringbuffer_t *ll_ringbuffer_create(size_t sz, size_t elem_sz)
     if(power_of_two < sz)
         return NULL;
 
-    rb = al_malloc(16, sizeof(*rb) + power_of_two*elem_sz);
+    rb = al_malloc_tag(AllocTag_Ring, RING_CACHE_LINE_SIZE, sizeof(*rb) + power_of_two*elem_sz);
     if(!rb) return NULL;
 
     rb->size = power_of_two;
     rb->size_mask = rb->size - 1;
     rb->elem_size = elem_sz;
-    rb->write_ptr = 0;
-    rb->read_ptr = 0;
+    ATOMIC_INIT(&rb->write_ptr, 0);
+    rb->cached_read_ptr = 0;
+    ATOMIC_INIT(&rb->read_ptr, 0);
+    rb->cached_write_ptr = 0;
     rb->mlocked = 0;
     return rb;
 }
@@ -84,7 +98,7 @@ void ll_ringbuffer_free(ll_ringbuffer_t *rb)
 int ll_ringbuffer_mlock(ll_ringbuffer_t *rb)
 {
 #ifdef USE_MLOCK
-    if(!rb->locked && mlock(rb, sizeof(*rb) + rb->size*rb->elem_size))
+    if(!rb->mlocked && mlock(rb, sizeof(*rb) + rb->size*rb->elem_size))
         return -1;
 #endif /* USE_MLOCK */
     rb->mlocked = 1;
@@ -94,8 +108,10 @@ int ll_ringbuffer_mlock(ll_ringbuffer_t *rb)
 /* Reset the read and write pointers to zero. This is not thread safe. */
 void ll_ringbuffer_reset(ll_ringbuffer_t *rb)
 {
-    rb->read_ptr = 0;
-    rb->write_ptr = 0;
+    ATOMIC_STORE(&rb->write_ptr, 0, almemory_order_relaxed);
+    rb->cached_read_ptr = 0;
+    ATOMIC_STORE(&rb->read_ptr, 0, almemory_order_relaxed);
+    rb->cached_write_ptr = 0;
     memset(rb->buf, 0, rb->size*rb->elem_size);
 }
 
@@ -103,51 +119,90 @@ void ll_ringbuffer_reset(ll_ringbuffer_t *rb)
  * elements in front of the read pointer and behind the write pointer. */
 size_t ll_ringbuffer_read_space(const ll_ringbuffer_t *rb)
 {
-    size_t w = rb->write_ptr;
-    size_t r = rb->read_ptr;
+    size_t w = ATOMIC_LOAD(&rb->write_ptr, almemory_order_acquire);
+    size_t r = ATOMIC_LOAD(&rb->read_ptr, almemory_order_acquire);
     return (rb->size+w-r) & rb->size_mask;
 }
 /* Return the number of elements available for writing. This is the number of
  * elements in front of the write pointer and behind the read pointer. */
 size_t ll_ringbuffer_write_space(const ll_ringbuffer_t *rb)
 {
-    size_t w = rb->write_ptr;
-    size_t r = rb->read_ptr;
+    size_t w = ATOMIC_LOAD(&rb->write_ptr, almemory_order_acquire);
+    size_t r = ATOMIC_LOAD(&rb->read_ptr, almemory_order_acquire);
     return (rb->size+r-w-1) & rb->size_mask;
 }
 
-/* The copying data reader. Copy at most `cnt' elements from `rb' to `dest'.
- * Returns the actual number of elements copied. */
-size_t ll_ringbuffer_read(ll_ringbuffer_t *rb, char *dest, size_t cnt)
-{
-    size_t free_cnt;
-    size_t cnt2;
-    size_t to_read;
-    size_t n1, n2;
 
-    free_cnt = ll_ringbuffer_read_space(rb);
-    if(free_cnt == 0) return 0;
-
-    to_read = (cnt > free_cnt) ? free_cnt : cnt;
-    cnt2 = rb->read_ptr + to_read;
+/* Sets `vec' to the one or two parts holding `cnt' elements from `pos'. */
+static inline void ll_ringbuffer_get_vector(const ll_ringbuffer_t *rb, size_t pos, size_t cnt,
+                                            ll_ringbuffer_data_t *vec)
+{
+    size_t cnt2 = pos + cnt;
     if(cnt2 > rb->size)
     {
-        n1 = rb->size - rb->read_ptr;
-        n2 = cnt2 & rb->size_mask;
+        /* Two part vector: the rest of the buffer after the position, plus
+         * some from the start of the buffer. */
+        vec[0].buf = (char*)&(rb->buf[pos*rb->elem_size]);
+        vec[0].len = rb->size - pos;
+        vec[1].buf = (char*)rb->buf;
+        vec[1].len = cnt2 & rb->size_mask;
     }
     else
     {
-        n1 = to_read;
-        n2 = 0;
+        /* Single part vector: just the rest of the buffer */
+        vec[0].buf = (char*)&(rb->buf[pos*rb->elem_size]);
+        vec[0].len = cnt;
+        vec[1].buf = NULL;
+        vec[1].len = 0;
     }
+}
 
-    memcpy(dest, &(rb->buf[rb->read_ptr*rb->elem_size]), n1*rb->elem_size);
-    rb->read_ptr = (rb->read_ptr + n1) & rb->size_mask;
-    if(n2)
+/* Claims up to `cnt' readable elements, setting `vec' to the one or two parts
+ * holding them, and returns how many were claimed. They may be read in place,
+ * then released with ll_ringbuffer_read_advance. Only the reader may call
+ * this. The write pointer is only reloaded when the last one seen doesn't
+ * have enough elements. */
+size_t ll_ringbuffer_read_claim(ll_ringbuffer_t *rb, size_t cnt, ll_ringbuffer_data_t *vec)
+{
+    size_t r = ATOMIC_LOAD(&rb->read_ptr, almemory_order_relaxed);
+    size_t avail = (rb->size+rb->cached_write_ptr-r) & rb->size_mask;
+
+    if(avail < cnt)
     {
-        memcpy(dest + n1*rb->elem_size, &(rb->buf[rb->read_ptr*rb->elem_size]), n2*rb->elem_size);
-        rb->read_ptr = (rb->read_ptr + n2) & rb->size_mask;
+        rb->cached_write_ptr = ATOMIC_LOAD(&rb->write_ptr, almemory_order_acquire);
+        avail = (rb->size+rb->cached_write_ptr-r) & rb->size_mask;
+        if(avail < cnt) cnt = avail;
     }
+    ll_ringbuffer_get_vector(rb, r, cnt, vec);
+    return cnt;
+}
+
+/* Claims up to `cnt' writable elements, setting `vec' to the one or two parts
+ * holding them, and returns how many were claimed. They may be written in
+ * place, then published with ll_ringbuffer_write_advance. Only the writer may
+ * call this. The read pointer is only reloaded when the last one seen doesn't
+ * leave enough space. */
+size_t ll_ringbuffer_write_claim(ll_ringbuffer_t *rb, size_t cnt, ll_ringbuffer_data_t *vec)
+{
+    size_t w = ATOMIC_LOAD(&rb->write_ptr, almemory_order_relaxed);
+    size_t avail = (rb->size+rb->cached_read_ptr-w-1) & rb->size_mask;
+
+    if(avail < cnt)
+    {
+        rb->cached_read_ptr = ATOMIC_LOAD(&rb->read_ptr, almemory_order_acquire);
+        avail = (rb->size+rb->cached_read_ptr-w-1) & rb->size_mask;
+        if(avail < cnt) cnt = avail;
+    }
+    ll_ringbuffer_get_vector(rb, w, cnt, vec);
+    return cnt;
+}
+
+/* The copying data reader. Copy at most `cnt' elements from `rb' to `dest'.
+ * Returns the actual number of elements copied. */
+size_t ll_ringbuffer_read(ll_ringbuffer_t *rb, char *dest, size_t cnt)
+{
+    size_t to_read = ll_ringbuffer_peek(rb, dest, cnt);
+    ll_ringbuffer_read_advance(rb, to_read);
     return to_read;
 }
 
@@ -156,33 +211,15 @@ size_t ll_ringbuffer_read(ll_ringbuffer_t *rb, char *dest, size_t cnt)
  */
 size_t ll_ringbuffer_peek(ll_ringbuffer_t *rb, char *dest, size_t cnt)
 {
-    size_t free_cnt;
-    size_t cnt2;
+    ll_ringbuffer_data_t vec[2];
     size_t to_read;
-    size_t n1, n2;
-    size_t tmp_read_ptr;
 
-    tmp_read_ptr = rb->read_ptr;
-    free_cnt = ll_ringbuffer_read_space(rb);
-    if(free_cnt == 0) return 0;
+    to_read = ll_ringbuffer_read_claim(rb, cnt, vec);
+    if(to_read == 0) return 0;
 
-    to_read = (cnt > free_cnt) ? free_cnt : cnt;
-    cnt2 = tmp_read_ptr + to_read;
-    if(cnt2 > rb->size)
-    {
-        n1 = rb->size - tmp_read_ptr;
-        n2 = cnt2 & rb->size_mask;
-    }
-    else
-    {
-        n1 = to_read;
-        n2 = 0;
-    }
-
-    memcpy(dest, &(rb->buf[tmp_read_ptr*rb->elem_size]), n1*rb->elem_size);
-    tmp_read_ptr = (tmp_read_ptr + n1) & rb->size_mask;
-    if(n2)
-        memcpy(dest + n1*rb->elem_size, &(rb->buf[tmp_read_ptr*rb->elem_size]), n2*rb->elem_size);
+    memcpy(dest, vec[0].buf, vec[0].len*rb->elem_size);
+    if(vec[1].len)
+        memcpy(dest + vec[0].len*rb->elem_size, vec[1].buf, vec[1].len*rb->elem_size);
     return to_read;
 }
 
@@ -190,49 +227,33 @@ size_t ll_ringbuffer_peek(ll_ringbuffer_t *rb, char *dest, size_t cnt)
  * Returns the actual number of elements copied. */
 size_t ll_ringbuffer_write(ll_ringbuffer_t *rb, const char *src, size_t cnt)
 {
-    size_t free_cnt;
-    size_t cnt2;
+    ll_ringbuffer_data_t vec[2];
     size_t to_write;
-    size_t n1, n2;
-
-    free_cnt = ll_ringbuffer_write_space(rb);
-    if(free_cnt == 0) return 0;
 
-    to_write = (cnt > free_cnt) ? free_cnt : cnt;
-    cnt2 = rb->write_ptr + to_write;
-    if(cnt2 > rb->size)
-    {
-        n1 = rb->size - rb->write_ptr;
-        n2 = cnt2 & rb->size_mask;
-    }
-    else
-    {
-        n1 = to_write;
-        n2 = 0;
-    }
+    to_write = ll_ringbuffer_write_claim(rb, cnt, vec);
+    if(to_write == 0) return 0;
 
-    memcpy(&(rb->buf[rb->write_ptr*rb->elem_size]), src, n1*rb->elem_size);
-    rb->write_ptr = (rb->write_ptr + n1) & rb->size_mask;
-    if(n2)
-    {
-        memcpy(&(rb->buf[rb->write_ptr*rb->elem_size]), src + n1*rb->elem_size, n2*rb->elem_size);
-        rb->write_ptr = (rb->write_ptr + n2) & rb->size_mask;
-    }
+    memcpy(vec[0].buf, src, vec[0].len*rb->elem_size);
+    if(vec[1].len)
+        memcpy(vec[1].buf, src + vec[0].len*rb->elem_size, vec[1].len*rb->elem_size);
+    ll_ringbuffer_write_advance(rb, to_write);
     return to_write;
 }
 
-/* Advance the read pointer `cnt' places. */
+/* Advance the read pointer `cnt' places, releasing the elements to the
+ * writer. */
 void ll_ringbuffer_read_advance(ll_ringbuffer_t *rb, size_t cnt)
 {
-    size_t tmp = (rb->read_ptr + cnt) & rb->size_mask;
-    rb->read_ptr = tmp;
+    size_t r = ATOMIC_LOAD(&rb->read_ptr, almemory_order_relaxed);
+    ATOMIC_STORE(&rb->read_ptr, (r+cnt) & rb->size_mask, almemory_order_release);
 }
 
-/* Advance the write pointer `cnt' places. */
+/* Advance the write pointer `cnt' places, publishing the elements to the
+ * reader. */
 void ll_ringbuffer_write_advance(ll_ringbuffer_t *rb, size_t cnt)
 {
-    size_t tmp = (rb->write_ptr + cnt) & rb->size_mask;
-    rb->write_ptr = tmp;
+    size_t w = ATOMIC_LOAD(&rb->write_ptr, almemory_order_relaxed);
+    ATOMIC_STORE(&rb->write_ptr, (w+cnt) & rb->size_mask, almemory_order_release);
 }
 
 /* The non-copying data reader. `vec' is an array of two places. Set the values
@@ -240,32 +261,9 @@ void ll_ringbuffer_write_advance(ll_ringbuffer_t *rb, size_t cnt)
  * in one segment the second segment has zero length. */
 void ll_ringbuffer_get_read_vector(const ll_ringbuffer_t *rb, ll_ringbuffer_data_t * vec)
 {
-    size_t free_cnt;
-    size_t cnt2;
-    size_t w, r;
-
-    w = rb->write_ptr;
-    r = rb->read_ptr;
-    free_cnt = (rb->size+w-r) & rb->size_mask;
-
-    cnt2 = r + free_cnt;
-    if(cnt2 > rb->size)
-    {
-        /* Two part vector: the rest of the buffer after the current write ptr,
-         * plus some from the start of the buffer. */
-        vec[0].buf = (char*)&(rb->buf[r*rb->elem_size]);
-        vec[0].len = rb->size - r;
-        vec[1].buf = (char*)rb->buf;
-        vec[1].len = cnt2 & rb->size_mask;
-    }
-    else
-    {
-        /* Single part vector: just the rest of the buffer */
-        vec[0].buf = (char*)&(rb->buf[r*rb->elem_size]);
-        vec[0].len = free_cnt;
-        vec[1].buf = NULL;
-        vec[1].len = 0;
-    }
+    size_t w = ATOMIC_LOAD(&rb->write_ptr, almemory_order_acquire);
+    size_t r = ATOMIC_LOAD(&rb->read_ptr, almemory_order_relaxed);
+    ll_ringbuffer_get_vector(rb, r, (rb->size+w-r) & rb->size_mask, vec);
 }
 
 /* The non-copying data writer. `vec' is an array of two places. Set the values
@@ -273,29 +271,7 @@ void ll_ringbuffer_get_read_vector(const ll_ringbuffer_t *rb, ll_ringbuffer_data
  * is in one segment the second segment has zero length. */
 void ll_ringbuffer_get_write_vector(const ll_ringbuffer_t *rb, ll_ringbuffer_data_t *vec)
 {
-    size_t free_cnt;
-    size_t cnt2;
-    size_t w, r;
-
-    w = rb->write_ptr;
-    r = rb->read_ptr;
-    free_cnt = (rb->size+r-w-1) & rb->size_mask;
-
-    cnt2 = w + free_cnt;
-    if(cnt2 > rb->size)
-    {
-        /* Two part vector: the rest of the buffer after the current write ptr,
-         * plus some from the start of the buffer. */
-        vec[0].buf = (char*)&(rb->buf[w*rb->elem_size]);
-        vec[0].len = rb->size - w;
-        vec[1].buf = (char*)rb->buf;
-        vec[1].len = cnt2 & rb->size_mask;
-    }
-    else
-    {
-        vec[0].buf = (char*)&(rb->buf[w*rb->elem_size]);
-        vec[0].len = free_cnt;
-        vec[1].buf = NULL;
-        vec[1].len = 0;
-    }
+    size_t w = ATOMIC_LOAD(&rb->write_ptr, almemory_order_relaxed);
+    size_t r = ATOMIC_LOAD(&rb->read_ptr, almemory_order_acquire);
+    ll_ringbuffer_get_vector(rb, w, (rb->size+r-w-1) & rb->size_mask, vec);
 }
@@ -28,6 +28,7 @@
 #include "alu.h"
 #include "threads.h"
 #include "compat.h"
+#include "trace.h"
 
 #include "backends/base.h"
 
@@ -354,7 +355,11 @@ static void probe_devices(snd_pcm_stream_t stream, vector_DevMap *DeviceList)
 }
 
 
-static int verify_state(snd_pcm_t *handle)
+/* Checks the device state, recovering from an xrun or suspend. An xrun is
+ * counted as the given type (an underrun for playback, an overrun for
+ * capture).
+ */
+static int verify_state(snd_pcm_t *handle, ALCbackend *backend, enum BackendStatType xrun)
 {
     snd_pcm_state_t state = snd_pcm_state(handle);
     int err;
@@ -371,12 +376,15 @@ static int verify_state(snd_pcm_t *handle)
             break;
 
         case SND_PCM_STATE_XRUN:
+            ALCbackend_countStat(backend, xrun);
             if((err=snd_pcm_recover(handle, -EPIPE, 1)) < 0)
                 return err;
+            ALCbackend_countStat(backend, BackendStat_Recovery);
             break;
         case SND_PCM_STATE_SUSPENDED:
             if((err=snd_pcm_recover(handle, -ESTRPIPE, 1)) < 0)
                 return err;
+            ALCbackend_countStat(backend, BackendStat_Recovery);
             break;
         case SND_PCM_STATE_DISCONNECTED:
             return -ENODEV;
@@ -394,12 +402,19 @@ typedef struct ALCplaybackAlsa {
     ALvoid *buffer;
     ALsizei size;
 
+    /* When set, a large hardware buffer is kept only partially filled, and the
+     * mixer wakes on a timer instead of period interrupts (mmap only).
+     */
+    ALboolean tsched;
+    snd_pcm_uframes_t bufferSize;
+
     volatile int killNow;
     althrd_t thread;
 } ALCplaybackAlsa;
 
 static int ALCplaybackAlsa_mixerProc(void *ptr);
 static int ALCplaybackAlsa_mixerNoMMapProc(void *ptr);
+static int ALCplaybackAlsa_mixerTSchedProc(void *ptr);
 
 static void ALCplaybackAlsa_Construct(ALCplaybackAlsa *self, ALCdevice *device);
 static DECLARE_FORWARD(ALCplaybackAlsa, ALCbackend, void, Destruct)
@@ -422,6 +437,9 @@ static void ALCplaybackAlsa_Construct(ALCplaybackAlsa *self, ALCdevice *device)
 {
     ALCbackend_Construct(STATIC_CAST(ALCbackend, self), device);
     SET_VTABLE2(ALCplaybackAlsa, ALCbackend, self);
+
+    self->tsched = AL_FALSE;
+    self->bufferSize = 0;
 }
 
 
@@ -443,7 +461,8 @@ static int ALCplaybackAlsa_mixerProc(void *ptr)
     num_updates = device->NumUpdates;
     while(!self->killNow)
     {
-        int state = verify_state(self->pcmHandle);
+        int state = verify_state(self->pcmHandle, STATIC_CAST(ALCbackend, self),
+                                 BackendStat_Underrun);
         if(state < 0)
         {
             ERR("Invalid state detected: %s\n", snd_strerror(state));
@@ -479,11 +498,14 @@ static int ALCplaybackAlsa_mixerProc(void *ptr)
                     continue;
                 }
             }
+            TRACE_BEGIN("BackendWait", 0);
             if(snd_pcm_wait(self->pcmHandle, 1000) == 0)
                 ERR("Wait timeout... buffer size too low?\n");
+            TRACE_END("BackendWait");
             continue;
         }
         avail -= avail%update_size;
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
 
         // it is possible that contiguous areas are smaller, thus we use a loop
         ALCplaybackAlsa_lock(self);
@@ -501,7 +523,9 @@ static int ALCplaybackAlsa_mixerProc(void *ptr)
             WritePtr = (char*)areas->addr + (offset * areas->step / 8);
             aluMixData(device, WritePtr, frames);
 
+            TRACE_BEGIN("BackendCommit", frames);
             commitres = snd_pcm_mmap_commit(self->pcmHandle, offset, frames);
+            TRACE_END("BackendCommit");
             if(commitres < 0 || (commitres-frames) != 0)
             {
                 ERR("mmap commit error: %s\n",
@@ -533,7 +557,8 @@ static int ALCplaybackAlsa_mixerNoMMapProc(void *ptr)
     num_updates = device->NumUpdates;
     while(!self->killNow)
     {
-        int state = verify_state(self->pcmHandle);
+        int state = verify_state(self->pcmHandle, STATIC_CAST(ALCbackend, self),
+                                 BackendStat_Underrun);
         if(state < 0)
         {
             ERR("Invalid state detected: %s\n", snd_strerror(state));
@@ -568,10 +593,13 @@ static int ALCplaybackAlsa_mixerNoMMapProc(void *ptr)
                     continue;
                 }
             }
+            TRACE_BEGIN("BackendWait", 0);
             if(snd_pcm_wait(self->pcmHandle, 1000) == 0)
                 ERR("Wait timeout... buffer size too low?\n");
+            TRACE_END("BackendWait");
             continue;
         }
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
 
         ALCplaybackAlsa_lock(self);
         WritePtr = self->buffer;
@@ -580,7 +608,11 @@ static int ALCplaybackAlsa_mixerNoMMapProc(void *ptr)
 
         while(avail > 0)
         {
-            int ret = snd_pcm_writei(self->pcmHandle, WritePtr, avail);
+            int ret;
+
+            TRACE_BEGIN("BackendCommit", avail);
+            ret = snd_pcm_writei(self->pcmHandle, WritePtr, avail);
+            TRACE_END("BackendCommit");
             switch (ret)
             {
             case -EAGAIN:
@@ -590,9 +622,13 @@ static int ALCplaybackAlsa_mixerNoMMapProc(void *ptr)
 #endif
             case -EPIPE:
             case -EINTR:
+                if(ret == -EPIPE)
+                    ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Underrun);
                 ret = snd_pcm_recover(self->pcmHandle, ret, 1);
                 if(ret < 0)
                     avail = 0;
+                else
+                    ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Recovery);
                 break;
             default:
                 if (ret >= 0)
@@ -616,6 +652,172 @@ static int ALCplaybackAlsa_mixerNoMMapProc(void *ptr)
 }
 
 
+/* Timer-based scheduling: rather than waiting for whole periods to become
+ * available, the mixer keeps only a safety margin (plus one update) queued in
+ * the hardware buffer, and sleeps until the queued amount is expected to drop
+ * back to the margin. The margin starts at one update and doubles whenever the
+ * mixer wakes up too late, then slowly shrinks again while playback is stable.
+ */
+#define TSCHED_DECAY_SECONDS 10
+/* Minimum hardware buffer length, in microseconds. */
+#define TSCHED_BUFFER_TIME 500000
+
+static int ALCplaybackAlsa_mixerTSchedProc(void *ptr)
+{
+    ALCplaybackAlsa *self = (ALCplaybackAlsa*)ptr;
+    ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
+    const snd_pcm_channel_area_t *areas = NULL;
+    snd_pcm_uframes_t update_size, buffer_size;
+    snd_pcm_uframes_t margin, max_margin, stable;
+    snd_pcm_sframes_t avail, delay, commitres;
+    snd_pcm_uframes_t offset, frames, todo;
+    char *WritePtr;
+    int err;
+
+    SetRTPriority();
+    althrd_setname(althrd_current(), MIXER_THREAD_NAME);
+
+    update_size = device->UpdateSize;
+    buffer_size = self->bufferSize;
+    max_margin = buffer_size - update_size;
+    margin = update_size;
+    stable = 0;
+    while(!self->killNow)
+    {
+        ALboolean late = AL_FALSE;
+        int state;
+
+        if(snd_pcm_state(self->pcmHandle) == SND_PCM_STATE_XRUN)
+            late = AL_TRUE;
+        state = verify_state(self->pcmHandle, STATIC_CAST(ALCbackend, self),
+                             BackendStat_Underrun);
+        if(state < 0)
+        {
+            ERR("Invalid state detected: %s\n", snd_strerror(state));
+            ALCplaybackAlsa_lock(self);
+            aluHandleDisconnect(device);
+            ALCplaybackAlsa_unlock(self);
+            break;
+        }
+
+        avail = snd_pcm_avail_update(self->pcmHandle);
+        if(avail < 0)
+        {
+            ERR("available update failed: %s\n", snd_strerror(avail));
+            al_nssleep((unsigned long)((ALuint64)update_size * 1000000000 / device->Frequency));
+            continue;
+        }
+        if((snd_pcm_uframes_t)avail > buffer_size)
+        {
+            WARN("available samples exceeds the buffer size\n");
+            snd_pcm_reset(self->pcmHandle);
+            continue;
+        }
+
+        /* Estimate how much is left to play before the device runs dry. This
+         * includes what's queued past the ring buffer, if the device reports
+         * it. */
+        delay = buffer_size - avail;
+        if(state == SND_PCM_STATE_RUNNING)
+        {
+            if(snd_pcm_delay(self->pcmHandle, &delay) < 0 || delay < 0)
+                delay = buffer_size - avail;
+            /* We planned to wake with the margin still queued. Having less
+             * than half of it left means the margin is too small. */
+            if((snd_pcm_uframes_t)delay < margin/2)
+                late = AL_TRUE;
+        }
+
+        if(late && margin < max_margin)
+        {
+            margin = minu(margin*2, max_margin);
+            TRACE("Increased safety margin to %lu samples\n", margin);
+            stable = 0;
+        }
+        else if(margin > update_size && stable >= device->Frequency*TSCHED_DECAY_SECONDS)
+        {
+            margin -= update_size;
+            TRACE("Decreased safety margin to %lu samples\n", margin);
+            stable = 0;
+        }
+
+        /* Top the buffer up to the margin plus one update, in whole updates. */
+        todo = 0;
+        if((snd_pcm_uframes_t)delay < margin+update_size)
+        {
+            todo = margin + update_size - delay;
+            todo = (todo+update_size-1) / update_size * update_size;
+            todo = minu(todo, avail - avail%update_size);
+        }
+
+        if(todo > 0)
+        {
+            ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
+
+            ALCplaybackAlsa_lock(self);
+            avail = todo;
+            while(avail > 0)
+            {
+                frames = avail;
+
+                err = snd_pcm_mmap_begin(self->pcmHandle, &areas, &offset, &frames);
+                if(err < 0)
+                {
+                    ERR("mmap begin error: %s\n", snd_strerror(err));
+                    break;
+                }
+
+                WritePtr = (char*)areas->addr + (offset * areas->step / 8);
+                aluMixData(device, WritePtr, frames);
+
+                TRACE_BEGIN("BackendCommit", frames);
+                commitres = snd_pcm_mmap_commit(self->pcmHandle, offset, frames);
+                TRACE_END("BackendCommit");
+                if(commitres < 0 || (commitres-frames) != 0)
+                {
+                    ERR("mmap commit error: %s\n",
+                        snd_strerror(commitres >= 0 ? -EPIPE : commitres));
+                    break;
+                }
+
+                avail -= frames;
+            }
+            ALCplaybackAlsa_unlock(self);
+
+            todo -= avail;
+            delay += todo;
+            stable += todo;
+
+            if(state != SND_PCM_STATE_RUNNING)
+            {
+                err = snd_pcm_start(self->pcmHandle);
+                if(err < 0)
+                {
+                    /* Try recovering, and give the device an update's time
+                     * before checking it again rather than spinning. */
+                    ERR("start failed: %s\n", snd_strerror(err));
+                    if(snd_pcm_recover(self->pcmHandle, err, 1) >= 0)
+                        ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Recovery);
+                    al_nssleep((unsigned long)((ALuint64)update_size * 1000000000 /
+                                               device->Frequency));
+                    continue;
+                }
+            }
+        }
+
+        /* Sleep until the queued samples are expected to drop to the margin,
+         * but for at least a quarter update so a full buffer doesn't spin. */
+        frames = ((snd_pcm_uframes_t)delay > margin) ? delay - margin : 0;
+        frames = maxu(frames, update_size/4);
+        TRACE_BEGIN("BackendWait", 0);
+        al_nssleep((unsigned long)((ALuint64)frames * 1000000000 / device->Frequency));
+        TRACE_END("BackendWait");
+    }
+
+    return 0;
+}
+
+
 static ALCenum ALCplaybackAlsa_open(ALCplaybackAlsa *self, const ALCchar *name)
 {
     ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
@@ -672,6 +874,8 @@ static ALCboolean ALCplaybackAlsa_reset(ALCplaybackAlsa *self)
     snd_pcm_hw_params_t *hp = NULL;
     snd_pcm_format_t format = -1;
     snd_pcm_access_t access;
+    snd_pcm_uframes_t bufferSizeInFrames;
+    ALuint updateSize;
     unsigned int periods;
     unsigned int rate;
     const char *funcerr;
@@ -705,10 +909,24 @@ static ALCboolean ALCplaybackAlsa_reset(ALCplaybackAlsa *self)
     }
 
     allowmmap = GetConfigValueBool(al_string_get_cstr(device->DeviceName), "alsa", "mmap", 1);
+    self->tsched = GetConfigValueBool(al_string_get_cstr(device->DeviceName), "alsa", "tsched", 0);
+    if(self->tsched && !allowmmap)
+    {
+        WARN("Timer-based scheduling requires mmap\n");
+        self->tsched = AL_FALSE;
+    }
     periods = device->NumUpdates;
     periodLen = (ALuint64)device->UpdateSize * 1000000 / device->Frequency;
     bufferLen = periodLen * periods;
+    updateSize = device->UpdateSize;
     rate = device->Frequency;
+    /* With timer-based scheduling, the buffer only sets how much can be mixed
+     * ahead under load, so make it large. */
+    if(self->tsched)
+    {
+        bufferLen = maxu(bufferLen, TSCHED_BUFFER_TIME);
+        periodLen = bufferLen / 4;
+    }
 
     snd_pcm_hw_params_malloc(&hp);
 #define CHECK(x) if((funcerr=#x),(err=(x)) < 0) goto error
@@ -793,21 +1011,41 @@ static ALCboolean ALCplaybackAlsa_reset(ALCplaybackAlsa *self)
     CHECK(snd_pcm_hw_params_get_periods(hp, &periods, &dir));
     if(dir != 0)
         WARN("Inexact period count: %u (%d)\n", periods, dir);
+    CHECK(snd_pcm_hw_params_get_buffer_size(hp, &bufferSizeInFrames));
+    if(self->tsched && access != SND_PCM_ACCESS_MMAP_INTERLEAVED)
+    {
+        WARN("Timer-based scheduling requires mmap\n");
+        self->tsched = AL_FALSE;
+    }
 
     snd_pcm_hw_params_free(hp);
     hp = NULL;
     snd_pcm_sw_params_malloc(&sp);
 
     CHECK(snd_pcm_sw_params_current(self->pcmHandle, sp));
-    CHECK(snd_pcm_sw_params_set_avail_min(self->pcmHandle, sp, periodSizeInFrames));
+    /* Period wakeups aren't used with timer-based scheduling. */
+    CHECK(snd_pcm_sw_params_set_avail_min(self->pcmHandle, sp,
+        self->tsched ? bufferSizeInFrames : periodSizeInFrames));
     CHECK(snd_pcm_sw_params_set_stop_threshold(self->pcmHandle, sp, periodSizeInFrames*periods));
     CHECK(snd_pcm_sw_params(self->pcmHandle, sp));
 #undef CHECK
     snd_pcm_sw_params_free(sp);
     sp = NULL;
 
-    device->NumUpdates = periods;
-    device->UpdateSize = periodSizeInFrames;
+    if(self->tsched)
+    {
+        /* Keep the requested update size for mixing and wakeups, rather than
+         * the hardware period. */
+        self->bufferSize = bufferSizeInFrames;
+        device->UpdateSize = mini(updateSize, bufferSizeInFrames/4);
+        device->NumUpdates = bufferSizeInFrames / device->UpdateSize;
+        TRACE("Using timer-based scheduling, %lu sample buffer\n", bufferSizeInFrames);
+    }
+    else
+    {
+        device->NumUpdates = periods;
+        device->UpdateSize = periodSizeInFrames;
+    }
     device->Frequency = rate;
 
     SetDefaultChannelOrder(device);
@@ -858,7 +1096,8 @@ static ALCboolean ALCplaybackAlsa_start(ALCplaybackAlsa *self)
             ERR("snd_pcm_prepare(data->pcmHandle) failed: %s\n", snd_strerror(err));
             return ALC_FALSE;
         }
-        thread_func = ALCplaybackAlsa_mixerProc;
+        thread_func = self->tsched ? ALCplaybackAlsa_mixerTSchedProc :
+                                     ALCplaybackAlsa_mixerProc;
     }
     self->killNow = 0;
     if(althrd_create(&self->thread, thread_func, self) != althrd_success)
@@ -1063,6 +1302,7 @@ static ALCenum ALCcaptureAlsa_open(ALCcaptureAlsa *self, const ALCchar *name)
             ERR("ring buffer create failed\n");
             goto error2;
         }
+        STATIC_CAST(ALCbackend,self)->mCaptureRing = self->ring;
     }
 
     al_string_copy_cstr(&device->DeviceName, name);
@@ -1181,8 +1421,11 @@ static ALCenum ALCcaptureAlsa_captureSamples(ALCcaptureAlsa *self, ALCvoid *buff
 
             if(amt == -EAGAIN)
                 continue;
+            if(amt == -EPIPE)
+                ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Overrun);
             if((amt=snd_pcm_recover(self->pcmHandle, amt, 1)) >= 0)
             {
+                ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Recovery);
                 amt = snd_pcm_start(self->pcmHandle);
                 if(amt >= 0)
                     amt = snd_pcm_avail_update(self->pcmHandle);
@@ -1221,8 +1464,11 @@ static ALCuint ALCcaptureAlsa_availableSamples(ALCcaptureAlsa *self)
     {
         ERR("avail update failed: %s\n", snd_strerror(avail));
 
+        if(avail == -EPIPE)
+            ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Overrun);
         if((avail=snd_pcm_recover(self->pcmHandle, avail, 1)) >= 0)
         {
+            ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Recovery);
             if(self->doCapture)
                 avail = snd_pcm_start(self->pcmHandle);
             if(avail >= 0)
@@ -1248,8 +1494,8 @@ static ALCuint ALCcaptureAlsa_availableSamples(ALCcaptureAlsa *self)
         ll_ringbuffer_data_t vec[2];
         snd_pcm_sframes_t amt;
 
-        ll_ringbuffer_get_write_vector(self->ring, vec);
-        if(vec[0].len == 0) break;
+        if(ll_ringbuffer_write_claim(self->ring, avail, vec) == 0)
+            break;
 
         amt = (vec[0].len < (snd_pcm_uframes_t)avail) ?
               vec[0].len : (snd_pcm_uframes_t)avail;
@@ -1260,8 +1506,11 @@ static ALCuint ALCcaptureAlsa_availableSamples(ALCcaptureAlsa *self)
 
             if(amt == -EAGAIN)
                 continue;
+            if(amt == -EPIPE)
+                ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Overrun);
             if((amt=snd_pcm_recover(self->pcmHandle, amt, 1)) >= 0)
             {
+                ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Recovery);
                 if(self->doCapture)
                     amt = snd_pcm_start(self->pcmHandle);
                 if(amt >= 0)
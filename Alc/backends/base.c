@@ -14,12 +14,40 @@ extern inline ALuint64 GetDeviceClockTime(ALCdevice *device);
 void ALCbackend_Construct(ALCbackend *self, ALCdevice *device)
 {
     int ret = almtx_init(&self->mMutex, almtx_recursive);
+    ALsizei i;
+
     assert(ret == althrd_success);
     self->mDevice = device;
+
+    for(i = 0;i < BackendStat_Count;i++)
+    {
+        ATOMIC_INIT(&self->mStats.Counts[i], 0);
+        self->mStats.Logged[i] = 0;
+    }
+    for(i = 0;i < BACKEND_JITTER_BUCKETS;i++)
+        ATOMIC_INIT(&self->mStats.Jitter[i], 0);
+    self->mStats.LastWakeup = 0;
+
+    ATOMIC_INIT(&self->mMixAhead, 0);
+    self->mMixAheadInPlace = AL_FALSE;
+
+    self->mCaptureRing = NULL;
 }
 
 void ALCbackend_Destruct(ALCbackend *self)
 {
+    BackendStats *stats = &self->mStats;
+    ALuint underruns = ATOMIC_LOAD(&stats->Counts[BackendStat_Underrun]);
+    ALuint overruns = ATOMIC_LOAD(&stats->Counts[BackendStat_Overrun]);
+    ALuint recoveries = ATOMIC_LOAD(&stats->Counts[BackendStat_Recovery]);
+    ALuint late = ATOMIC_LOAD(&stats->Counts[BackendStat_LateWakeup]);
+
+    if(underruns || overruns || recoveries)
+        WARN("%u underruns, %u overruns, %u recoveries, %u late wakeups\n",
+             underruns, overruns, recoveries, late);
+    else
+        TRACE("%u late wakeups\n", late);
+
     almtx_destroy(&self->mMutex);
 }
 
@@ -65,6 +93,74 @@ void ALCbackend_unlock(ALCbackend *self)
 }
 
 
+void ALCbackend_countStat(ALCbackend *self, enum BackendStatType type)
+{
+    ATOMIC_ADD(ALuint, &self->mStats.Counts[type], 1, almemory_order_relaxed);
+}
+
+void ALCbackend_addStat(ALCbackend *self, enum BackendStatType type, ALuint count)
+{
+    ATOMIC_ADD(ALuint, &self->mStats.Counts[type], count, almemory_order_relaxed);
+}
+
+void ALCbackend_logStats(ALCbackend *self)
+{
+    static const char *const names[BackendStat_Count] = {
+        "underruns", "overruns", "recoveries", "late wakeups", "mixer waits"
+    };
+    BackendStats *stats = &self->mStats;
+    ALsizei i;
+
+    for(i = 0;i < BackendStat_Count;i++)
+    {
+        ALuint count = ATOMIC_LOAD(&stats->Counts[i], almemory_order_relaxed);
+        if(count == stats->Logged[i])
+            continue;
+        if(i == BackendStat_Underrun || i == BackendStat_Overrun)
+            WARN("%u %s (%u total)\n", count-stats->Logged[i], names[i], count);
+        else
+            TRACE("%u %s (%u total)\n", count-stats->Logged[i], names[i], count);
+        stats->Logged[i] = count;
+    }
+}
+
+void ALCbackend_markWakeup(ALCbackend *self)
+{
+    ALCdevice *device = self->mDevice;
+    BackendStats *stats = &self->mStats;
+    ALuint64 now = GetMonotonicTime();
+    ALuint64 period, interval, jitter;
+    ALsizei bucket;
+
+    if(stats->LastWakeup == 0)
+    {
+        stats->LastWakeup = now;
+        return;
+    }
+    interval = now - stats->LastWakeup;
+    stats->LastWakeup = now;
+
+    period = (ALuint64)device->UpdateSize * DEVICE_CLOCK_RES / device->Frequency;
+    jitter = (interval > period) ? interval-period : period-interval;
+    if(interval > period && jitter > period/2)
+        ALCbackend_countStat(self, BackendStat_LateWakeup);
+
+    jitter /= 1000;
+    bucket = 0;
+    while(jitter > 0 && bucket < BACKEND_JITTER_BUCKETS-1)
+    {
+        jitter >>= 1;
+        bucket++;
+    }
+    ATOMIC_ADD(ALuint, &stats->Jitter[bucket], 1, almemory_order_relaxed);
+}
+
+void ALCbackend_resetWakeup(ALCbackend *self)
+{
+    self->mStats.LastWakeup = 0;
+}
+
+
 /* Base ALCbackendFactory method implementations. */
 void ALCbackendFactory_deinit(ALCbackendFactory* UNUSED(self))
 {
@@ -20,6 +20,40 @@ inline ALuint64 GetDeviceClockTime(ALCdevice *device)
 }
 
 
+enum BackendStatType {
+    /* The device ran out of samples to play. */
+    BackendStat_Underrun,
+    /* The device had more captured samples than it could hold. */
+    BackendStat_Overrun,
+    /* The device was restarted after an xrun or suspend. */
+    BackendStat_Recovery,
+    /* The mixing thread or callback ran more than half an update late. */
+    BackendStat_LateWakeup,
+    /* The mixer blocked waiting for its mixing worker threads. */
+    BackendStat_MixerWait,
+
+    BackendStat_Count
+};
+
+/* Wakeup jitter is counted in power-of-two buckets of microseconds. The first
+ * bucket holds jitter under 1us, and bucket i holds [2^(i-1), 2^i) us.
+ */
+#define BACKEND_JITTER_BUCKETS 24
+
+typedef struct BackendStats {
+    ATOMIC(ALuint) Counts[BackendStat_Count];
+    ATOMIC(ALuint) Jitter[BACKEND_JITTER_BUCKETS];
+
+    /* Time of the last wakeup, in nanoseconds. Only accessed from the mixing
+     * thread or callback, and cleared before the backend starts.
+     */
+    ALuint64 LastWakeup;
+
+    /* Counts as of the last ALCbackend_logStats call. */
+    ALuint Logged[BackendStat_Count];
+} BackendStats;
+
+
 struct ALCbackendVtable;
 
 typedef struct ALCbackend {
@@ -28,6 +62,22 @@ typedef struct ALCbackend {
     ALCdevice *mDevice;
 
     almtx_t mMutex;
+
+    BackendStats mStats;
+
+    /* Backends that can change how many updates they keep mixed ahead without
+     * being reset set mMixAheadInPlace, and limit themselves to mMixAhead
+     * updates (when non-0) as set by the device's latency controller. Other
+     * backends are reset with a new NumUpdates instead.
+     */
+    ATOMIC(ALuint) mMixAhead;
+    ALboolean mMixAheadInPlace;
+
+    /* Capture backends that buffer whole frames of the device's format in a
+     * ring buffer, and read from it without any conversion, set this so the
+     * captured samples can be mapped in place.
+     */
+    struct ll_ringbuffer *mCaptureRing;
 } ALCbackend;
 
 void ALCbackend_Construct(ALCbackend *self, ALCdevice *device);
@@ -39,6 +89,23 @@ ClockLatency ALCbackend_getClockLatency(ALCbackend *self);
 void ALCbackend_lock(ALCbackend *self);
 void ALCbackend_unlock(ALCbackend *self);
 
+/* Counts an xrun, recovery, or late wakeup. Safe to call from real-time
+ * threads, as it doesn't lock or log.
+ */
+void ALCbackend_countStat(ALCbackend *self, enum BackendStatType type);
+/* Counts a number of the same event at once. */
+void ALCbackend_addStat(ALCbackend *self, enum BackendStatType type, ALuint count);
+/* Logs any counts that changed since the last call. Must not be called from
+ * the mixing thread or callback, and only with the device's BackendLock held.
+ */
+void ALCbackend_logStats(ALCbackend *self);
+/* Called by the mixing thread or callback each time it's woken up to process
+ * an update, to measure how far the wakeups stray from the update period.
+ */
+void ALCbackend_markWakeup(ALCbackend *self);
+/* Restarts wakeup measurement, for when the backend is (re)started. */
+void ALCbackend_resetWakeup(ALCbackend *self);
+
 struct ALCbackendVtable {
     void (*const Destruct)(ALCbackend*);
 
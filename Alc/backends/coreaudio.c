@@ -28,6 +28,8 @@
 #include "alMain.h"
 #include "alu.h"
 
+#include "backends/base.h"
+
 #include <CoreServices/CoreServices.h>
 #include <unistd.h>
 #include <AudioUnit/AudioUnit.h>
@@ -89,6 +91,7 @@ static OSStatus ca_callback(void *inRefCon, AudioUnitRenderActionFlags *ioAction
     ALCdevice *device = (ALCdevice*)inRefCon;
     ca_data *data = (ca_data*)device->ExtraData;
 
+    ALCbackend_markWakeup(device->Backend);
     aluMixData(device, ioData->mBuffers[0].mData,
                ioData->mBuffers[0].mDataByteSize / data->frameSize);
 
@@ -276,6 +276,7 @@ FORCE_ALIGN static int ALCdsoundPlayback_mixerProc(void *ptr)
             continue;
         }
         avail -= avail%FragSize;
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
 
         // Lock output buffer
         WriteCnt1 = 0;
@@ -289,6 +290,7 @@ FORCE_ALIGN static int ALCdsoundPlayback_mixerProc(void *ptr)
             err = IDirectSoundBuffer_Restore(self->Buffer);
             if(SUCCEEDED(err))
             {
+                ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Recovery);
                 Playing = FALSE;
                 LastCursor = 0;
                 err = IDirectSoundBuffer_Lock(self->Buffer, 0, DSBCaps.dwBufferBytes, &WritePtr1, &WriteCnt1, &WritePtr2, &WriteCnt2, 0);
@@ -832,6 +834,8 @@ static ALCenum ALCdsoundCapture_open(ALCdsoundCapture *self, const ALCchar *devi
                                            InputType.Format.nBlockAlign);
          if(self->Ring == NULL)
              hr = DSERR_OUTOFMEMORY;
+         else
+             STATIC_CAST(ALCbackend,self)->mCaptureRing = self->Ring;
     }
 
     if(FAILED(hr))
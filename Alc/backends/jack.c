@@ -28,6 +28,7 @@
 #include "alu.h"
 #include "threads.h"
 #include "compat.h"
+#include "trace.h"
 
 #include "backends/base.h"
 
@@ -57,6 +58,7 @@ static const ALCchar jackDevice[] = "JACK Default";
     MAGIC(jack_set_error_function); \
     MAGIC(jack_set_process_callback); \
     MAGIC(jack_set_buffer_size_callback); \
+    MAGIC(jack_set_xrun_callback); \
     MAGIC(jack_set_buffer_size);   \
     MAGIC(jack_get_buffer_size);
 
@@ -82,6 +84,7 @@ JACK_FUNCS(MAKE_FUNC);
 #define jack_set_error_function pjack_set_error_function
 #define jack_set_process_callback pjack_set_process_callback
 #define jack_set_buffer_size_callback pjack_set_buffer_size_callback
+#define jack_set_xrun_callback pjack_set_xrun_callback
 #define jack_set_buffer_size pjack_set_buffer_size
 #define jack_get_buffer_size pjack_get_buffer_size
 #endif
@@ -134,6 +137,11 @@ typedef struct ALCjackPlayback {
     jack_client_t *Client;
     jack_port_t *Port[MAX_OUTPUT_CHANNELS];
 
+    /* When set, the process callback mixes straight into the port buffers,
+     * and neither the ring buffer nor the mixer thread are used.
+     */
+    ALboolean DirectMix;
+
     ll_ringbuffer_t *Ring;
     alcnd_t Cond;
 
@@ -142,8 +150,10 @@ typedef struct ALCjackPlayback {
 } ALCjackPlayback;
 
 static int ALCjackPlayback_bufferSizeNotify(jack_nframes_t numframes, void *arg);
+static int ALCjackPlayback_xrunNotify(void *arg);
 
 static int ALCjackPlayback_process(jack_nframes_t numframes, void *arg);
+static void ALCjackPlayback_processDirect(ALCjackPlayback *self, jack_default_audio_sample_t **out, ALuint numchans, jack_nframes_t numframes);
 static int ALCjackPlayback_mixerProc(void *arg);
 
 static void ALCjackPlayback_Construct(ALCjackPlayback *self, ALCdevice *device);
@@ -175,6 +185,7 @@ static void ALCjackPlayback_Construct(ALCjackPlayback *self, ALCdevice *device)
     self->Client = NULL;
     for(i = 0;i < MAX_OUTPUT_CHANNELS;i++)
         self->Port[i] = NULL;
+    self->DirectMix = AL_FALSE;
     self->Ring = NULL;
 
     self->killNow = 1;
@@ -213,6 +224,13 @@ static int ALCjackPlayback_bufferSizeNotify(jack_nframes_t numframes, void *arg)
     device->NumUpdates = 2;
     TRACE("%u update size x%u\n", device->UpdateSize, device->NumUpdates);
 
+    /* Direct mixing handles any period size as-is. */
+    if(self->DirectMix)
+    {
+        ALCjackPlayback_unlock(self);
+        return 0;
+    }
+
     bufsize = device->UpdateSize;
     if(ConfigValueUInt(al_string_get_cstr(device->DeviceName), "jack", "buffer-size", &bufsize))
         bufsize = maxu(NextPowerOf2(bufsize), device->UpdateSize);
@@ -229,6 +247,13 @@ static int ALCjackPlayback_bufferSizeNotify(jack_nframes_t numframes, void *arg)
     return 0;
 }
 
+static int ALCjackPlayback_xrunNotify(void *arg)
+{
+    ALCjackPlayback *self = arg;
+    ALCbackend_countStat(STATIC_CAST(ALCbackend,self), BackendStat_Underrun);
+    return 0;
+}
+
 
 static int ALCjackPlayback_process(jack_nframes_t numframes, void *arg)
 {
@@ -239,13 +264,21 @@ static int ALCjackPlayback_process(jack_nframes_t numframes, void *arg)
     jack_nframes_t todo;
     ALuint i, c, numchans;
 
-    ll_ringbuffer_get_read_vector(self->Ring, data);
+    ALCbackend_markWakeup(STATIC_CAST(ALCbackend,self));
 
     for(c = 0;c < MAX_OUTPUT_CHANNELS && self->Port[c];c++)
         out[c] = jack_port_get_buffer(self->Port[c], numframes);
     numchans = c;
 
-    todo = minu(numframes, data[0].len);
+    if(self->DirectMix)
+    {
+        ALCjackPlayback_processDirect(self, out, numchans, numframes);
+        return 0;
+    }
+
+    ll_ringbuffer_read_claim(self->Ring, numframes, data);
+
+    todo = data[0].len;
     for(c = 0;c < numchans;c++)
     {
         for(i = 0;i < todo;i++)
@@ -254,7 +287,7 @@ static int ALCjackPlayback_process(jack_nframes_t numframes, void *arg)
     }
     total += todo;
 
-    todo = minu(numframes-total, data[1].len);
+    todo = data[1].len;
     if(todo > 0)
     {
         for(c = 0;c < numchans;c++)
@@ -282,6 +315,66 @@ static int ALCjackPlayback_process(jack_nframes_t numframes, void *arg)
     return 0;
 }
 
+static ALuint64 ALCjackPlayback_getNanoseconds(void)
+{
+    struct timespec ts;
+    if(altimespec_get(&ts, AL_TIME_MONOTONIC) != AL_TIME_MONOTONIC &&
+       altimespec_get(&ts, AL_TIME_UTC) != AL_TIME_UTC)
+        return 0;
+    return (ALuint64)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* Acquires the backend lock without sleeping. AL calls like alSourcePlay hold
+ * it only briefly, so rather than giving up the period on the first failed
+ * try, keep retrying for up to a quarter of the period.
+ */
+static ALboolean ALCjackPlayback_tryLockDirect(ALCjackPlayback *self, jack_nframes_t numframes)
+{
+    ALCdevice *device = STATIC_CAST(ALCbackend,self)->mDevice;
+    almtx_t *mtx = &STATIC_CAST(ALCbackend,self)->mMutex;
+    ALuint64 start, limit;
+
+    if(almtx_trylock(mtx) == althrd_success)
+        return AL_TRUE;
+
+    limit = (ALuint64)numframes * 250000000 / device->Frequency;
+    start = ALCjackPlayback_getNanoseconds();
+    do {
+        if(almtx_trylock(mtx) == althrd_success)
+            return AL_TRUE;
+    } while(ALCjackPlayback_getNanoseconds()-start < limit);
+    return AL_FALSE;
+}
+
+static void ALCjackPlayback_processDirect(ALCjackPlayback *self, jack_default_audio_sample_t **out, ALuint numchans, jack_nframes_t numframes)
+{
+    ALCdevice *device = STATIC_CAST(ALCbackend,self)->mDevice;
+    ALuint i, c;
+
+    /* This runs in JACK's real-time thread, so it must never block. If the
+     * device stays locked (e.g. for a reset), output silence for this period
+     * instead of waiting on it.
+     */
+    if(ALCjackPlayback_tryLockDirect(self, numframes))
+    {
+        if(device->Connected)
+        {
+            aluMixDataPlanar(device, out, AL_FALSE, numframes);
+            ALCjackPlayback_unlock(self);
+            return;
+        }
+        ALCjackPlayback_unlock(self);
+    }
+    else
+        ALCbackend_countStat(STATIC_CAST(ALCbackend,self), BackendStat_Underrun);
+
+    for(c = 0;c < numchans;c++)
+    {
+        for(i = 0;i < numframes;i++)
+            out[c][i] = 0.0f;
+    }
+}
+
 static int ALCjackPlayback_mixerProc(void *arg)
 {
     ALCjackPlayback *self = arg;
@@ -294,7 +387,7 @@ static int ALCjackPlayback_mixerProc(void *arg)
     ALCjackPlayback_lock(self);
     while(!self->killNow && device->Connected)
     {
-        ALuint todo, len1, len2;
+        ALuint len1, len2, limit;
 
         /* NOTE: Unfortunately, there is an unavoidable race condition here.
          * It's possible for the process() method to run, updating the read
@@ -310,23 +403,29 @@ static int ALCjackPlayback_mixerProc(void *arg)
          * used to catch up, but there's no way around it without blocking in
          * the process() method.
          */
-        if(ll_ringbuffer_write_space(self->Ring) < device->UpdateSize)
+        /* Don't fill past what the latency controller asks for, if set. */
+        limit = ATOMIC_LOAD(&STATIC_CAST(ALCbackend,self)->mMixAhead, almemory_order_relaxed);
+        if((limit && ll_ringbuffer_read_space(self->Ring) >= limit*device->UpdateSize) ||
+           ll_ringbuffer_write_claim(self->Ring, device->UpdateSize, data) < device->UpdateSize)
         {
+            TRACE_BEGIN("BackendWait", 0);
             alcnd_wait(&self->Cond, &STATIC_CAST(ALCbackend,self)->mMutex);
+            TRACE_END("BackendWait");
             continue;
         }
 
-        ll_ringbuffer_get_write_vector(self->Ring, data);
-        todo  = data[0].len + data[1].len;
-        todo -= todo%device->UpdateSize;
-
-        len1 = minu(data[0].len, todo);
-        len2 = minu(data[1].len, todo-len1);
+        /* Mix an update at a time directly into the claimed space. Until the
+         * ring is full, the claims don't need to look at the read pointer.
+         */
+        len1 = data[0].len;
+        len2 = data[1].len;
 
         aluMixData(device, data[0].buf, len1);
         if(len2 > 0)
             aluMixData(device, data[1].buf, len2);
-        ll_ringbuffer_write_advance(self->Ring, todo);
+        TRACE_BEGIN("BackendCommit", len1+len2);
+        ll_ringbuffer_write_advance(self->Ring, len1+len2);
+        TRACE_END("BackendCommit");
     }
     ALCjackPlayback_unlock(self);
 
@@ -361,6 +460,7 @@ static ALCenum ALCjackPlayback_open(ALCjackPlayback *self, const ALCchar *name)
 
     jack_set_process_callback(self->Client, ALCjackPlayback_process, self);
     jack_set_buffer_size_callback(self->Client, ALCjackPlayback_bufferSizeNotify, self);
+    jack_set_xrun_callback(self->Client, ALCjackPlayback_xrunNotify, self);
 
     al_string_copy_cstr(&device->DeviceName, name);
 
@@ -406,6 +506,22 @@ static ALCboolean ALCjackPlayback_reset(ALCjackPlayback *self)
     bufsize = device->UpdateSize;
     if(ConfigValueUInt(al_string_get_cstr(device->DeviceName), "jack", "buffer-size", &bufsize))
         bufsize = maxu(NextPowerOf2(bufsize), device->UpdateSize);
+    /* Leave room for the most the latency controller may ask for. */
+    if(device->LatencyCtl.Enabled)
+        bufsize = maxu(bufsize, device->LatencyCtl.MaxUpdates*device->UpdateSize);
+
+    /* Mixing directly in the process callback only produces one period at a
+     * time, so it can't keep more buffered than that. Fall back to the ring
+     * buffer and mixer thread if more was asked for.
+     */
+    self->DirectMix = GetConfigValueBool(al_string_get_cstr(device->DeviceName), "jack",
+                                         "direct-mix", 0);
+    if(self->DirectMix && bufsize > device->UpdateSize)
+    {
+        WARN("Buffer size %u doesn't match the period size %u, disabling direct mixing\n",
+             bufsize, device->UpdateSize);
+        self->DirectMix = AL_FALSE;
+    }
     bufsize += device->UpdateSize;
 
     /* Force 32-bit float output. */
@@ -440,12 +556,18 @@ static ALCboolean ALCjackPlayback_reset(ALCjackPlayback *self)
     }
 
     ll_ringbuffer_free(self->Ring);
-    self->Ring = ll_ringbuffer_create(bufsize, FrameSizeFromDevFmt(device->FmtChans, device->FmtType));
-    if(!self->Ring)
+    self->Ring = NULL;
+    if(!self->DirectMix)
     {
-        ERR("Failed to allocate ringbuffer\n");
-        return ALC_FALSE;
+        self->Ring = ll_ringbuffer_create(bufsize, FrameSizeFromDevFmt(device->FmtChans, device->FmtType));
+        if(!self->Ring)
+        {
+            ERR("Failed to allocate ringbuffer\n");
+            return ALC_FALSE;
+        }
     }
+    TRACE("Using %s mixing\n", self->DirectMix ? "direct" : "ring buffer");
+    STATIC_CAST(ALCbackend,self)->mMixAheadInPlace = !self->DirectMix;
 
     SetDefaultChannelOrder(device);
 
@@ -483,6 +605,8 @@ static ALCboolean ALCjackPlayback_start(ALCjackPlayback *self)
     jack_free(ports);
 
     self->killNow = 0;
+    if(self->DirectMix)
+        return ALC_TRUE;
     if(althrd_create(&self->thread, ALCjackPlayback_mixerProc, self) != althrd_success)
     {
         jack_deactivate(self->Client);
@@ -500,6 +624,11 @@ static void ALCjackPlayback_stop(ALCjackPlayback *self)
         return;
 
     self->killNow = 1;
+    if(self->DirectMix)
+    {
+        jack_deactivate(self->Client);
+        return;
+    }
     /* Lock the backend to ensure we don't flag the mixer to die and signal the
      * mixer to wake up in between it checking the flag and going to sleep and
      * wait for a wakeup (potentially leading to it never waking back up to see
@@ -520,8 +649,11 @@ static ClockLatency ALCjackPlayback_getClockLatency(ALCjackPlayback *self)
 
     ALCjackPlayback_lock(self);
     ret.ClockTime = GetDeviceClockTime(device);
-    ret.Latency = ll_ringbuffer_read_space(self->Ring) * DEVICE_CLOCK_RES /
-                  device->Frequency;
+    if(self->Ring)
+        ret.Latency = ll_ringbuffer_read_space(self->Ring) * DEVICE_CLOCK_RES /
+                      device->Frequency;
+    else
+        ret.Latency = 0;
     ALCjackPlayback_unlock(self);
 
     return ret;
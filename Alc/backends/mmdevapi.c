@@ -598,6 +598,7 @@ FORCE_ALIGN static int ALCmmdevPlayback_mixerProc(void *arg)
             continue;
         }
         len -= len%update_size;
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
 
         hr = IAudioRenderClient_GetBuffer(self->render, len, &buffer);
         if(SUCCEEDED(hr))
@@ -1622,6 +1623,7 @@ static HRESULT ALCmmdevCapture_resetProxy(ALCmmdevCapture *self)
         ERR("Failed to allocate capture ring buffer\n");
         return E_OUTOFMEMORY;
     }
+    STATIC_CAST(ALCbackend,self)->mCaptureRing = self->Ring;
 
     hr = IAudioClient_SetEventHandle(self->client, self->NotifyEvent);
     if(FAILED(hr))
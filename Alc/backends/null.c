@@ -29,6 +29,7 @@
 #include "alu.h"
 #include "threads.h"
 #include "compat.h"
+#include "trace.h"
 
 #include "backends/base.h"
 
@@ -105,8 +106,14 @@ static int ALCnullBackend_mixerProc(void *ptr)
             done = avail - device->UpdateSize;
         }
 
+        if(avail-done >= device->UpdateSize)
+            ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
         if(avail-done < device->UpdateSize)
+        {
+            TRACE_BEGIN("BackendWait", 0);
             al_nssleep(restTime);
+            TRACE_END("BackendWait");
+        }
         else while(avail-done >= device->UpdateSize)
         {
             aluMixData(device, NULL, device->UpdateSize);
@@ -27,6 +27,8 @@
 #include "alu.h"
 #include "threads.h"
 
+#include "backends/base.h"
+
 #include <SLES/OpenSLES.h>
 #include <SLES/OpenSLES_Android.h>
 
@@ -134,6 +136,7 @@ static void opensl_callback(SLAndroidSimpleBufferQueueItf bq, void *context)
     ALvoid *buf;
     SLresult result;
 
+    ALCbackend_markWakeup(Device->Backend);
     buf = (ALbyte*)data->buffer + data->curBuffer*data->bufferSize;
     aluMixData(Device, buf, data->bufferSize/data->frameSize);
 
@@ -37,6 +37,8 @@
 #include "alu.h"
 #include "threads.h"
 #include "compat.h"
+#include "trace.h"
+#include "converter.h"
 
 #include "backends/base.h"
 
@@ -270,6 +272,9 @@ static int ALCplaybackOSS_mixerProc(void *ptr)
     ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
     ALint frameSize;
     ssize_t wrote;
+#ifdef SNDCTL_DSP_GETERROR
+    audio_errinfo errinfo;
+#endif
 
     SetRTPriority();
     althrd_setname(althrd_current(), MIXER_THREAD_NAME);
@@ -281,10 +286,22 @@ static int ALCplaybackOSS_mixerProc(void *ptr)
         ALint len = self->data_size;
         ALubyte *WritePtr = self->mix_data;
 
+#ifdef SNDCTL_DSP_GETERROR
+        /* OSS4 reports the underruns since the last query. */
+        if(ioctl(self->fd, SNDCTL_DSP_GETERROR, &errinfo) == 0 && errinfo.play_underruns > 0)
+            ALCbackend_addStat(STATIC_CAST(ALCbackend, self), BackendStat_Underrun,
+                               errinfo.play_underruns);
+#endif
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
         aluMixData(device, WritePtr, len/frameSize);
         while(len > 0 && !self->killNow)
         {
+            /* The write blocks until there's room, so this is both the wait
+             * and the commit.
+             */
+            TRACE_BEGIN("BackendCommit", len/frameSize);
             wrote = write(self->fd, WritePtr, len);
+            TRACE_END("BackendCommit");
             if(wrote < 0)
             {
                 if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
@@ -487,6 +504,17 @@ typedef struct ALCcaptureOSS {
     ll_ringbuffer_t *ring;
     int doCapture;
 
+    /* Set when the device can't capture the requested format, to convert the
+     * frames read from it before they go into the ring.
+     */
+    SampleConverter *sampleConv;
+    ChannelConverter *chanConv;
+    ALvoid *readBuf;
+    ALfloat *chanBuf;
+    ALuint readBufSize;
+    ALuint hwFrameSize;
+    ALuint hwFrequency;
+
     volatile int killNow;
     althrd_t thread;
 } ALCcaptureOSS;
@@ -509,6 +537,34 @@ DECLARE_DEFAULT_ALLOCATORS(ALCcaptureOSS)
 DEFINE_ALCBACKEND_VTABLE(ALCcaptureOSS);
 
 
+/* Converts the frames read into readBuf, and writes them to the ring. */
+static void ALCcaptureOSS_convertInput(ALCcaptureOSS *self, ALsizei frames)
+{
+    ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
+    const ALvoid *src = self->readBuf;
+    ll_ringbuffer_data_t vec[2];
+    ALsizei written;
+
+    if(self->chanConv)
+    {
+        ChannelConverterInput(self->chanConv, src, self->chanBuf, frames);
+        src = self->chanBuf;
+    }
+
+    ll_ringbuffer_write_claim(self->ring,
+        (size_t)((ALuint64)frames*device->Frequency/self->hwFrequency) + 1, vec
+    );
+    written = SampleConverterInput(self->sampleConv, &src, &frames, vec[0].buf,
+                                   (ALsizei)vec[0].len);
+    if(frames > 0 && vec[1].len > 0)
+        written += SampleConverterInput(self->sampleConv, &src, &frames, vec[1].buf,
+                                        (ALsizei)vec[1].len);
+    ll_ringbuffer_write_advance(self->ring, written);
+
+    if(frames > 0)
+        ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Overrun);
+}
+
 static int ALCcaptureOSS_recordProc(void *ptr)
 {
     ALCcaptureOSS *self = (ALCcaptureOSS*)ptr;
@@ -528,20 +584,30 @@ static int ALCcaptureOSS_recordProc(void *ptr)
         amt = 0;
         if(self->doCapture)
         {
-            ll_ringbuffer_get_write_vector(self->ring, vec);
-            if(vec[0].len > 0)
+            ll_ringbuffer_write_claim(self->ring, device->UpdateSize, vec);
+            if(self->sampleConv)
             {
+                /* Read about as much as will fit in the ring once converted. */
+                ALuint64 todo = (ALuint64)(vec[0].len+vec[1].len) * self->hwFrequency /
+                                device->Frequency;
+                todo = minu64(todo, self->readBufSize);
+                if(todo > 0)
+                    amt = read(self->fd, self->readBuf, todo*self->hwFrameSize);
+            }
+            else if(vec[0].len > 0)
                 amt = read(self->fd, vec[0].buf, vec[0].len*frameSize);
-                if(amt < 0)
-                {
-                    ERR("read failed: %s\n", strerror(errno));
-                    ALCcaptureOSS_lock(self);
-                    aluHandleDisconnect(device);
-                    ALCcaptureOSS_unlock(self);
-                    break;
-                }
-                ll_ringbuffer_write_advance(self->ring, amt/frameSize);
+            if(amt < 0)
+            {
+                ERR("read failed: %s\n", strerror(errno));
+                ALCcaptureOSS_lock(self);
+                aluHandleDisconnect(device);
+                ALCcaptureOSS_unlock(self);
+                break;
             }
+            if(self->sampleConv)
+                ALCcaptureOSS_convertInput(self, amt/self->hwFrameSize);
+            else
+                ll_ringbuffer_write_advance(self->ring, amt/frameSize);
         }
         if(amt == 0)
         {
@@ -558,12 +624,29 @@ static void ALCcaptureOSS_Construct(ALCcaptureOSS *self, ALCdevice *device)
 {
     ALCbackend_Construct(STATIC_CAST(ALCbackend, self), device);
     SET_VTABLE2(ALCcaptureOSS, ALCbackend, self);
+
+    self->sampleConv = NULL;
+    self->chanConv = NULL;
+    self->readBuf = NULL;
+    self->chanBuf = NULL;
+}
+
+static void ALCcaptureOSS_freeConverters(ALCcaptureOSS *self)
+{
+    DestroySampleConverter(&self->sampleConv);
+    DestroyChannelConverter(&self->chanConv);
+    al_free(self->readBuf);
+    self->readBuf = NULL;
+    al_free(self->chanBuf);
+    self->chanBuf = NULL;
 }
 
 static ALCenum ALCcaptureOSS_open(ALCcaptureOSS *self, const ALCchar *name)
 {
     ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
     struct oss_device *dev = &oss_capture;
+    enum DevFmtChannels hwChans;
+    enum DevFmtType hwType;
     int numFragmentsLogSize;
     int log2FragmentSize;
     unsigned int periods;
@@ -610,8 +693,9 @@ static ALCenum ALCcaptureOSS_open(ALCcaptureOSS *self, const ALCchar *name)
         case DevFmtInt:
         case DevFmtUInt:
         case DevFmtFloat:
-            ERR("%s capture samples not supported\n", DevFmtTypeString(device->FmtType));
-            return ALC_INVALID_VALUE;
+            /* Captured as 16-bit and converted. */
+            ossFormat = AFMT_S16_NE;
+            break;
     }
 
     periods = 4;
@@ -645,7 +729,11 @@ static ALCenum ALCcaptureOSS_open(ALCcaptureOSS *self, const ALCchar *name)
     }
 #undef CHECKERR
 
-    if((int)ChannelsFromDevFmt(device->FmtChans) != numChannels)
+    if((int)ChannelsFromDevFmt(device->FmtChans) == numChannels)
+        hwChans = device->FmtChans;
+    else if(numChannels == 1 || numChannels == 2)
+        hwChans = (numChannels == 1) ? DevFmtMono : DevFmtStereo;
+    else
     {
         ERR("Failed to set %s, got %d channels instead\n", DevFmtChannelsString(device->FmtChans), numChannels);
         close(self->fd);
@@ -653,9 +741,13 @@ static ALCenum ALCcaptureOSS_open(ALCcaptureOSS *self, const ALCchar *name)
         return ALC_INVALID_VALUE;
     }
 
-    if(!((ossFormat == AFMT_S8 && device->FmtType == DevFmtByte) ||
-         (ossFormat == AFMT_U8 && device->FmtType == DevFmtUByte) ||
-         (ossFormat == AFMT_S16_NE && device->FmtType == DevFmtShort)))
+    if(ossFormat == AFMT_S8)
+        hwType = DevFmtByte;
+    else if(ossFormat == AFMT_U8)
+        hwType = DevFmtUByte;
+    else if(ossFormat == AFMT_S16_NE)
+        hwType = DevFmtShort;
+    else
     {
         ERR("Failed to set %s samples, got OSS format %#x\n", DevFmtTypeString(device->FmtType), ossFormat);
         close(self->fd);
@@ -663,20 +755,59 @@ static ALCenum ALCcaptureOSS_open(ALCcaptureOSS *self, const ALCchar *name)
         return ALC_INVALID_VALUE;
     }
 
+    /* Convert what the device gives to what was asked for, if they differ. */
+    if(hwChans != device->FmtChans || hwType != device->FmtType ||
+       (ALuint)ossSpeed != device->Frequency)
+    {
+        enum DevFmtType srcType = hwType;
+
+        TRACE("Converting %s %s %dhz capture to %s %s %uhz\n", DevFmtChannelsString(hwChans),
+              DevFmtTypeString(hwType), ossSpeed, DevFmtChannelsString(device->FmtChans),
+              DevFmtTypeString(device->FmtType), device->Frequency);
+
+        self->hwFrameSize = numChannels * BytesFromDevFmt(hwType);
+        self->hwFrequency = ossSpeed;
+        self->readBufSize = (ALuint64)device->UpdateSize*ossSpeed/device->Frequency + 1;
+        self->readBuf = al_malloc_tag(AllocTag_Device, 16, self->readBufSize*self->hwFrameSize);
+        if(hwChans != device->FmtChans)
+        {
+            self->chanConv = CreateChannelConverter(hwType, hwChans, device->FmtChans);
+            self->chanBuf = al_malloc_tag(AllocTag_Device, 16, self->readBufSize *
+                ChannelsFromDevFmt(device->FmtChans) * sizeof(ALfloat));
+            srcType = DevFmtFloat;
+        }
+        self->sampleConv = CreateSampleConverter(srcType, device->FmtType,
+            ChannelsFromDevFmt(device->FmtChans), ossSpeed, device->Frequency
+        );
+        if(!self->readBuf || !self->sampleConv ||
+           (hwChans != device->FmtChans && (!self->chanConv || !self->chanBuf)))
+        {
+            ERR("Failed to convert %s %s capture samples\n", DevFmtChannelsString(hwChans),
+                DevFmtTypeString(hwType));
+            ALCcaptureOSS_freeConverters(self);
+            close(self->fd);
+            self->fd = -1;
+            return ALC_INVALID_VALUE;
+        }
+    }
+
     self->ring = ll_ringbuffer_create(device->UpdateSize*device->NumUpdates + 1, frameSize);
     if(!self->ring)
     {
         ERR("Ring buffer create failed\n");
+        ALCcaptureOSS_freeConverters(self);
         close(self->fd);
         self->fd = -1;
         return ALC_OUT_OF_MEMORY;
     }
+    STATIC_CAST(ALCbackend,self)->mCaptureRing = self->ring;
 
     self->killNow = 0;
     if(althrd_create(&self->thread, ALCcaptureOSS_recordProc, self) != althrd_success)
     {
         ll_ringbuffer_free(self->ring);
         self->ring = NULL;
+        ALCcaptureOSS_freeConverters(self);
         close(self->fd);
         self->fd = -1;
         return ALC_OUT_OF_MEMORY;
@@ -699,6 +830,8 @@ static void ALCcaptureOSS_close(ALCcaptureOSS *self)
 
     ll_ringbuffer_free(self->ring);
     self->ring = NULL;
+
+    ALCcaptureOSS_freeConverters(self);
 }
 
 static ALCboolean ALCcaptureOSS_start(ALCcaptureOSS *self)
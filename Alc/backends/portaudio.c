@@ -173,10 +173,13 @@ static void ALCportPlayback_Destruct(ALCportPlayback *self)
 
 static int ALCportPlayback_WriteCallback(const void *UNUSED(inputBuffer), void *outputBuffer,
     unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo *UNUSED(timeInfo),
-    const PaStreamCallbackFlags UNUSED(statusFlags), void *userData)
+    const PaStreamCallbackFlags statusFlags, void *userData)
 {
     ALCportPlayback *self = userData;
 
+    if((statusFlags&paOutputUnderflow))
+        ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Underrun);
+    ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
     aluMixData(STATIC_CAST(ALCbackend, self)->mDevice, outputBuffer, framesPerBuffer);
     return 0;
 }
@@ -372,13 +375,19 @@ static void ALCportCapture_Destruct(ALCportCapture *self)
 
 static int ALCportCapture_ReadCallback(const void *inputBuffer, void *UNUSED(outputBuffer),
     unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo *UNUSED(timeInfo),
-    const PaStreamCallbackFlags UNUSED(statusFlags), void *userData)
+    const PaStreamCallbackFlags statusFlags, void *userData)
 {
     ALCportCapture *self = userData;
     size_t writable = ll_ringbuffer_write_space(self->ring);
 
+    if((statusFlags&paInputOverflow))
+        ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Overrun);
+    ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
     if(framesPerBuffer > writable)
+    {
+        ALCbackend_countStat(STATIC_CAST(ALCbackend, self), BackendStat_Overrun);
         framesPerBuffer = writable;
+    }
     ll_ringbuffer_write(self->ring, inputBuffer, framesPerBuffer);
     return 0;
 }
@@ -401,6 +410,7 @@ static ALCenum ALCportCapture_open(ALCportCapture *self, const ALCchar *name)
 
     self->ring = ll_ringbuffer_create(samples, frame_size);
     if(self->ring == NULL) return ALC_INVALID_VALUE;
+    STATIC_CAST(ALCbackend,self)->mCaptureRing = self->ring;
 
     self->params.device = -1;
     if(!ConfigValueInt(NULL, "port", "capture", &self->params.device) ||
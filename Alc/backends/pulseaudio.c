@@ -27,6 +27,7 @@
 #include "alu.h"
 #include "threads.h"
 #include "compat.h"
+#include "trace.h"
 
 #include "backends/base.h"
 
@@ -84,6 +85,7 @@ MAKE_FUNC(pa_stream_set_read_callback);
 MAKE_FUNC(pa_stream_set_state_callback);
 MAKE_FUNC(pa_stream_set_moved_callback);
 MAKE_FUNC(pa_stream_set_underflow_callback);
+MAKE_FUNC(pa_stream_set_overflow_callback);
 MAKE_FUNC(pa_stream_new_with_proplist);
 MAKE_FUNC(pa_stream_disconnect);
 MAKE_FUNC(pa_threaded_mainloop_lock);
@@ -153,6 +155,7 @@ MAKE_FUNC(pa_stream_begin_write);
 #define pa_stream_set_state_callback ppa_stream_set_state_callback
 #define pa_stream_set_moved_callback ppa_stream_set_moved_callback
 #define pa_stream_set_underflow_callback ppa_stream_set_underflow_callback
+#define pa_stream_set_overflow_callback ppa_stream_set_overflow_callback
 #define pa_stream_new_with_proplist ppa_stream_new_with_proplist
 #define pa_stream_disconnect ppa_stream_disconnect
 #define pa_threaded_mainloop_lock ppa_threaded_mainloop_lock
@@ -246,6 +249,7 @@ static ALCboolean pulse_load(void)
         LOAD_FUNC(pa_stream_set_state_callback);
         LOAD_FUNC(pa_stream_set_moved_callback);
         LOAD_FUNC(pa_stream_set_underflow_callback);
+        LOAD_FUNC(pa_stream_set_overflow_callback);
         LOAD_FUNC(pa_stream_new_with_proplist);
         LOAD_FUNC(pa_stream_disconnect);
         LOAD_FUNC(pa_threaded_mainloop_lock);
@@ -414,6 +418,8 @@ static void pulse_close(pa_threaded_mainloop *loop, pa_context *context, pa_stre
         pa_stream_set_state_callback(stream, NULL, NULL);
         pa_stream_set_moved_callback(stream, NULL, NULL);
         pa_stream_set_write_callback(stream, NULL, NULL);
+        pa_stream_set_underflow_callback(stream, NULL, NULL);
+        pa_stream_set_overflow_callback(stream, NULL, NULL);
         pa_stream_set_buffer_attr_callback(stream, NULL, NULL);
         pa_stream_disconnect(stream);
         pa_stream_unref(stream);
@@ -471,6 +477,7 @@ static void ALCpulsePlayback_bufferAttrCallback(pa_stream *stream, void *pdata);
 static void ALCpulsePlayback_contextStateCallback(pa_context *context, void *pdata);
 static void ALCpulsePlayback_streamStateCallback(pa_stream *stream, void *pdata);
 static void ALCpulsePlayback_streamWriteCallback(pa_stream *p, size_t nbytes, void *userdata);
+static void ALCpulsePlayback_streamUnderflowCallback(pa_stream *stream, void *pdata);
 static void ALCpulsePlayback_sinkInfoCallback(pa_context *context, const pa_sink_info *info, int eol, void *pdata);
 static void ALCpulsePlayback_sinkNameCallback(pa_context *context, const pa_sink_info *info, int eol, void *pdata);
 static void ALCpulsePlayback_streamMovedCallback(pa_stream *stream, void *pdata);
@@ -648,6 +655,12 @@ static void ALCpulsePlayback_streamWriteCallback(pa_stream* UNUSED(p), size_t UN
     pa_threaded_mainloop_signal(self->loop, 0);
 }
 
+static void ALCpulsePlayback_streamUnderflowCallback(pa_stream *UNUSED(stream), void *pdata)
+{
+    ALCpulsePlayback *self = pdata;
+    ALCbackend_countStat(STATIC_CAST(ALCbackend,self), BackendStat_Underrun);
+}
+
 static void ALCpulsePlayback_sinkInfoCallback(pa_context *UNUSED(context), const pa_sink_info *info, int eol, void *pdata)
 {
     static const struct {
@@ -815,10 +828,13 @@ static int ALCpulsePlayback_mixerProc(void *ptr)
                 o = pa_stream_cork(self->stream, 0, NULL, NULL);
                 if(o) pa_operation_unref(o);
             }
+            TRACE_BEGIN("BackendWait", 0);
             pa_threaded_mainloop_wait(self->loop);
+            TRACE_END("BackendWait");
             continue;
         }
         len -= len%update_size;
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend,self));
 
         while(len > 0)
         {
@@ -834,7 +850,9 @@ static int ALCpulsePlayback_mixerProc(void *ptr)
 
             aluMixData(device, buf, newlen/frame_size);
 
+            TRACE_BEGIN("BackendCommit", newlen/frame_size);
             pa_stream_write(self->stream, buf, newlen, free_func, 0, PA_SEEK_RELATIVE);
+            TRACE_END("BackendCommit");
             len -= newlen;
         }
     } while(!self->killNow && device->Connected);
@@ -940,6 +958,7 @@ static ALCboolean ALCpulsePlayback_reset(ALCpulsePlayback *self)
         pa_stream_set_state_callback(self->stream, NULL, NULL);
         pa_stream_set_moved_callback(self->stream, NULL, NULL);
         pa_stream_set_write_callback(self->stream, NULL, NULL);
+        pa_stream_set_underflow_callback(self->stream, NULL, NULL);
         pa_stream_set_buffer_attr_callback(self->stream, NULL, NULL);
         pa_stream_disconnect(self->stream);
         pa_stream_unref(self->stream);
@@ -1047,6 +1066,7 @@ static ALCboolean ALCpulsePlayback_reset(ALCpulsePlayback *self)
     pa_stream_set_state_callback(self->stream, ALCpulsePlayback_streamStateCallback, self);
     pa_stream_set_moved_callback(self->stream, ALCpulsePlayback_streamMovedCallback, self);
     pa_stream_set_write_callback(self->stream, ALCpulsePlayback_streamWriteCallback, self);
+    pa_stream_set_underflow_callback(self->stream, ALCpulsePlayback_streamUnderflowCallback, self);
 
     self->spec = *(pa_stream_get_sample_spec(self->stream));
     if(device->Frequency != self->spec.rate)
@@ -1203,6 +1223,7 @@ static void ALCpulseCapture_contextStateCallback(pa_context *context, void *pdat
 static void ALCpulseCapture_streamStateCallback(pa_stream *stream, void *pdata);
 static void ALCpulseCapture_sourceNameCallback(pa_context *context, const pa_source_info *info, int eol, void *pdata);
 static void ALCpulseCapture_streamMovedCallback(pa_stream *stream, void *pdata);
+static void ALCpulseCapture_streamOverflowCallback(pa_stream *stream, void *pdata);
 static pa_stream *ALCpulseCapture_connectStream(const char *device_name,
                                                 pa_threaded_mainloop *loop, pa_context *context,
                                                 pa_stream_flags_t flags, pa_buffer_attr *attr,
@@ -1387,6 +1408,12 @@ static void ALCpulseCapture_streamMovedCallback(pa_stream *stream, void *pdata)
     TRACE("Stream moved to %s\n", al_string_get_cstr(self->device_name));
 }
 
+static void ALCpulseCapture_streamOverflowCallback(pa_stream *UNUSED(stream), void *pdata)
+{
+    ALCpulseCapture *self = pdata;
+    ALCbackend_countStat(STATIC_CAST(ALCbackend,self), BackendStat_Overrun);
+}
+
 
 static pa_stream *ALCpulseCapture_connectStream(const char *device_name,
     pa_threaded_mainloop *loop, pa_context *context,
@@ -1522,6 +1549,7 @@ static ALCenum ALCpulseCapture_open(ALCpulseCapture *self, const ALCchar *name)
     }
     pa_stream_set_moved_callback(self->stream, ALCpulseCapture_streamMovedCallback, self);
     pa_stream_set_state_callback(self->stream, ALCpulseCapture_streamStateCallback, self);
+    pa_stream_set_overflow_callback(self->stream, ALCpulseCapture_streamOverflowCallback, self);
 
     al_string_copy_cstr(&self->device_name, pa_stream_get_device_name(self->stream));
     if(al_string_empty(device->DeviceName))
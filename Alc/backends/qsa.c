@@ -33,6 +33,8 @@
 #include "alu.h"
 #include "threads.h"
 
+#include "backends/base.h"
+
 
 typedef struct {
     snd_pcm_t* pcmHandle;
@@ -185,6 +187,7 @@ FORCE_ALIGN static int qsa_proc_playback(void* ptr)
         write_ptr=data->buffer;
 
         avail=len/frame_size;
+        ALCbackend_markWakeup(device->Backend);
         aluMixData(device, write_ptr, avail);
 
         while (len>0 && !data->killNow)
@@ -28,6 +28,8 @@
 #include "alu.h"
 #include "threads.h"
 
+#include "backends/base.h"
+
 #include <sndio.h>
 
 
@@ -68,6 +70,7 @@ static int sndio_proc(void *ptr)
         ALsizei len = data->data_size;
         ALubyte *WritePtr = data->mix_data;
 
+        ALCbackend_markWakeup(device->Backend);
         aluMixData(device, WritePtr, len/frameSize);
         while(len > 0 && !data->killNow)
         {
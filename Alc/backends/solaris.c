@@ -117,6 +117,7 @@ static int ALCsolarisBackend_mixerProc(void *ptr)
         ALint len = self->data_size;
         ALubyte *WritePtr = self->mix_data;
 
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
         aluMixData(Device, WritePtr, len/frameSize);
         while(len > 0 && !self->killNow)
         {
@@ -29,58 +29,42 @@
 #include "alu.h"
 #include "threads.h"
 #include "compat.h"
+#include "trace.h"
+#include "wavfile.h"
 
 #include "backends/base.h"
 
 
 static const ALCchar waveDevice[] = "Wave File Writer";
 
-static const ALubyte SUBTYPE_PCM[] = {
-    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa,
-    0x00, 0x38, 0x9b, 0x71
-};
-static const ALubyte SUBTYPE_FLOAT[] = {
-    0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa,
-    0x00, 0x38, 0x9b, 0x71
-};
-
-static const ALubyte SUBTYPE_BFORMAT_PCM[] = {
-    0x01, 0x00, 0x00, 0x00, 0x21, 0x07, 0xd3, 0x11, 0x86, 0x44, 0xc8, 0xc1,
-    0xca, 0x00, 0x00, 0x00
-};
-
-static const ALubyte SUBTYPE_BFORMAT_FLOAT[] = {
-    0x03, 0x00, 0x00, 0x00, 0x21, 0x07, 0xd3, 0x11, 0x86, 0x44, 0xc8, 0xc1,
-    0xca, 0x00, 0x00, 0x00
-};
-
-static void fwrite16le(ALushort val, FILE *f)
-{
-    ALubyte data[2] = { val&0xff, (val>>8)&0xff };
-    fwrite(data, 1, 2, f);
-}
-
-static void fwrite32le(ALuint val, FILE *f)
-{
-    ALubyte data[4] = { val&0xff, (val>>8)&0xff, (val>>16)&0xff, (val>>24)&0xff };
-    fwrite(data, 1, 4, f);
-}
-
-
 typedef struct ALCwaveBackend {
     DERIVE_FROM_TYPE(ALCbackend);
 
     FILE *mFile;
-    long mDataStart;
-
-    ALvoid *mBuffer;
+    long long mDataStart;
+    enum WaveFileType mFileType;
+
+    /* Mix as fast as possible instead of in real time. */
+    ALboolean mFreeRun;
+
+    /* The mixer fills these two buffers in turn, handing each full one to the
+     * writer thread so the mixer never waits on the file. A buffer handed off
+     * with a length of 0 tells the writer to stop.
+     */
+    ALvoid *mBuffer[2];
+    ALuint mBufferLen[2];
     ALuint mSize;
+    alsem_t mFreeSem;
+    alsem_t mFullSem;
+    volatile int mWriteError;
 
     volatile int killNow;
     althrd_t thread;
+    althrd_t mWriterThread;
 } ALCwaveBackend;
 
 static int ALCwaveBackend_mixerProc(void *ptr);
+static int ALCwaveBackend_writerProc(void *ptr);
 
 static void ALCwaveBackend_Construct(ALCwaveBackend *self, ALCdevice *device);
 static DECLARE_FORWARD(ALCwaveBackend, ALCbackend, void, Destruct)
@@ -106,9 +90,13 @@ static void ALCwaveBackend_Construct(ALCwaveBackend *self, ALCdevice *device)
 
     self->mFile = NULL;
     self->mDataStart = -1;
+    self->mFileType = WaveFile_RIFF;
+    self->mFreeRun = AL_FALSE;
 
-    self->mBuffer = NULL;
+    self->mBuffer[0] = self->mBuffer[1] = NULL;
+    self->mBufferLen[0] = self->mBufferLen[1] = 0;
     self->mSize = 0;
+    self->mWriteError = 0;
 
     self->killNow = 1;
 }
@@ -121,7 +109,7 @@ static int ALCwaveBackend_mixerProc(void *ptr)
     struct timespec now, start;
     ALint64 avail, done;
     ALuint frameSize;
-    size_t fs;
+    ALuint len, idx;
     const long restTime = (long)((ALuint64)device->UpdateSize * 1000000000 /
                                  device->Frequency / 2);
 
@@ -129,76 +117,145 @@ static int ALCwaveBackend_mixerProc(void *ptr)
 
     frameSize = FrameSizeFromDevFmt(device->FmtChans, device->FmtType);
 
+    idx = 0;
+    len = 0;
+    alsem_wait(&self->mFreeSem);
+
     done = 0;
     if(altimespec_get(&start, AL_TIME_UTC) != AL_TIME_UTC)
     {
         ERR("Failed to get starting time\n");
-        return 1;
+        goto finish;
     }
     while(!self->killNow && device->Connected)
     {
-        if(altimespec_get(&now, AL_TIME_UTC) != AL_TIME_UTC)
+        if(self->mWriteError)
         {
-            ERR("Failed to get current time\n");
-            return 1;
+            ERR("Error writing to file\n");
+            ALCdevice_Lock(device);
+            aluHandleDisconnect(device);
+            ALCdevice_Unlock(device);
+            break;
         }
 
-        avail  = (now.tv_sec - start.tv_sec) * device->Frequency;
-        avail += (ALint64)(now.tv_nsec - start.tv_nsec) * device->Frequency / 1000000000;
-        if(avail < done)
+        if(self->mFreeRun)
+            avail = done + device->UpdateSize;
+        else
         {
-            /* Oops, time skipped backwards. Reset the number of samples done
-             * with one update available since we (likely) just came back from
-             * sleeping. */
-            done = avail - device->UpdateSize;
+            if(altimespec_get(&now, AL_TIME_UTC) != AL_TIME_UTC)
+            {
+                ERR("Failed to get current time\n");
+                break;
+            }
+
+            avail  = (now.tv_sec - start.tv_sec) * device->Frequency;
+            avail += (ALint64)(now.tv_nsec - start.tv_nsec) * device->Frequency / 1000000000;
+            if(avail < done)
+            {
+                /* Oops, time skipped backwards. Reset the number of samples
+                 * done with one update available since we (likely) just came
+                 * back from sleeping. */
+                done = avail - device->UpdateSize;
+            }
+
+            if(avail-done >= device->UpdateSize)
+                ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
         }
 
         if(avail-done < device->UpdateSize)
+        {
+            TRACE_BEGIN("BackendWait", 0);
             al_nssleep(restTime);
+            TRACE_END("BackendWait");
+        }
         else while(avail-done >= device->UpdateSize)
         {
-            aluMixData(device, self->mBuffer, device->UpdateSize);
+            aluMixData(device, (ALubyte*)self->mBuffer[idx] + len, device->UpdateSize);
+            len += device->UpdateSize * frameSize;
             done += device->UpdateSize;
 
-            if(!IS_LITTLE_ENDIAN)
+            if(len == self->mSize)
             {
-                ALuint bytesize = BytesFromDevFmt(device->FmtType);
-                ALuint i;
+                TRACE_BEGIN("BackendCommit", len/frameSize);
+                self->mBufferLen[idx] = len;
+                alsem_post(&self->mFullSem);
+                idx ^= 1;
+                len = 0;
+                alsem_wait(&self->mFreeSem);
+                TRACE_END("BackendCommit");
+            }
+        }
+    }
+
+finish:
+    /* Hand off what's left, then tell the writer to stop. */
+    if(len > 0)
+    {
+        self->mBufferLen[idx] = len;
+        alsem_post(&self->mFullSem);
+        idx ^= 1;
+        alsem_wait(&self->mFreeSem);
+    }
+    self->mBufferLen[idx] = 0;
+    alsem_post(&self->mFullSem);
+
+    return 0;
+}
+
+static int ALCwaveBackend_writerProc(void *ptr)
+{
+    ALCwaveBackend *self = (ALCwaveBackend*)ptr;
+    ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
+    ALuint bytesize, len, idx;
 
-                if(bytesize == 2)
+    althrd_setname(althrd_current(), "alsoft-wave-writer");
+
+    bytesize = BytesFromDevFmt(device->FmtType);
+    idx = 0;
+    while(1)
+    {
+        alsem_wait(&self->mFullSem);
+        if((len=self->mBufferLen[idx]) == 0)
+            break;
+
+        if(!IS_LITTLE_ENDIAN)
+        {
+            ALuint i;
+
+            if(bytesize == 2)
+            {
+                ALushort *samples = self->mBuffer[idx];
+                for(i = 0;i < len/2;i++)
                 {
-                    ALushort *samples = self->mBuffer;
-                    ALuint len = self->mSize / 2;
-                    for(i = 0;i < len;i++)
-                    {
-                        ALushort samp = samples[i];
-                        samples[i] = (samp>>8) | (samp<<8);
-                    }
+                    ALushort samp = samples[i];
+                    samples[i] = (samp>>8) | (samp<<8);
                 }
-                else if(bytesize == 4)
+            }
+            else if(bytesize == 4)
+            {
+                ALuint *samples = self->mBuffer[idx];
+                for(i = 0;i < len/4;i++)
                 {
-                    ALuint *samples = self->mBuffer;
-                    ALuint len = self->mSize / 4;
-                    for(i = 0;i < len;i++)
-                    {
-                        ALuint samp = samples[i];
-                        samples[i] = (samp>>24) | ((samp>>8)&0x0000ff00) |
-                                     ((samp<<8)&0x00ff0000) | (samp<<24);
-                    }
+                    ALuint samp = samples[i];
+                    samples[i] = (samp>>24) | ((samp>>8)&0x0000ff00) |
+                                 ((samp<<8)&0x00ff0000) | (samp<<24);
                 }
             }
+        }
 
-            fs = fwrite(self->mBuffer, frameSize, device->UpdateSize, self->mFile);
-            (void)fs;
+        /* Keep taking buffers after an error, so the mixer doesn't stall
+         * before it sees the error. */
+        if(!self->mWriteError)
+        {
+            TRACE_BEGIN("WaveWrite", len);
+            fwrite(self->mBuffer[idx], 1, len, self->mFile);
+            TRACE_END("WaveWrite");
             if(ferror(self->mFile))
-            {
-                ERR("Error writing to file\n");
-                ALCdevice_Lock(device);
-                aluHandleDisconnect(device);
-                ALCdevice_Unlock(device);
-                break;
-            }
+                self->mWriteError = 1;
         }
+
+        alsem_post(&self->mFreeSem);
+        idx ^= 1;
     }
 
     return 0;
@@ -241,13 +298,26 @@ static void ALCwaveBackend_close(ALCwaveBackend *self)
 static ALCboolean ALCwaveBackend_reset(ALCwaveBackend *self)
 {
     ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
-    ALuint channels=0, bits=0, chanmask=0;
+    ALuint chanmask = 0;
     int isbformat = 0;
-    size_t val;
+    const char *str;
+    WaveFormat fmt;
 
     fseek(self->mFile, 0, SEEK_SET);
     clearerr(self->mFile);
 
+    self->mFileType = WaveFile_RIFF;
+    if(ConfigValueStr(NULL, "wave", "file-type", &str))
+    {
+        if(strcasecmp(str, "w64") == 0)
+            self->mFileType = WaveFile_W64;
+        else if(strcasecmp(str, "rf64") == 0)
+            self->mFileType = WaveFile_RF64;
+        else if(strcasecmp(str, "wav") != 0)
+            ERR("Unsupported file type: %s\n", str);
+    }
+    self->mFreeRun = GetConfigValueBool(NULL, "wave", "freerun", 0);
+
     if(GetConfigValueBool(NULL, "wave", "bformat", 0))
         device->FmtChans = DevFmtAmbi1;
 
@@ -286,83 +356,86 @@ static ALCboolean ALCwaveBackend_reset(ALCwaveBackend *self)
             chanmask = 0;
             break;
     }
-    bits = BytesFromDevFmt(device->FmtType) * 8;
-    channels = ChannelsFromDevFmt(device->FmtChans);
-
-    fprintf(self->mFile, "RIFF");
-    fwrite32le(0xFFFFFFFF, self->mFile); // 'RIFF' header len; filled in at close
-
-    fprintf(self->mFile, "WAVE");
-
-    fprintf(self->mFile, "fmt ");
-    fwrite32le(40, self->mFile); // 'fmt ' header len; 40 bytes for EXTENSIBLE
-
-    // 16-bit val, format type id (extensible: 0xFFFE)
-    fwrite16le(0xFFFE, self->mFile);
-    // 16-bit val, channel count
-    fwrite16le(channels, self->mFile);
-    // 32-bit val, frequency
-    fwrite32le(device->Frequency, self->mFile);
-    // 32-bit val, bytes per second
-    fwrite32le(device->Frequency * channels * bits / 8, self->mFile);
-    // 16-bit val, frame size
-    fwrite16le(channels * bits / 8, self->mFile);
-    // 16-bit val, bits per sample
-    fwrite16le(bits, self->mFile);
-    // 16-bit val, extra byte count
-    fwrite16le(22, self->mFile);
-    // 16-bit val, valid bits per sample
-    fwrite16le(bits, self->mFile);
-    // 32-bit val, channel mask
-    fwrite32le(chanmask, self->mFile);
-    // 16 byte GUID, sub-type format
-    val = fwrite(((bits==32) ? (isbformat ? SUBTYPE_BFORMAT_FLOAT : SUBTYPE_FLOAT) :
-                               (isbformat ? SUBTYPE_BFORMAT_PCM : SUBTYPE_PCM)), 1, 16, self->mFile);
-    (void)val;
-
-    fprintf(self->mFile, "data");
-    fwrite32le(0xFFFFFFFF, self->mFile); // 'data' header len; filled in at close
-
-    if(ferror(self->mFile))
+    fmt.Bits = BytesFromDevFmt(device->FmtType) * 8;
+    fmt.Channels = ChannelsFromDevFmt(device->FmtChans);
+    fmt.IsFloat = (device->FmtType == DevFmtFloat);
+    fmt.IsBFormat = isbformat;
+    fmt.ChannelMask = chanmask;
+    fmt.SampleRate = device->Frequency;
+
+    self->mDataStart = WriteWaveHeader(self->mFile, self->mFileType, &fmt);
+    if(self->mDataStart < 0)
     {
         ERR("Error writing header: %s\n", strerror(errno));
         return ALC_FALSE;
     }
-    self->mDataStart = ftell(self->mFile);
 
     SetDefaultWFXChannelOrder(device);
 
+    TRACE("Writing %s file%s\n", (self->mFileType == WaveFile_W64) ? "W64" :
+          (self->mFileType == WaveFile_RF64) ? "RF64" : "WAV",
+          self->mFreeRun ? ", free-running" : "");
+
     return ALC_TRUE;
 }
 
 static ALCboolean ALCwaveBackend_start(ALCwaveBackend *self)
 {
     ALCdevice *device = STATIC_CAST(ALCbackend, self)->mDevice;
+    ALuint updates;
+    int res;
 
-    self->mSize = device->UpdateSize * FrameSizeFromDevFmt(device->FmtChans, device->FmtType);
-    self->mBuffer = malloc(self->mSize);
-    if(!self->mBuffer)
+    /* Hand off about half a second of audio at a time, so the file is written
+     * in large blocks. */
+    updates = maxu((device->Frequency/2 + device->UpdateSize-1) / device->UpdateSize, 1);
+    self->mSize = updates * device->UpdateSize *
+                  FrameSizeFromDevFmt(device->FmtChans, device->FmtType);
+    self->mBuffer[0] = malloc(self->mSize);
+    self->mBuffer[1] = malloc(self->mSize);
+    if(!self->mBuffer[0] || !self->mBuffer[1])
     {
         ERR("Buffer malloc failed\n");
-        return ALC_FALSE;
+        goto error;
+    }
+
+    if(alsem_init(&self->mFreeSem, 2) != althrd_success)
+        goto error;
+    if(alsem_init(&self->mFullSem, 0) != althrd_success)
+    {
+        alsem_destroy(&self->mFreeSem);
+        goto error;
     }
 
+    self->mWriteError = 0;
+    if(althrd_create(&self->mWriterThread, ALCwaveBackend_writerProc, self) != althrd_success)
+        goto error_sems;
+
     self->killNow = 0;
     if(althrd_create(&self->thread, ALCwaveBackend_mixerProc, self) != althrd_success)
     {
-        free(self->mBuffer);
-        self->mBuffer = NULL;
-        self->mSize = 0;
-        return ALC_FALSE;
+        self->killNow = 1;
+        /* Tell the writer to stop. */
+        self->mBufferLen[0] = 0;
+        alsem_post(&self->mFullSem);
+        althrd_join(self->mWriterThread, &res);
+        goto error_sems;
     }
 
     return ALC_TRUE;
+
+error_sems:
+    alsem_destroy(&self->mFullSem);
+    alsem_destroy(&self->mFreeSem);
+error:
+    free(self->mBuffer[0]);
+    free(self->mBuffer[1]);
+    self->mBuffer[0] = self->mBuffer[1] = NULL;
+    self->mSize = 0;
+    return ALC_FALSE;
 }
 
 static void ALCwaveBackend_stop(ALCwaveBackend *self)
 {
-    ALuint dataLen;
-    long size;
     int res;
 
     if(self->killNow)
@@ -370,19 +443,16 @@ static void ALCwaveBackend_stop(ALCwaveBackend *self)
 
     self->killNow = 1;
     althrd_join(self->thread, &res);
+    althrd_join(self->mWriterThread, &res);
 
-    free(self->mBuffer);
-    self->mBuffer = NULL;
+    alsem_destroy(&self->mFullSem);
+    alsem_destroy(&self->mFreeSem);
 
-    size = ftell(self->mFile);
-    if(size > 0)
-    {
-        dataLen = size - self->mDataStart;
-        if(fseek(self->mFile, self->mDataStart-4, SEEK_SET) == 0)
-            fwrite32le(dataLen, self->mFile); // 'data' header len
-        if(fseek(self->mFile, 4, SEEK_SET) == 0)
-            fwrite32le(size-8, self->mFile); // 'WAVE' header len
-    }
+    free(self->mBuffer[0]);
+    free(self->mBuffer[1]);
+    self->mBuffer[0] = self->mBuffer[1] = NULL;
+
+    FinishWaveFile(self->mFile, self->mFileType, self->mDataStart);
 }
 
 
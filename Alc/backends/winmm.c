@@ -232,6 +232,7 @@ FORCE_ALIGN static int ALCwinmmPlayback_mixerProc(void *arg)
         }
 
         WaveHdr = ((WAVEHDR*)msg.lParam);
+        ALCbackend_markWakeup(STATIC_CAST(ALCbackend, self));
         aluMixData(device, WaveHdr->lpData, WaveHdr->dwBufferLength /
                                             self->Format.nBlockAlign);
 
@@ -608,6 +609,7 @@ static ALCenum ALCwinmmCapture_open(ALCwinmmCapture *self, const ALCchar *name)
 
     self->Ring = ll_ringbuffer_create(CapturedDataSize+1, self->Format.nBlockAlign);
     if(!self->Ring) goto failure;
+    STATIC_CAST(ALCbackend,self)->mCaptureRing = self->Ring;
 
     InitRef(&self->WaveBuffersCommitted, 0);
 
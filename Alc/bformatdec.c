@@ -243,7 +243,7 @@ typedef struct BFormatDec {
 BFormatDec *bformatdec_alloc()
 {
     alcall_once(&bformatdec_inited, init_bformatdec);
-    return al_calloc(16, sizeof(BFormatDec));
+    return al_calloc_tag(AllocTag_Device, 16, sizeof(BFormatDec));
 }
 
 void bformatdec_free(BFormatDec *dec)
@@ -293,7 +293,7 @@ void bformatdec_reset(BFormatDec *dec, const AmbDecConf *conf, ALuint chancount,
     dec->SamplesLF = NULL;
 
     dec->NumChannels = chancount;
-    dec->Samples = al_calloc(16, dec->NumChannels*2 * sizeof(dec->Samples[0]));
+    dec->Samples = al_calloc_tag(AllocTag_Device, 16, dec->NumChannels*2 * sizeof(dec->Samples[0]));
     dec->SamplesHF = dec->Samples;
     dec->SamplesLF = dec->SamplesHF + dec->NumChannels;
 
@@ -624,7 +624,7 @@ typedef struct AmbiUpsampler {
 AmbiUpsampler *ambiup_alloc()
 {
     alcall_once(&bformatdec_inited, init_bformatdec);
-    return al_calloc(16, sizeof(AmbiUpsampler));
+    return al_calloc_tag(AllocTag_Device, 16, sizeof(AmbiUpsampler));
 }
 
 void ambiup_free(struct AmbiUpsampler *ambiup)
@@ -0,0 +1,407 @@
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "converter.h"
+
+#include "mixer_defs.h"
+
+
+SampleConverter *CreateSampleConverter(enum DevFmtType srcType, enum DevFmtType dstType, ALsizei numchans, ALsizei srcRate, ALsizei dstRate)
+{
+    SampleConverter *converter;
+    ALsizei step;
+
+    if(numchans <= 0 || srcRate <= 0 || dstRate <= 0)
+        return NULL;
+
+    converter = al_calloc_tag(AllocTag_Device, 16,
+        sizeof(*converter) + numchans*sizeof(converter->Chan[0])
+    );
+    if(!converter) return NULL;
+
+    converter->SrcType = srcType;
+    converter->DstType = dstType;
+    converter->NumChannels = numchans;
+    converter->SrcTypeSize = BytesFromDevFmt(srcType);
+    converter->DstTypeSize = BytesFromDevFmt(dstType);
+
+    /* Start with silence before the first sample, like a newly played voice. */
+    converter->SrcPrepCount = MAX_PRE_SAMPLES;
+    converter->FracOffset = 0;
+
+    step = fastf2i((ALfloat)mind((ALdouble)srcRate / dstRate, MAX_PITCH)*FRACTIONONE + 0.5f);
+    converter->Increment = maxi(step, 1);
+    if(converter->Increment == FRACTIONONE)
+        converter->Resample = Resample_copy32_C;
+    else
+    {
+        BsincPrepare(converter->Increment, &converter->SincState);
+        converter->Resample = SelectConfiguredResampler();
+    }
+
+    return converter;
+}
+
+void DestroySampleConverter(SampleConverter **converter)
+{
+    if(converter)
+    {
+        al_free(*converter);
+        *converter = NULL;
+    }
+}
+
+
+static inline ALfloat Sample_ALbyte(ALbyte val)
+{ return val * (1.0f/128.0f); }
+static inline ALfloat Sample_ALubyte(ALubyte val)
+{ return Sample_ALbyte((ALint)val - 128); }
+
+static inline ALfloat Sample_ALshort(ALshort val)
+{ return val * (1.0f/32768.0f); }
+static inline ALfloat Sample_ALushort(ALushort val)
+{ return Sample_ALshort((ALint)val - 32768); }
+
+static inline ALfloat Sample_ALint(ALint val)
+{ return (val>>7) * (1.0f/16777216.0f); }
+static inline ALfloat Sample_ALuint(ALuint val)
+{ return Sample_ALint((ALint)(val - 2147483648u)); }
+
+static inline ALfloat Sample_ALfloat(ALfloat val)
+{ return val; }
+
+#define DECL_TEMPLATE(T)                                                      \
+static inline void Load_##T(ALfloat *restrict dst, const T *restrict src,     \
+                            ALsizei srcstep, ALsizei samples)                 \
+{                                                                             \
+    ALsizei i;                                                                \
+    for(i = 0;i < samples;i++)                                                \
+        dst[i] = Sample_##T(src[i*srcstep]);                                  \
+}
+
+DECL_TEMPLATE(ALbyte)
+DECL_TEMPLATE(ALubyte)
+DECL_TEMPLATE(ALshort)
+DECL_TEMPLATE(ALushort)
+DECL_TEMPLATE(ALint)
+DECL_TEMPLATE(ALuint)
+DECL_TEMPLATE(ALfloat)
+
+#undef DECL_TEMPLATE
+
+static void LoadSamples(ALfloat *dst, const ALvoid *src, ALsizei srcstep, enum DevFmtType srctype, ALsizei samples)
+{
+    switch(srctype)
+    {
+        case DevFmtByte:
+            Load_ALbyte(dst, src, srcstep, samples);
+            break;
+        case DevFmtUByte:
+            Load_ALubyte(dst, src, srcstep, samples);
+            break;
+        case DevFmtShort:
+            Load_ALshort(dst, src, srcstep, samples);
+            break;
+        case DevFmtUShort:
+            Load_ALushort(dst, src, srcstep, samples);
+            break;
+        case DevFmtInt:
+            Load_ALint(dst, src, srcstep, samples);
+            break;
+        case DevFmtUInt:
+            Load_ALuint(dst, src, srcstep, samples);
+            break;
+        case DevFmtFloat:
+            Load_ALfloat(dst, src, srcstep, samples);
+            break;
+    }
+}
+
+
+/* Same as the mixer's output conversion; clamps to [-1, +1], with NaN as 0. */
+static inline ALfloat ClampSample(ALfloat val)
+{
+    if(fabsf(val) <= 1.0f) return val;
+    return (ALfloat)((0.0f < val) - (val < 0.0f));
+}
+
+static inline ALbyte ALbyte_Sample(ALfloat val)
+{ return fastf2i(ClampSample(val)*127.0f); }
+static inline ALubyte ALubyte_Sample(ALfloat val)
+{ return ALbyte_Sample(val)+128; }
+
+static inline ALshort ALshort_Sample(ALfloat val)
+{ return fastf2i(ClampSample(val)*32767.0f); }
+static inline ALushort ALushort_Sample(ALfloat val)
+{ return ALshort_Sample(val)+32768; }
+
+static inline ALint ALint_Sample(ALfloat val)
+{ return fastf2i(ClampSample(val)*16777215.0f)<<7; }
+static inline ALuint ALuint_Sample(ALfloat val)
+{ return ALint_Sample(val)+2147483648u; }
+
+static inline ALfloat ALfloat_Sample(ALfloat val)
+{ return val; }
+
+#define DECL_TEMPLATE(T)                                                      \
+static inline void Store_##T(T *restrict dst, const ALfloat *restrict src,    \
+                             ALsizei dststep, ALsizei samples)                \
+{                                                                             \
+    ALsizei i;                                                                \
+    for(i = 0;i < samples;i++)                                                \
+        dst[i*dststep] = T##_Sample(src[i]);                                  \
+}
+
+DECL_TEMPLATE(ALbyte)
+DECL_TEMPLATE(ALubyte)
+DECL_TEMPLATE(ALshort)
+DECL_TEMPLATE(ALushort)
+DECL_TEMPLATE(ALint)
+DECL_TEMPLATE(ALuint)
+DECL_TEMPLATE(ALfloat)
+
+#undef DECL_TEMPLATE
+
+static void StoreSamples(ALvoid *dst, const ALfloat *src, ALsizei dststep, enum DevFmtType dsttype, ALsizei samples)
+{
+    switch(dsttype)
+    {
+        case DevFmtByte:
+            Store_ALbyte(dst, src, dststep, samples);
+            break;
+        case DevFmtUByte:
+            Store_ALubyte(dst, src, dststep, samples);
+            break;
+        case DevFmtShort:
+            Store_ALshort(dst, src, dststep, samples);
+            break;
+        case DevFmtUShort:
+            Store_ALushort(dst, src, dststep, samples);
+            break;
+        case DevFmtInt:
+            Store_ALint(dst, src, dststep, samples);
+            break;
+        case DevFmtUInt:
+            Store_ALuint(dst, src, dststep, samples);
+            break;
+        case DevFmtFloat:
+            Store_ALfloat(dst, src, dststep, samples);
+            break;
+    }
+}
+
+
+ALsizei SampleConverterInput(SampleConverter *converter, const ALvoid **src, ALsizei *srcframes, ALvoid *dst, ALsizei dstframes)
+{
+    const ALsizei SrcFrameSize = converter->NumChannels * converter->SrcTypeSize;
+    const ALsizei DstFrameSize = converter->NumChannels * converter->DstTypeSize;
+    const ALsizei increment = converter->Increment;
+    const ALsizei NumChannels = converter->NumChannels;
+    ALsizei pos = 0;
+
+    while(pos < dstframes && *srcframes > 0)
+    {
+        ALfloat *restrict SrcData = converter->SrcSamples;
+        ALfloat *restrict DstData = converter->DstSamples;
+        ALint prepcount = converter->SrcPrepCount;
+        ALsizei DataPosFrac = converter->FracOffset;
+        ALsizei total, advance, keep;
+        ALuint64 DataSize64;
+        ALsizei DstSize;
+        ALsizei toread;
+        ALsizei chan;
+
+        if(prepcount < 0)
+        {
+            /* Skip input samples the last update stepped past. */
+            if(-prepcount >= *srcframes)
+            {
+                converter->SrcPrepCount = prepcount + *srcframes;
+                *srcframes = 0;
+                break;
+            }
+            *src = (const ALbyte*)*src + SrcFrameSize*-prepcount;
+            *srcframes += prepcount;
+            converter->SrcPrepCount = 0;
+            continue;
+        }
+        toread = mini(*srcframes, BUFFERSIZE - prepcount);
+        total = prepcount + toread;
+
+        if(total <= MAX_PRE_SAMPLES+MAX_POST_SAMPLES)
+        {
+            /* Not enough input samples to generate an output sample. Store
+             * what we're given for later.
+             */
+            for(chan = 0;chan < NumChannels;chan++)
+                LoadSamples(&converter->Chan[chan].PrevSamples[prepcount],
+                    (const ALbyte*)*src + converter->SrcTypeSize*chan,
+                    NumChannels, converter->SrcType, toread
+                );
+
+            converter->SrcPrepCount = total;
+            *src = (const ALbyte*)*src + SrcFrameSize*toread;
+            *srcframes -= toread;
+            break;
+        }
+
+        DataSize64  = total - (MAX_PRE_SAMPLES+MAX_POST_SAMPLES);
+        DataSize64 <<= FRACTIONBITS;
+        DataSize64 -= DataPosFrac;
+
+        /* If we have a full prep, we can generate at least one sample. */
+        DstSize = (ALsizei)clampu64((DataSize64 + increment-1)/increment, 1, BUFFERSIZE);
+        DstSize = mini(DstSize, dstframes-pos);
+
+        /* The samples stepped past, and how many after that are kept to prep
+         * the next update.
+         */
+        advance = (DataPosFrac + increment*DstSize) >> FRACTIONBITS;
+        keep = clampi(total - advance, 0, MAX_PRE_SAMPLES+MAX_POST_SAMPLES);
+
+        for(chan = 0;chan < NumChannels;chan++)
+        {
+            const ALbyte *SrcSamples = (const ALbyte*)*src + converter->SrcTypeSize*chan;
+            ALbyte *DstSamples = (ALbyte*)dst + converter->DstTypeSize*chan;
+            ALfloat *PrevSamples = converter->Chan[chan].PrevSamples;
+            const ALfloat *ResampledData;
+
+            /* Load the previous samples into the source data first, then the
+             * new samples from the input buffer.
+             */
+            memcpy(SrcData, PrevSamples, prepcount*sizeof(ALfloat));
+            LoadSamples(SrcData + prepcount, SrcSamples, NumChannels, converter->SrcType,
+                        toread);
+
+            if(keep > 0)
+                memcpy(PrevSamples, &SrcData[advance], keep*sizeof(ALfloat));
+
+            /* Now resample, and store the result in the output buffer. */
+            ResampledData = converter->Resample(&converter->SincState,
+                SrcData+MAX_PRE_SAMPLES, DataPosFrac, increment, DstData, DstSize
+            );
+
+            StoreSamples(DstSamples, ResampledData, NumChannels, converter->DstType, DstSize);
+        }
+
+        /* Only the input up to the end of the kept samples is used. If the
+         * update stepped past all the input, the rest needs to be skipped.
+         */
+        if(advance >= total)
+        {
+            converter->SrcPrepCount = total - advance;
+            *src = (const ALbyte*)*src + SrcFrameSize*toread;
+            *srcframes -= toread;
+        }
+        else
+        {
+            converter->SrcPrepCount = keep;
+            *src = (const ALbyte*)*src + SrcFrameSize*(advance+keep-prepcount);
+            *srcframes -= advance+keep-prepcount;
+        }
+        converter->FracOffset = (DataPosFrac + increment*DstSize) & FRACTIONMASK;
+
+        dst = (ALbyte*)dst + DstFrameSize*DstSize;
+        pos += DstSize;
+    }
+
+    return pos;
+}
+
+
+ChannelConverter *CreateChannelConverter(enum DevFmtType srcType, enum DevFmtChannels srcChans, enum DevFmtChannels dstChans)
+{
+    ChannelConverter *converter;
+
+    if(srcChans != dstChans && !((srcChans == DevFmtMono && dstChans == DevFmtStereo) ||
+                                 (srcChans == DevFmtStereo && dstChans == DevFmtMono)))
+        return NULL;
+
+    converter = al_calloc_tag(AllocTag_Device, 16, sizeof(*converter));
+    if(!converter) return NULL;
+
+    converter->SrcType = srcType;
+    converter->SrcChans = srcChans;
+    converter->DstChans = dstChans;
+
+    return converter;
+}
+
+void DestroyChannelConverter(ChannelConverter **converter)
+{
+    if(converter)
+    {
+        al_free(*converter);
+        *converter = NULL;
+    }
+}
+
+
+#define DECL_TEMPLATE(T)                                                       \
+static void Mono2Stereo##T(ALfloat *restrict dst, const T *src, ALsizei frames)\
+{                                                                              \
+    ALsizei i;                                                                 \
+    for(i = 0;i < frames;i++)                                                  \
+        dst[i*2 + 1] = dst[i*2 + 0] = Sample_##T(src[i]);                      \
+}                                                                              \
+                                                                               \
+static void Stereo2Mono##T(ALfloat *restrict dst, const T *src, ALsizei frames)\
+{                                                                              \
+    ALsizei i;                                                                 \
+    for(i = 0;i < frames;i++)                                                  \
+        dst[i] = (Sample_##T(src[i*2 + 0])+Sample_##T(src[i*2 + 1])) * 0.5f;   \
+}
+
+DECL_TEMPLATE(ALbyte)
+DECL_TEMPLATE(ALubyte)
+DECL_TEMPLATE(ALshort)
+DECL_TEMPLATE(ALushort)
+DECL_TEMPLATE(ALint)
+DECL_TEMPLATE(ALuint)
+DECL_TEMPLATE(ALfloat)
+
+#undef DECL_TEMPLATE
+
+void ChannelConverterInput(ChannelConverter *converter, const ALvoid *src, ALfloat *dst, ALsizei frames)
+{
+    if(converter->SrcChans == converter->DstChans)
+    {
+        LoadSamples(dst, src, 1, converter->SrcType,
+                    frames*ChannelsFromDevFmt(converter->SrcChans));
+        return;
+    }
+
+    if(converter->SrcChans == DevFmtStereo && converter->DstChans == DevFmtMono)
+    {
+        switch(converter->SrcType)
+        {
+#define HANDLE_FMT(T, t) case T: Stereo2Mono##t(dst, src, frames); break
+            HANDLE_FMT(DevFmtByte, ALbyte);
+            HANDLE_FMT(DevFmtUByte, ALubyte);
+            HANDLE_FMT(DevFmtShort, ALshort);
+            HANDLE_FMT(DevFmtUShort, ALushort);
+            HANDLE_FMT(DevFmtInt, ALint);
+            HANDLE_FMT(DevFmtUInt, ALuint);
+            HANDLE_FMT(DevFmtFloat, ALfloat);
+#undef HANDLE_FMT
+        }
+    }
+    else /*if(converter->SrcChans == DevFmtMono && converter->DstChans == DevFmtStereo)*/
+    {
+        switch(converter->SrcType)
+        {
+#define HANDLE_FMT(T, t) case T: Mono2Stereo##t(dst, src, frames); break
+            HANDLE_FMT(DevFmtByte, ALbyte);
+            HANDLE_FMT(DevFmtUByte, ALubyte);
+            HANDLE_FMT(DevFmtShort, ALshort);
+            HANDLE_FMT(DevFmtUShort, ALushort);
+            HANDLE_FMT(DevFmtInt, ALint);
+            HANDLE_FMT(DevFmtUInt, ALuint);
+            HANDLE_FMT(DevFmtFloat, ALfloat);
+#undef HANDLE_FMT
+        }
+    }
+}
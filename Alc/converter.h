@@ -0,0 +1,68 @@
+#ifndef CONVERTER_H
+#define CONVERTER_H
+
+#include "alMain.h"
+#include "alu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Converts interleaved samples between sample types and rates, keeping the
+ * channel count. Resampling uses the resampler configured for mixing.
+ */
+typedef struct SampleConverter {
+    enum DevFmtType SrcType;
+    enum DevFmtType DstType;
+    ALsizei NumChannels;
+    ALsizei SrcTypeSize;
+    ALsizei DstTypeSize;
+
+    /* The number of input samples kept in each channel's PrevSamples. When
+     * negative, that many input samples need to be skipped instead.
+     */
+    ALint SrcPrepCount;
+
+    ALsizei FracOffset;
+    ALsizei Increment;
+    BsincState SincState;
+    ResamplerFunc Resample;
+
+    alignas(16) ALfloat SrcSamples[BUFFERSIZE];
+    alignas(16) ALfloat DstSamples[BUFFERSIZE];
+
+    struct {
+        alignas(16) ALfloat PrevSamples[MAX_PRE_SAMPLES+MAX_POST_SAMPLES];
+    } Chan[];
+} SampleConverter;
+
+SampleConverter *CreateSampleConverter(enum DevFmtType srcType, enum DevFmtType dstType, ALsizei numchans, ALsizei srcRate, ALsizei dstRate);
+void DestroySampleConverter(SampleConverter **converter);
+
+/* Converts as many of the srcframes samples at src as fit in the dstframes
+ * of dst, returning the number of frames written. The src pointer and
+ * srcframes count are updated for what was used. Input that can't produce
+ * output yet is held on to, so src is always used up while dst has room.
+ */
+ALsizei SampleConverterInput(SampleConverter *converter, const ALvoid **src, ALsizei *srcframes, ALvoid *dst, ALsizei dstframes);
+
+
+/* Converts interleaved samples between mono and stereo, producing floats for
+ * a SampleConverter to take.
+ */
+typedef struct ChannelConverter {
+    enum DevFmtType SrcType;
+    enum DevFmtChannels SrcChans;
+    enum DevFmtChannels DstChans;
+} ChannelConverter;
+
+ChannelConverter *CreateChannelConverter(enum DevFmtType srcType, enum DevFmtChannels srcChans, enum DevFmtChannels dstChans);
+void DestroyChannelConverter(ChannelConverter **converter);
+
+void ChannelConverterInput(ChannelConverter *converter, const ALvoid *src, ALfloat *dst, ALsizei frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONVERTER_H */
@@ -96,7 +96,7 @@ static ALboolean ALchorusState_deviceUpdate(ALchorusState *state, ALCdevice *Dev
 
     if(maxlen != state->BufferLength)
     {
-        void *temp = al_calloc(16, maxlen * sizeof(ALfloat) * 2);
+        void *temp = al_calloc_tag(AllocTag_Effect, 16, maxlen * sizeof(ALfloat) * 2);
         if(!temp) return AL_FALSE;
 
         al_free(state->SampleBuffer[0]);
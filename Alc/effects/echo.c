@@ -93,7 +93,7 @@ static ALboolean ALechoState_deviceUpdate(ALechoState *state, ALCdevice *Device)
 
     if(maxlen != state->BufferLength)
     {
-        void *temp = al_calloc(16, maxlen * sizeof(ALfloat));
+        void *temp = al_calloc_tag(AllocTag_Effect, 16, maxlen * sizeof(ALfloat));
         if(!temp) return AL_FALSE;
 
         al_free(state->SampleBuffer);
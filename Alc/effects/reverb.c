@@ -452,7 +452,7 @@ static ALboolean AllocLines(ALuint frequency, ALreverbState *State)
         ALfloat *newBuffer;
 
         TRACE("New reverb buffer length: %u samples (%f sec)\n", totalSamples, totalSamples/(float)frequency);
-        newBuffer = al_calloc(16, sizeof(ALfloat) * totalSamples);
+        newBuffer = al_calloc_tag(AllocTag_Effect, 16, sizeof(ALfloat) * totalSamples);
         if(!newBuffer) return AL_FALSE;
 
         al_free(State->SampleBuffer);
@@ -26,6 +26,13 @@
 #endif
 #endif
 
+#ifdef __linux__
+/* For pthread_setaffinity_np and cpu_set_t */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
 #include "config.h"
 
 #include <stdlib.h>
@@ -920,6 +927,21 @@ void UnmapFileMem(const struct FileMapping *mapping)
 #endif
 
 
+ALuint64 GetMonotonicTime(void)
+{
+    struct timespec ts;
+    if(altimespec_get(&ts, AL_TIME_MONOTONIC) != AL_TIME_MONOTONIC &&
+       altimespec_get(&ts, AL_TIME_UTC) != AL_TIME_UTC)
+        return 0;
+    return (ALuint64)ts.tv_sec*U64(1000000000) + ts.tv_nsec;
+}
+
+
+static void SetRTAffinity(void);
+
+/* Sets the real-time priority and CPU affinity configured for mixing threads
+ * on the calling thread.
+ */
 void SetRTPriority(void)
 {
     ALboolean failed = AL_FALSE;
@@ -942,6 +964,47 @@ void SetRTPriority(void)
 #endif
     if(failed)
         ERR("Failed to set priority level for thread\n");
+
+    SetRTAffinity();
+}
+
+static void SetRTAffinity(void)
+{
+    ALboolean failed = AL_FALSE;
+    ALboolean any = AL_FALSE;
+    int i;
+
+    for(i = 0;i < MAX_RT_CPUS/32;i++)
+        any |= (RTCpuMask[i] != 0);
+    if(!any) return;
+
+#ifdef _WIN32
+    {
+        DWORD_PTR mask = 0;
+        for(i = 0;i < MAX_RT_CPUS && i < (int)sizeof(mask)*8;i++)
+        {
+            if((RTCpuMask[i>>5]&(1u<<(i&31))))
+                mask |= (DWORD_PTR)1 << i;
+        }
+        failed = !mask || !SetThreadAffinityMask(GetCurrentThread(), mask);
+    }
+#elif defined(HAVE_PTHREAD_SETAFFINITY_NP)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for(i = 0;i < MAX_RT_CPUS && i < CPU_SETSIZE;i++)
+        {
+            if((RTCpuMask[i>>5]&(1u<<(i&31))))
+                CPU_SET(i, &cpus);
+        }
+        failed = !!pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#else
+    /* Thread affinity not available */
+    failed = AL_TRUE;
+#endif
+    if(failed)
+        ERR("Failed to set CPU affinity for thread\n");
 }
 
 
@@ -473,7 +473,7 @@ static struct Hrtf *LoadHrtf00(const ALubyte *data, size_t datalen, const_al_str
         total += sizeof(delays[0])*irCount;
         total += al_string_length(filename)+1;
 
-        Hrtf = al_calloc(16, total);
+        Hrtf = al_calloc_tag(AllocTag_Hrtf, 16, total);
         if(Hrtf == NULL)
         {
             ERR("Out of memory.\n");
@@ -649,7 +649,7 @@ static struct Hrtf *LoadHrtf01(const ALubyte *data, size_t datalen, const_al_str
         total += sizeof(delays[0])*irCount;
         total += al_string_length(filename)+1;
 
-        Hrtf = al_calloc(16, total);
+        Hrtf = al_calloc_tag(AllocTag_Hrtf, 16, total);
         if(Hrtf == NULL)
         {
             ERR("Out of memory.\n");
@@ -34,6 +34,7 @@
 #include "alListener.h"
 #include "alAuxEffectSlot.h"
 #include "alu.h"
+#include "sample_cvt.h"
 
 #include "mixer_defs.h"
 
@@ -140,6 +141,11 @@ static inline ResamplerFunc SelectResampler(enum Resampler resampler)
     return Resample_point32_C;
 }
 
+ResamplerFunc SelectConfiguredResampler(void)
+{
+    return ResampleSamples;
+}
+
 
 /* The sinc resampler makes use of a Kaiser window to limit the needed sample
  * points to 4 and 8, respectively.
@@ -320,6 +326,101 @@ static void LoadSamples(ALfloat *dst, const ALvoid *src, ALuint srcstep, enum Fm
         case FmtFloat:
             Load_ALfloat(dst, src, srcstep, samples);
             break;
+        case FmtIMA4:
+        case FmtMSADPCM:
+            /* Decoded by LoadBufferSamples. */
+            break;
+    }
+}
+
+/* Loads samples for one channel of a buffer, decoding compressed data as
+ * needed. The voice's decoder state for the channel is reused when it's
+ * already within the requested block, so continuous playback only decodes
+ * each sample once, and seeking or looping restarts at the nearest block.
+ * Decoding works on a copy of the state, which is only stored back once it
+ * reaches nextpos (where the next update will start loading from), so the
+ * lookahead past that doesn't leave the state ahead of the next load.
+ */
+static void LoadBufferSamples(ALfloat *dst, ADPCMState *state, const ALbuffer *buffer,
+                              ALuint chan, ALuint numchans, ALuint pos, ALuint samples,
+                              ALuint nextpos)
+{
+    const ALubyte *Data = buffer->data;
+    ALuint align, blocksize;
+    ADPCMState cur;
+
+    if(buffer->FmtType != FmtIMA4 && buffer->FmtType != FmtMSADPCM)
+    {
+        ALuint samplesize = BytesFromFmt(buffer->FmtType);
+        LoadSamples(dst, &Data[(pos*numchans + chan)*samplesize], numchans,
+                    buffer->FmtType, samples);
+        return;
+    }
+
+    align = buffer->OriginalAlign;
+    blocksize = BlockSizeFromFmt(buffer->FmtChannels, buffer->FmtType, align);
+    cur = *state;
+    while(samples > 0)
+    {
+        ALuint block = pos / align;
+        ALuint offset = pos % align;
+        const ALubyte *src = &Data[block * blocksize];
+        ALshort tmp[256];
+        ALuint todo;
+
+        if(cur.Buffer != buffer || cur.Block != block || cur.Pos > offset)
+        {
+            ADPCMState_reset(&cur, buffer->FmtType, src, chan, numchans);
+            cur.Buffer = buffer;
+            cur.Block = block;
+        }
+        if(cur.Pos < offset)
+            DecodeADPCMSamples(NULL, &cur, buffer->FmtType, src, chan, numchans,
+                               offset - cur.Pos);
+        if(pos == nextpos)
+            *state = cur;
+
+        todo = minu(minu(align - offset, samples), COUNTOF(tmp));
+        /* Stop at nextpos so the state there can be kept. */
+        if(pos < nextpos && nextpos-pos < todo)
+            todo = nextpos - pos;
+        DecodeADPCMSamples(tmp, &cur, buffer->FmtType, src, chan, numchans, todo);
+        LoadSamples(dst, tmp, 1, FmtShort, todo);
+
+        dst += todo;
+        pos += todo;
+        samples -= todo;
+    }
+    if(pos == nextpos)
+        *state = cur;
+}
+
+/* Pulls more samples from a callback buffer so at least 'needed' frames are
+ * available from the current position, first dropping those already played.
+ * The position is kept relative to the start of the lookahead.
+ */
+static void FillCallbackBuffer(ALvoice *voice, const ALbuffer *buffer, ALuint *pos, ALuint needed)
+{
+    ALuint framesize = FrameSizeFromFmt(buffer->FmtChannels, buffer->FmtType);
+    ALubyte *data = buffer->data;
+
+    if(*pos > 0)
+    {
+        ALuint played = minu(*pos, voice->CallbackCount);
+        memmove(data, data + played*framesize, (voice->CallbackCount-played)*framesize);
+        voice->CallbackCount -= played;
+        *pos -= played;
+    }
+
+    if(!voice->CallbackDone && voice->CallbackCount < needed)
+    {
+        ALsizei todo = (needed - voice->CallbackCount) * framesize;
+        ALsizei got = buffer->Callback(buffer->UserData,
+            data + voice->CallbackCount*framesize, todo
+        );
+        if(got < todo)
+            voice->CallbackDone = AL_TRUE;
+        voice->CallbackCount += (ALuint)maxi(got, 0) / framesize;
     }
 }
 
@@ -368,31 +469,47 @@ static const ALfloat *DoFilters(ALfilterState *lpfilter, ALfilterState *hpfilter
 }
 
 
-ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint SamplesToDo)
+ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, MixBuffers *mix, ALuint SamplesToDo)
 {
+    ALfloat *SourceData = mix ? mix->SourceData : Device->SourceData;
+    ALfloat *ResampledBuffer = mix ? mix->ResampledData : Device->ResampledData;
+    ALfloat *FilteredBuffer = mix ? mix->FilteredData : Device->FilteredData;
+    ALfloatBUFFERSIZE *DirectBuffer = GetMixBuffer(Device, mix, voice->DirectOut.Buffer);
     ResamplerFunc Resample;
-    ALbufferlistitem *BufferListItem;
+    ALbufferqueue *BufferQueue;
+    const ALbuffer *CallbackBuffer;
+    ALuint QueueHead, QueueTail;
+    ALuint BufferListItem;
     ALuint DataPosInt, DataPosFrac;
+    ALuint NextPosInt;
     ALboolean Looping;
     ALuint increment;
     ALenum State;
     ALuint OutPos;
     ALuint NumChannels;
-    ALuint SampleSize;
     ALint64 DataSize64;
     ALuint IrSize;
     ALuint chan, send, j;
 
     /* Get source info */
     State          = AL_PLAYING; /* Only called while playing. */
+    QueueTail      = ATOMIC_LOAD(&Source->queue_tail);
+    QueueHead      = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+    BufferQueue    = ATOMIC_LOAD(&Source->queue);
     BufferListItem = ATOMIC_LOAD(&Source->current_buffer);
     DataPosInt     = ATOMIC_LOAD(&Source->position, almemory_order_relaxed);
     DataPosFrac    = ATOMIC_LOAD(&Source->position_fraction, almemory_order_relaxed);
     Looping        = ATOMIC_LOAD(&Source->looping, almemory_order_relaxed);
     NumChannels    = Source->NumChannels;
-    SampleSize     = Source->SampleSize;
     increment      = voice->Step;
 
+    CallbackBuffer = NULL;
+    if(Source->SourceType == AL_STATIC)
+    {
+        const ALbuffer *ALBuffer = GetBufferQueueItem(BufferQueue, BufferListItem)->buffer;
+        if(ALBuffer && ALBuffer->Callback) CallbackBuffer = ALBuffer;
+    }
+
     IrSize = (Device->Hrtf.Handle ? Device->Hrtf.Handle->irSize : 0);
 
     Resample = ((increment == FRACTIONONE && DataPosFrac == 0) ?
@@ -438,26 +555,42 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
         if(OutPos+DstBufferSize < SamplesToDo)
             DstBufferSize &= ~3;
 
+        if(CallbackBuffer)
+            FillCallbackBuffer(voice, CallbackBuffer, &DataPosInt,
+                               SrcBufferSize - MAX_PRE_SAMPLES);
+
+        /* Where the next update will start loading from, for keeping the
+         * decoder state of compressed buffers. */
+        NextPosInt = DataPosInt + ((DataPosFrac + increment*DstBufferSize)>>FRACTIONBITS);
+
         for(chan = 0;chan < NumChannels;chan++)
         {
             const ALfloat *ResampledData;
-            ALfloat *SrcData = Device->SourceData;
+            ALfloat *SrcData = SourceData;
             ALuint SrcDataSize;
 
             /* Load the previous samples into the source data first. */
             memcpy(SrcData, voice->PrevSamples[chan], MAX_PRE_SAMPLES*sizeof(ALfloat));
             SrcDataSize = MAX_PRE_SAMPLES;
 
-            if(Source->SourceType == AL_STATIC)
+            if(CallbackBuffer)
+            {
+                ALuint DataSize = voice->CallbackCount - minu(DataPosInt, voice->CallbackCount);
+                DataSize = minu(SrcBufferSize - SrcDataSize, DataSize);
+
+                LoadBufferSamples(&SrcData[SrcDataSize], &voice->Decoder[chan], CallbackBuffer,
+                                  chan, NumChannels, DataPosInt, DataSize, NextPosInt);
+                SrcDataSize += DataSize;
+
+                SilenceSamples(&SrcData[SrcDataSize], SrcBufferSize - SrcDataSize);
+                SrcDataSize += SrcBufferSize - SrcDataSize;
+            }
+            else if(Source->SourceType == AL_STATIC)
             {
-                const ALbuffer *ALBuffer = BufferListItem->buffer;
-                const ALubyte *Data = ALBuffer->data;
+                const ALbuffer *ALBuffer = GetBufferQueueItem(BufferQueue, BufferListItem)->buffer;
                 ALuint DataSize;
                 ALuint pos;
 
-                /* Offset buffer data to current channel */
-                Data += chan*SampleSize;
-
                 /* If current pos is beyond the loop range, do not loop */
                 if(Looping == AL_FALSE || DataPosInt >= (ALuint)ALBuffer->LoopEnd)
                 {
@@ -468,8 +601,8 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                     pos = DataPosInt;
                     DataSize = minu(SrcBufferSize - SrcDataSize, ALBuffer->SampleLen - pos);
 
-                    LoadSamples(&SrcData[SrcDataSize], &Data[pos * NumChannels*SampleSize],
-                                NumChannels, ALBuffer->FmtType, DataSize);
+                    LoadBufferSamples(&SrcData[SrcDataSize], &voice->Decoder[chan], ALBuffer,
+                                      chan, NumChannels, pos, DataSize, NextPosInt);
                     SrcDataSize += DataSize;
 
                     SilenceSamples(&SrcData[SrcDataSize], SrcBufferSize - SrcDataSize);
@@ -479,6 +612,10 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                 {
                     ALuint LoopStart = ALBuffer->LoopStart;
                     ALuint LoopEnd   = ALBuffer->LoopEnd;
+                    ALuint nextpos   = NextPosInt;
+
+                    if(nextpos >= LoopEnd)
+                        nextpos = LoopStart + (nextpos-LoopEnd)%(LoopEnd-LoopStart);
 
                     /* Load what's left of this loop iteration, then load
                      * repeats of the loop section */
@@ -486,8 +623,8 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                     DataSize = LoopEnd - pos;
                     DataSize = minu(SrcBufferSize - SrcDataSize, DataSize);
 
-                    LoadSamples(&SrcData[SrcDataSize], &Data[pos * NumChannels*SampleSize],
-                                NumChannels, ALBuffer->FmtType, DataSize);
+                    LoadBufferSamples(&SrcData[SrcDataSize], &voice->Decoder[chan], ALBuffer,
+                                      chan, NumChannels, pos, DataSize, nextpos);
                     SrcDataSize += DataSize;
 
                     DataSize = LoopEnd-LoopStart;
@@ -495,45 +632,49 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                     {
                         DataSize = minu(SrcBufferSize - SrcDataSize, DataSize);
 
-                        LoadSamples(&SrcData[SrcDataSize], &Data[LoopStart * NumChannels*SampleSize],
-                                    NumChannels, ALBuffer->FmtType, DataSize);
+                        LoadBufferSamples(&SrcData[SrcDataSize], &voice->Decoder[chan], ALBuffer,
+                                          chan, NumChannels, LoopStart, DataSize, nextpos);
                         SrcDataSize += DataSize;
                     }
                 }
             }
             else
             {
-                /* Crawl the buffer queue to fill in the temp buffer */
-                ALbufferlistitem *tmpiter = BufferListItem;
+                /* Walk the buffer queue to fill in the temp buffer */
+                ALuint tmpiter = BufferListItem;
                 ALuint pos = DataPosInt;
+                ALuint nextpos = NextPosInt;
 
-                while(tmpiter && SrcBufferSize > SrcDataSize)
+                while(tmpiter != QueueTail && SrcBufferSize > SrcDataSize)
                 {
                     const ALbuffer *ALBuffer;
-                    if((ALBuffer=tmpiter->buffer) != NULL)
+                    if((ALBuffer=GetBufferQueueItem(BufferQueue, tmpiter)->buffer) != NULL)
                     {
-                        const ALubyte *Data = ALBuffer->data;
                         ALuint DataSize = ALBuffer->SampleLen;
+                        /* The next update's position in this buffer, if in it. */
+                        ALuint bufnext = (nextpos < DataSize) ? nextpos : ~0u;
+
+                        if(nextpos != ~0u)
+                            nextpos = (nextpos < DataSize) ? ~0u : nextpos-DataSize;
 
                         /* Skip the data already played */
                         if(DataSize <= pos)
                             pos -= DataSize;
                         else
                         {
-                            Data += (pos*NumChannels + chan)*SampleSize;
                             DataSize -= pos;
-                            pos -= pos;
 
                             DataSize = minu(SrcBufferSize - SrcDataSize, DataSize);
-                            LoadSamples(&SrcData[SrcDataSize], Data, NumChannels,
-                                        ALBuffer->FmtType, DataSize);
+                            LoadBufferSamples(&SrcData[SrcDataSize], &voice->Decoder[chan],
+                                              ALBuffer, chan, NumChannels, pos, DataSize,
+                                              bufnext);
                             SrcDataSize += DataSize;
+                            pos -= pos;
                         }
                     }
-                    tmpiter = tmpiter->next;
-                    if(!tmpiter && Looping)
-                        tmpiter = ATOMIC_LOAD(&Source->queue);
-                    else if(!tmpiter)
+                    if(++tmpiter == QueueTail && Looping)
+                        tmpiter = QueueHead;
+                    else if(tmpiter == QueueTail)
                     {
                         SilenceSamples(&SrcData[SrcDataSize], SrcBufferSize - SrcDataSize);
                         SrcDataSize += SrcBufferSize - SrcDataSize;
@@ -550,14 +691,14 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
             /* Now resample, then filter and mix to the appropriate outputs. */
             ResampledData = Resample(&voice->SincState,
                 &SrcData[MAX_PRE_SAMPLES], DataPosFrac, increment,
-                Device->ResampledData, DstBufferSize
+                ResampledBuffer, DstBufferSize
             );
             {
                 DirectParams *parms = &voice->Chan[chan].Direct;
                 const ALfloat *samples;
 
                 samples = DoFilters(
-                    &parms->LowPass, &parms->HighPass, Device->FilteredData,
+                    &parms->LowPass, &parms->HighPass, FilteredBuffer,
                     ResampledData, DstBufferSize, parms->FilterType
                 );
                 if(!voice->IsHrtf)
@@ -593,7 +734,7 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                         }
                     }
 
-                    MixSamples(samples, voice->DirectOut.Channels, voice->DirectOut.Buffer,
+                    MixSamples(samples, voice->DirectOut.Channels, DirectBuffer,
                                gains, Counter, OutPos, DstBufferSize);
 
                     for(j = 0;j < voice->DirectOut.Channels;j++)
@@ -638,7 +779,7 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                     ridx = GetChannelIdxByName(Device->RealOut, FrontRight);
                     assert(lidx != -1 && ridx != -1);
 
-                    MixHrtfSamples(voice->DirectOut.Buffer, lidx, ridx, samples, Counter,
+                    MixHrtfSamples(DirectBuffer, lidx, ridx, samples, Counter,
                                    voice->Offset, OutPos, IrSize, &hrtfparams,
                                    &parms->Hrtf.State, DstBufferSize);
                 }
@@ -656,7 +797,7 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                     continue;
 
                 samples = DoFilters(
-                    &parms->LowPass, &parms->HighPass, Device->FilteredData,
+                    &parms->LowPass, &parms->HighPass, FilteredBuffer,
                     ResampledData, DstBufferSize, parms->FilterType
                 );
 
@@ -688,7 +829,8 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
                 }
 
                 MixSamples(samples,
-                    voice->SendOut[send].Channels, voice->SendOut[send].Buffer,
+                    voice->SendOut[send].Channels,
+                    GetMixBuffer(Device, mix, voice->SendOut[send].Buffer),
                     gains, Counter, OutPos, DstBufferSize
                 );
 
@@ -704,6 +846,19 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
         OutPos += DstBufferSize;
         voice->Offset += DstBufferSize;
 
+        /* Callback streams play until the callback runs out of samples. */
+        if(CallbackBuffer)
+        {
+            if(voice->CallbackDone && DataPosInt >= voice->CallbackCount)
+            {
+                State = AL_STOPPED;
+                BufferListItem = QueueTail;
+                DataPosInt = 0;
+                DataPosFrac = 0;
+            }
+            continue;
+        }
+
         /* Handle looping sources */
         while(1)
         {
@@ -712,7 +867,7 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
             ALuint LoopStart = 0;
             ALuint LoopEnd = 0;
 
-            if((ALBuffer=BufferListItem->buffer) != NULL)
+            if((ALBuffer=GetBufferQueueItem(BufferQueue, BufferListItem)->buffer) != NULL)
             {
                 DataSize = ALBuffer->SampleLen;
                 LoopStart = ALBuffer->LoopStart;
@@ -731,14 +886,19 @@ ALvoid MixSource(ALvoice *voice, ALsource *Source, ALCdevice *Device, ALuint Sam
             if(DataSize > DataPosInt)
                 break;
 
-            if(!(BufferListItem=BufferListItem->next))
+            if(++BufferListItem == QueueTail)
+            {
+                /* Pick up any buffers queued since the mix started. */
+                QueueTail = ATOMIC_LOAD(&Source->queue_tail);
+                BufferQueue = ATOMIC_LOAD(&Source->queue);
+            }
+            if(BufferListItem == QueueTail)
             {
                 if(Looping)
-                    BufferListItem = ATOMIC_LOAD(&Source->queue);
+                    BufferListItem = QueueHead;
                 else
                 {
                     State = AL_STOPPED;
-                    BufferListItem = NULL;
                     DataPosInt = 0;
                     DataPosFrac = 0;
                     break;
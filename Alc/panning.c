@@ -990,7 +990,7 @@ no_hrtf:
         ConfigValueInt(al_string_get_cstr(device->DeviceName), NULL, "cf_level", &bs2blevel);
     if(bs2blevel > 0 && bs2blevel <= 6)
     {
-        device->Bs2b = al_calloc(16, sizeof(*device->Bs2b));
+        device->Bs2b = al_calloc_tag(AllocTag_Device, 16, sizeof(*device->Bs2b));
         bs2b_set_params(device->Bs2b, bs2blevel, device->Frequency);
         device->Render_Mode = StereoPair;
         TRACE("BS2B enabled\n");
@@ -1010,7 +1010,7 @@ no_hrtf:
     }
     if(device->Render_Mode == NormalRender)
     {
-        device->Uhj_Encoder = al_calloc(16, sizeof(Uhj2Encoder));
+        device->Uhj_Encoder = al_calloc_tag(AllocTag_Device, 16, sizeof(Uhj2Encoder));
         TRACE("UHJ enabled\n");
         InitUhjPanning(device);
         return;
@@ -0,0 +1,311 @@
+/**
+ * OpenAL cross platform audio library
+ * Copyright (C) 2017 by authors.
+ * This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the
+ *  Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * Or go to http://www.gnu.org/copyleft/lgpl.html
+ */
+
+#include "config.h"
+
+#include "trace.h"
+
+#ifdef ALSOFT_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alMain.h"
+#include "alu.h"
+#include "threads.h"
+#include "almalloc.h"
+#include "compat.h"
+
+
+typedef struct TraceEvent {
+    /* Must be a string literal, or otherwise outlive the trace. */
+    const char *Name;
+    ALuint64 Time;
+    ALuint64 Duration;
+    ALuint Arg;
+    /* 'B'egin, 'E'nd, or 'X' for a complete event with a duration. */
+    char Phase;
+} TraceEvent;
+
+typedef struct TraceRing {
+    /* Total number of events written. Only the owning thread writes events,
+     * so this is only updated by it after the event is filled in.
+     */
+    ATOMIC(ALuint) WritePos;
+    ALuint ThreadId;
+
+    /* Set while a thread owns the ring. */
+    ATOMIC(ALenum) InUse;
+
+    struct TraceRing *next;
+
+    TraceEvent Events[TRACE_RING_SIZE];
+} TraceRing;
+
+/* Rings are kept after their thread exits, so the trace still includes the
+ * events of finished threads until another thread reuses the ring. They're
+ * only freed when the library unloads.
+ */
+static ATOMIC(TraceRing*) TraceRingList = ATOMIC_INIT_STATIC(NULL);
+static RefCount TraceThreadCount = ATOMIC_INIT_STATIC(0);
+static altss_t TraceRingKey;
+static ALboolean TraceInitialized = AL_FALSE;
+
+ALuint64 TraceVoiceThreshold = 50000;
+
+
+static void ReleaseTraceRing(void *ptr)
+{
+    TraceRing *ring = ptr;
+    ATOMIC_STORE(&ring->InUse, AL_FALSE, almemory_order_release);
+}
+
+void TraceInit(void)
+{
+    ALuint thresh;
+
+    if(altss_create(&TraceRingKey, ReleaseTraceRing) != althrd_success)
+    {
+        ERR("Failed to create trace ring key\n");
+        return;
+    }
+    TraceInitialized = AL_TRUE;
+
+    if(ConfigValueUInt(NULL, "trace", "voice-threshold", &thresh))
+        TraceVoiceThreshold = (ALuint64)thresh * 1000;
+    TRACE("Tracing enabled, %d events per thread, voices over %uus\n", TRACE_RING_SIZE,
+          (ALuint)(TraceVoiceThreshold/1000));
+}
+
+void TraceDeinit(void)
+{
+    const char *str;
+    TraceRing *ring;
+
+    if(!TraceInitialized)
+        return;
+
+    str = getenv("ALSOFT_TRACE_FILE");
+    if(str && str[0])
+        TraceDump(str);
+
+    ring = ATOMIC_EXCHANGE(TraceRing*, &TraceRingList, NULL);
+    while(ring)
+    {
+        TraceRing *next = ring->next;
+        al_free(ring);
+        ring = next;
+    }
+    altss_delete(TraceRingKey);
+    TraceInitialized = AL_FALSE;
+}
+
+
+static TraceRing *AddTraceRing(ALenum inuse)
+{
+    TraceRing *ring = al_calloc(16, sizeof(*ring));
+    if(!ring) return NULL;
+    ATOMIC_INIT(&ring->WritePos, 0);
+    ATOMIC_INIT(&ring->InUse, inuse);
+
+    ring->next = ATOMIC_LOAD(&TraceRingList, almemory_order_relaxed);
+    while(!ATOMIC_COMPARE_EXCHANGE_WEAK(TraceRing*, &TraceRingList, &ring->next, ring))
+    {
+        /* ring->next is updated with the current head on failure. */
+    }
+    return ring;
+}
+
+void TraceReserveRings(ALsizei count)
+{
+    TraceRing *ring;
+
+    if(!TraceInitialized)
+        return;
+
+    ring = ATOMIC_LOAD(&TraceRingList, almemory_order_acquire);
+    while(ring && count > 0)
+    {
+        if(!ATOMIC_LOAD(&ring->InUse, almemory_order_acquire))
+            count--;
+        ring = ring->next;
+    }
+    while(count-- > 0)
+    {
+        if(!AddTraceRing(AL_FALSE))
+            break;
+    }
+}
+
+static TraceRing *GetTraceRing(void)
+{
+    TraceRing *ring;
+
+    if(!TraceInitialized)
+        return NULL;
+    if((ring=altss_get(TraceRingKey)) != NULL)
+        return ring;
+
+    /* Claim a free ring, dropping the events of the thread that last had it,
+     * before resorting to allocating a new one. Rings are never removed from
+     * the list while tracing, so it's safe to walk.
+     */
+    ring = ATOMIC_LOAD(&TraceRingList, almemory_order_acquire);
+    while(ring)
+    {
+        ALenum inuse = AL_FALSE;
+        if(ATOMIC_COMPARE_EXCHANGE_STRONG(ALenum, &ring->InUse, &inuse, AL_TRUE))
+        {
+            ATOMIC_STORE(&ring->WritePos, 0, almemory_order_release);
+            break;
+        }
+        ring = ring->next;
+    }
+    if(!ring && !(ring=AddTraceRing(AL_TRUE)))
+        return NULL;
+    ring->ThreadId = IncrementRef(&TraceThreadCount);
+    altss_set(TraceRingKey, ring);
+
+    return ring;
+}
+
+static void RecordEvent(const char *name, char phase, ALuint arg, ALuint64 time, ALuint64 duration)
+{
+    TraceRing *ring = GetTraceRing();
+    TraceEvent *evt;
+    ALuint pos;
+
+    if(!ring) return;
+
+    pos = ATOMIC_LOAD(&ring->WritePos, almemory_order_relaxed);
+    evt = &ring->Events[pos & (TRACE_RING_SIZE-1)];
+    evt->Name = name;
+    evt->Time = time;
+    evt->Duration = duration;
+    evt->Arg = arg;
+    evt->Phase = phase;
+    ATOMIC_STORE(&ring->WritePos, pos+1, almemory_order_release);
+}
+
+void TraceEventBegin(const char *name, ALuint arg)
+{
+    RecordEvent(name, 'B', arg, GetMonotonicTime(), 0);
+}
+
+void TraceEventEnd(const char *name)
+{
+    RecordEvent(name, 'E', 0, GetMonotonicTime(), 0);
+}
+
+void TraceEventCost(const char *name, ALuint arg, ALuint64 start, ALuint64 threshold)
+{
+    ALuint64 now = GetMonotonicTime();
+    if(now-start >= threshold)
+        RecordEvent(name, 'X', arg, start, now-start);
+}
+
+
+static void WriteEvent(FILE *f, const TraceRing *ring, const TraceEvent *evt)
+{
+    fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+            evt->Name, evt->Phase, evt->Time/1000.0, ring->ThreadId);
+    if(evt->Phase == 'X')
+        fprintf(f, ",\"dur\":%.3f", evt->Duration/1000.0);
+    if(evt->Phase != 'E')
+        fprintf(f, ",\"args\":{\"id\":%u}", evt->Arg);
+    fputc('}', f);
+}
+
+ALboolean TraceDump(const char *fname)
+{
+    TraceEvent *events;
+    ALboolean first;
+    TraceRing *ring;
+    FILE *f;
+
+    if(!TraceInitialized)
+        return AL_FALSE;
+
+    f = al_fopen(fname, "wt");
+    if(!f)
+    {
+        ERR("Failed to open trace file '%s'\n", fname);
+        return AL_FALSE;
+    }
+    events = malloc(TRACE_RING_SIZE * sizeof(*events));
+    if(!events)
+    {
+        fclose(f);
+        return AL_FALSE;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    first = AL_TRUE;
+    ring = ATOMIC_LOAD(&TraceRingList, almemory_order_acquire);
+    while(ring)
+    {
+        ALuint base, start, end, i;
+
+        /* Skip reserved rings no thread has claimed yet. */
+        if(ring->ThreadId == 0)
+        {
+            ring = ring->next;
+            continue;
+        }
+
+        /* Copy out the events, then skip any the owning thread overwrote
+         * while they were being copied. With the write position at W, the
+         * event for W may be partly written already, which overwrites
+         * W-TRACE_RING_SIZE, so only events after that are kept.
+         */
+        end = ATOMIC_LOAD(&ring->WritePos, almemory_order_acquire);
+        base = (end > TRACE_RING_SIZE) ? end-TRACE_RING_SIZE : 0;
+        for(i = base;i != end;i++)
+            events[i-base] = ring->Events[i & (TRACE_RING_SIZE-1)];
+        start = ATOMIC_LOAD(&ring->WritePos, almemory_order_acquire) + 1;
+        start = (start > TRACE_RING_SIZE) ? start-TRACE_RING_SIZE : 0;
+        start = clampu(start, base, end);
+
+        fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                   "\"args\":{\"name\":\"Thread %u\"}}",
+                first ? "" : ",", ring->ThreadId, ring->ThreadId);
+        first = AL_FALSE;
+
+        for(i = start;i != end;i++)
+            WriteEvent(f, ring, &events[i-base]);
+
+        ring = ring->next;
+    }
+    fprintf(f, "\n]}\n");
+
+    free(events);
+    if(ferror(f))
+    {
+        ERR("Error writing trace file '%s'\n", fname);
+        fclose(f);
+        return AL_FALSE;
+    }
+    fclose(f);
+
+    TRACE("Wrote trace to %s\n", fname);
+    return AL_TRUE;
+}
+
+#endif /* ALSOFT_TRACE */
@@ -0,0 +1,58 @@
+#ifndef ALC_TRACE_H
+#define ALC_TRACE_H
+
+#include "alMain.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ALSOFT_TRACE
+
+/* Each thread records its events into its own fixed-size ring, overwriting
+ * the oldest events once full. Recording never locks or allocates, except for
+ * a thread's first event, which claims a free ring and only allocates one if
+ * none are free. A thread's ring is freed for reuse when the thread exits.
+ */
+#define TRACE_RING_SIZE (1<<14)
+
+/* Voices that take less than this long to mix (in nanoseconds) are left out
+ * of the trace, to keep the rings from filling with cheap voices.
+ */
+extern ALuint64 TraceVoiceThreshold;
+
+void TraceInit(void);
+void TraceDeinit(void);
+
+/* Makes sure at least the given number of rings are free, so threads that are
+ * about to start (e.g. a device's mixer) don't allocate one while mixing.
+ */
+void TraceReserveRings(ALsizei count);
+
+void TraceEventBegin(const char *name, ALuint arg);
+void TraceEventEnd(const char *name);
+/* Records an event that started at the given time and ended now, if it took
+ * at least the given threshold.
+ */
+void TraceEventCost(const char *name, ALuint arg, ALuint64 start, ALuint64 threshold);
+
+/* Writes every thread's events as Chrome trace-event JSON. */
+ALboolean TraceDump(const char *fname);
+
+#define TRACE_BEGIN(name, arg) TraceEventBegin((name), (arg))
+#define TRACE_END(name) TraceEventEnd((name))
+#define TRACE_RESERVE_RINGS(count) TraceReserveRings((count))
+
+#else
+
+#define TRACE_BEGIN(name, arg) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_RESERVE_RINGS(count) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ALC_TRACE_H */
@@ -49,6 +49,8 @@ enum FmtType {
     FmtByte  = UserFmtByte,
     FmtShort = UserFmtShort,
     FmtFloat = UserFmtFloat,
+    FmtIMA4  = UserFmtIMA4,
+    FmtMSADPCM = UserFmtMSADPCM,
 };
 enum FmtChannels {
     FmtMono   = UserFmtMono,
@@ -69,6 +71,21 @@ inline ALuint FrameSizeFromFmt(enum FmtChannels chans, enum FmtType type)
 {
     return ChannelsFromFmt(chans) * BytesFromFmt(type);
 }
+ALuint BlockSizeFromFmt(enum FmtChannels chans, enum FmtType type, ALsizei align);
+
+/* Decoder state for one channel of a compressed (IMA4 or MSADPCM) buffer.
+ * Holds the predictor after decoding up to Pos within the given block, so
+ * the mixer can continue decoding without restarting from the block header.
+ */
+typedef struct ADPCMState {
+    const struct ALbuffer *Buffer;
+    ALuint Block;
+    ALuint Pos;
+
+    ALint Sample[2];
+    ALint Index;
+    ALint Pred;
+} ADPCMState;
 
 
 typedef struct ALbuffer {
@@ -81,6 +98,14 @@ typedef struct ALbuffer {
     enum FmtChannels FmtChannels;
     enum FmtType     FmtType;
     ALuint BytesAlloc;
+    /* Set when data references app-provided memory (alBufferDataStatic),
+     * which is neither written to nor freed here. */
+    ALboolean StaticData;
+
+    /* When set, samples are pulled from the app as the mixer needs them, and
+     * data holds the lookahead (alBufferCallbackSOFT). */
+    ALBUFFERCALLBACKTYPESOFT Callback;
+    ALvoid *UserData;
 
     enum UserFmtChannels OriginalChannels;
     enum UserFmtType     OriginalType;
@@ -54,6 +54,62 @@ ALC_API void ALC_APIENTRY alcGetInteger64vSOFT(ALCdevice *device, ALCenum pname,
 #endif
 #endif
 
+#ifndef ALC_SOFT_loopback_planar
+#define ALC_SOFT_loopback_planar 1
+#define ALC_OUTPUT_BUS_SOFT                      0x1610
+#define ALC_DRY_BUS_SOFT                         0x1611
+#define ALC_DRY_BUS_CHANNELS_SOFT                0x1612
+typedef void (ALC_APIENTRY*LPALCRENDERSAMPLESPLANARSOFT)(ALCdevice *device, ALCenum bus, ALCfloat *const *buffers, ALCsizei numchans, ALCsizei samples);
+#ifdef AL_ALEXT_PROTOTYPES
+ALC_API void ALC_APIENTRY alcRenderSamplesPlanarSOFT(ALCdevice *device, ALCenum bus, ALCfloat *const *buffers, ALCsizei numchans, ALCsizei samples);
+#endif
+#endif
+
+#ifndef ALC_SOFT_mix_timing
+#define ALC_SOFT_mix_timing 1
+#define ALC_MIX_TIME_TOTAL_SOFT                  0x1620
+#define ALC_MIX_TIME_PARAMS_SOFT                 0x1621
+#define ALC_MIX_TIME_VOICES_SOFT                 0x1622
+#define ALC_MIX_TIME_EFFECTS_SOFT                0x1623
+#define ALC_MIX_TIME_DECODE_SOFT                 0x1624
+#define ALC_MIX_TIME_OUTPUT_SOFT                 0x1625
+#define ALC_MIX_LOAD_SOFT                        0x1626
+#define ALC_MIX_TIME_COUNT_SOFT                  0x1627
+#endif
+
+#ifndef ALC_SOFT_backend_stats
+#define ALC_SOFT_backend_stats 1
+#define ALC_BACKEND_XRUNS_SOFT                   0x1628
+#define ALC_BACKEND_JITTER_HISTOGRAM_SIZE_SOFT   0x1629
+#define ALC_BACKEND_JITTER_HISTOGRAM_SOFT        0x162A
+#endif
+
+#ifndef ALC_SOFT_memory_stats
+#define ALC_SOFT_memory_stats 1
+#define ALC_MEMORY_TAG_COUNT_SOFT                0x162B
+#define ALC_MEMORY_LIVE_BYTES_SOFT               0x162C
+#define ALC_MEMORY_PEAK_BYTES_SOFT               0x162D
+#define ALC_MEMORY_TAG_NAME_SOFT                 0x162E
+#endif
+
+#ifndef ALC_SOFT_mix_trace
+#define ALC_SOFT_mix_trace 1
+typedef ALCboolean (ALC_APIENTRY*LPALCDUMPTRACESOFT)(ALCdevice *device, const ALCchar *filename);
+#ifdef AL_ALEXT_PROTOTYPES
+ALC_API ALCboolean ALC_APIENTRY alcDumpTraceSOFT(ALCdevice *device, const ALCchar *filename);
+#endif
+#endif
+
+#ifndef ALC_SOFT_capture_map
+#define ALC_SOFT_capture_map 1
+typedef void (ALC_APIENTRY*LPALCCAPTUREMAPSAMPLESSOFT)(ALCdevice *device, ALCvoid **buffer1, ALCsizei *samples1, ALCvoid **buffer2, ALCsizei *samples2);
+typedef void (ALC_APIENTRY*LPALCCAPTURECOMMITSAMPLESSOFT)(ALCdevice *device, ALCsizei samples);
+#ifdef AL_ALEXT_PROTOTYPES
+ALC_API void ALC_APIENTRY alcCaptureMapSamplesSOFT(ALCdevice *device, ALCvoid **buffer1, ALCsizei *samples1, ALCvoid **buffer2, ALCsizei *samples2);
+ALC_API void ALC_APIENTRY alcCaptureCommitSamplesSOFT(ALCdevice *device, ALCsizei samples);
+#endif
+#endif
+
 #ifndef AL_SOFT_buffer_samples2
 #define AL_SOFT_buffer_samples2 1
 /* Channel configurations */
@@ -132,6 +188,39 @@ AL_API ALboolean AL_APIENTRY alIsBufferFormatSupportedSOFT(ALenum format);
 #define AL_GAIN_LIMIT_SOFT                       0x200E
 #endif
 
+#ifndef AL_SOFT_callback_buffer
+#define AL_SOFT_callback_buffer 1
+typedef ALsizei (AL_APIENTRY*ALBUFFERCALLBACKTYPESOFT)(ALvoid *userptr, ALvoid *sampledata, ALsizei numbytes);
+typedef void (AL_APIENTRY*LPALBUFFERCALLBACKSOFT)(ALuint buffer, ALenum format, ALsizei freq, ALBUFFERCALLBACKTYPESOFT callback, ALvoid *userptr);
+#ifdef AL_ALEXT_PROTOTYPES
+AL_API void AL_APIENTRY alBufferCallbackSOFT(ALuint buffer, ALenum format, ALsizei freq, ALBUFFERCALLBACKTYPESOFT callback, ALvoid *userptr);
+#endif
+#endif
+
+#ifndef AL_SOFT_events
+#define AL_SOFT_events 1
+#define AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT      0x19A4
+#define AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT  0x19A5
+#define AL_EVENT_TYPE_EVENTS_LOST_SOFT           0x19A6
+typedef void (AL_APIENTRY*ALEVENTPROCSOFT)(ALenum eventType, ALuint object, ALuint param,
+                                           ALsizei length, const ALchar *message,
+                                           void *userParam);
+typedef void (AL_APIENTRY*LPALEVENTCONTROLSOFT)(ALsizei count, const ALenum *types, ALboolean enable);
+typedef void (AL_APIENTRY*LPALEVENTCALLBACKSOFT)(ALEVENTPROCSOFT callback, void *userParam);
+#ifdef AL_ALEXT_PROTOTYPES
+AL_API void AL_APIENTRY alEventControlSOFT(ALsizei count, const ALenum *types, ALboolean enable);
+AL_API void AL_APIENTRY alEventCallbackSOFT(ALEVENTPROCSOFT callback, void *userParam);
+#endif
+#endif
+
+#ifndef AL_SOFT_source_offsets
+#define AL_SOFT_source_offsets 1
+typedef void (AL_APIENTRY*LPALGETSOURCESOFFSETSSOFT)(ALsizei n, const ALuint *sources, ALint64SOFT *offsets, ALint64SOFT *clocktimes, ALenum *states);
+#ifdef AL_ALEXT_PROTOTYPES
+AL_API void AL_APIENTRY alGetSourcesOffsetsSOFT(ALsizei n, const ALuint *sources, ALint64SOFT *offsets, ALint64SOFT *clocktimes, ALenum *states);
+#endif
+#endif
+
 
 typedef ALint64SOFT ALint64;
 typedef ALuint64SOFT ALuint64;
@@ -554,6 +643,66 @@ typedef struct HrtfParams {
 } HrtfParams;
 
 
+/* Stages of a mixer invocation that are timed separately. When contexts are
+ * mixed in parallel, only those mixed on the device's own mixing thread are
+ * broken down by stage, and waiting on the workers counts as voice mixing.
+ */
+enum MixStage {
+    MixStage_Params,
+    MixStage_Voices,
+    MixStage_Effects,
+    MixStage_Decode,
+    MixStage_Output,
+    MixStage_Total,
+
+    MixStage_Count
+};
+
+/* Samples are counted in a histogram with quarter-octave buckets, which is
+ * enough to give a percentile within about 19% of the real value.
+ */
+#define MIXSTAT_SUB_BITS (2)
+#define MIXSTAT_BUCKETS  (64<<MIXSTAT_SUB_BITS)
+
+typedef struct MixStat {
+    ALuint64 Min, Max, Sum;
+    ALuint Hist[MIXSTAT_BUCKETS];
+} MixStat;
+
+typedef struct MixTiming {
+    /* Incremented before and after each update, like the device's MixCount,
+     * so readers can get a consistent copy.
+     */
+    RefCount Seq;
+
+    ALuint64 Count;
+    /* Times are in nanoseconds. */
+    MixStat Stage[MixStage_Count];
+    /* Time taken relative to the duration of the mixed samples, in millionths
+     * (1000000 = 100% DSP load).
+     */
+    MixStat Load;
+    ALuint64 LastLoad;
+} MixTiming;
+
+/* Adaptive latency control. A thread watches the backend's underruns and late
+ * wakeups, raising the number of updates mixed ahead after glitches and
+ * slowly lowering it again while playback is clean, within the given bounds.
+ */
+typedef struct LatencyControl {
+    ALboolean Enabled;
+    ALuint MinUpdates;
+    ALuint MaxUpdates;
+
+    /* The current number of updates to mix ahead. */
+    ALuint Target;
+
+    althrd_t Thread;
+    almtx_t Mutex;
+    alcnd_t Cond;
+    ALboolean Kill;
+} LatencyControl;
+
 /* Size for temporary storage of buffer data, in ALfloats. Larger values need
  * more memory, while smaller values may need more iterations. The value needs
  * to be a sensible size, however, as it constrains the max stepping value used
@@ -571,6 +720,10 @@ struct ALCdevice_struct
     ALuint Frequency;
     ALuint UpdateSize;
     ALuint NumUpdates;
+    /* The most samples mixed at once. Source and effect parameters are
+     * updated, and gains ramped, once per block of this many samples.
+     */
+    ALuint MixQuantum;
     enum DevFmtChannels FmtChans;
     enum DevFmtType     FmtType;
     ALboolean IsHeadphones;
@@ -608,6 +761,11 @@ struct ALCdevice_struct
         ALCenum Status;
         const struct Hrtf *Handle;
 
+        /* The app's last ALC_HRTF_SOFT and ALC_HRTF_ID_SOFT values, reused
+         * when the device is reset without a new attribute list. */
+        ALCint AppRequest;
+        ALCint AppId;
+
         /* HRTF filter state for dry buffer content */
         alignas(16) ALfloat Values[4][HRIR_LENGTH][2];
         alignas(16) ALfloat Coeffs[4][HRIR_LENGTH][2];
@@ -681,6 +839,24 @@ struct ALCdevice_struct
      */
     RefCount MixCount;
 
+    /* Running statistics for how long mixing takes. */
+    MixTiming Timing;
+
+    LatencyControl LatencyCtl;
+
+    /* Threads mixing contexts in parallel with the mixer, if enabled. */
+    struct MixPool *MixPool;
+
+    /* Captured samples copied out for alcCaptureMapSamplesSOFT, when the
+     * backend has no ring buffer that can be mapped directly. Samples from
+     * Pos to Len have yet to be committed, and are read before the backend's.
+     */
+    struct {
+        ALCvoid *Buffer;
+        ALCuint Size;
+        ALCuint Pos, Len;
+    } CaptureStage;
+
     /* Default effect slot */
     struct ALeffectslot *DefaultSlot;
 
@@ -720,7 +896,25 @@ struct ALCdevice_struct
  * compatibility with pthread_setname_np limitations. */
 #define MIXER_THREAD_NAME "alsoft-mixer"
 
+#define MIX_WORKER_THREAD_NAME "alsoft-mixwork"
+#define MAX_MIX_THREADS 64
 #define RECORD_THREAD_NAME "alsoft-record"
+#define EVENT_THREAD_NAME "alsoft-event"
+
+
+enum {
+    EventType_KillThread = 0,
+    EventType_SourceStateChange = 1<<0,
+    EventType_BufferCompleted = 1<<1,
+    /* Always delivered while any other type is enabled. */
+    EventType_EventsLost = 1<<2,
+};
+
+typedef struct AsyncEvent {
+    unsigned int EnumType;
+    ALuint ObjectId;
+    ALuint Param;
+} AsyncEvent;
 
 
 struct ALCcontext_struct {
@@ -755,6 +949,23 @@ struct ALCcontext_struct {
 
     ATOMIC(struct ALeffectslot*) ActiveAuxSlotList;
 
+    /* Events enabled by the app, posted by the mixer to the ring buffer and
+     * delivered to the callback by the event thread. */
+    ATOMIC(ALuint) EnabledEvts;
+    struct ll_ringbuffer *AsyncEvents;
+    /* Events dropped because the ring was full. The mixer reports the pending
+     * count with an EventsLost event once there's room, and the total is
+     * logged when the context is freed.
+     */
+    ALuint EventsLostPending;
+    ATOMIC(ALuint) EventsLostTotal;
+    alsem_t EventSem;
+    althrd_t EventThread;
+    ALboolean EventThreadStarted;
+    almtx_t EventCbLock;
+    ALEVENTPROCSOFT EventCb;
+    void *EventParam;
+
     ALCdevice  *Device;
     const ALCchar *ExtensionList;
 
@@ -776,6 +987,7 @@ void ALCdevice_Lock(ALCdevice *device);
 void ALCdevice_Unlock(ALCdevice *device);
 
 void ALCcontext_DeferUpdates(ALCcontext *context, ALenum type);
+void StopEventThrd(ALCcontext *context);
 void ALCcontext_ProcessUpdates(ALCcontext *context);
 
 inline void LockContext(ALCcontext *context)
@@ -814,6 +1026,8 @@ ll_ringbuffer_t *ll_ringbuffer_create(size_t sz, size_t elem_sz);
 void ll_ringbuffer_free(ll_ringbuffer_t *rb);
 void ll_ringbuffer_get_read_vector(const ll_ringbuffer_t *rb, ll_ringbuffer_data_t *vec);
 void ll_ringbuffer_get_write_vector(const ll_ringbuffer_t *rb, ll_ringbuffer_data_t *vec);
+size_t ll_ringbuffer_read_claim(ll_ringbuffer_t *rb, size_t cnt, ll_ringbuffer_data_t *vec);
+size_t ll_ringbuffer_write_claim(ll_ringbuffer_t *rb, size_t cnt, ll_ringbuffer_data_t *vec);
 size_t ll_ringbuffer_read(ll_ringbuffer_t *rb, char *dest, size_t cnt);
 size_t ll_ringbuffer_peek(ll_ringbuffer_t *rb, char *dest, size_t cnt);
 void ll_ringbuffer_read_advance(ll_ringbuffer_t *rb, size_t cnt);
@@ -837,6 +1051,10 @@ int ConfigValueBool(const char *devName, const char *blockName, const char *keyN
 
 void SetRTPriority(void);
 
+/* Returns a time in nanoseconds from a monotonic clock, if available, for
+ * measuring intervals. */
+ALuint64 GetMonotonicTime(void);
+
 void SetDefaultChannelOrder(ALCdevice *device);
 void SetDefaultWFXChannelOrder(ALCdevice *device);
 
@@ -902,6 +1120,9 @@ extern enum LogLevel LogLevel;
 
 extern ALint RTPrioLevel;
 
+#define MAX_RT_CPUS 256
+extern ALuint RTCpuMask[MAX_RT_CPUS/32];
+
 
 extern ALuint CPUCapFlags;
 enum {
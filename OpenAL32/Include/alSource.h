@@ -5,6 +5,7 @@
 
 #include "alMain.h"
 #include "alu.h"
+#include "alBuffer.h"
 #include "hrtf.h"
 
 #ifdef __cplusplus
@@ -18,9 +19,40 @@ struct ALsourceProps;
 
 typedef struct ALbufferlistitem {
     struct ALbuffer *buffer;
-    struct ALbufferlistitem *volatile next;
+    /* Sample offset of this buffer's start, relative to the first buffer
+     * queued since the queue was last emptied.
+     */
+    ALuint64 SampleStart;
 } ALbufferlistitem;
 
+/* The buffer queue is a ring of items indexed by free-running (wrapping)
+ * indices, with the size kept at a power of 2. Items are only ever appended
+ * at the tail and removed from the head, so the mixer can walk the queue
+ * without locking.
+ */
+typedef struct ALbufferqueue {
+    ALuint Size;
+    ALbufferlistitem Items[];
+} ALbufferqueue;
+
+inline ALbufferlistitem *GetBufferQueueItem(ALbufferqueue *queue, ALuint idx)
+{ return &queue->Items[idx & (queue->Size-1)]; }
+
+
+/* A snapshot of a source's playback position, published under a sequence
+ * lock after each mixer update, and when the play state or offset is changed
+ * with the device locked. The sequence count is odd while being written.
+ */
+typedef struct ALsourcePos {
+    RefCount Seq;
+    /* 32.32 fixed-point sample offset, relative to the start of the first
+     * buffer queued since the queue was last emptied. Readers make it
+     * relative to the current queue head. */
+    ATOMIC(ALuint64) Offset;
+    ATOMIC(ALuint64) ClockTime;
+    ATOMIC(ALenum) State;
+} ALsourcePos;
+
 
 struct ALsourceProps {
     ATOMIC(ALfloat)   Pitch;
@@ -92,6 +124,14 @@ typedef struct ALvoice {
 
     alignas(16) ALfloat PrevSamples[MAX_INPUT_CHANNELS][MAX_PRE_SAMPLES];
 
+    /* Decoder state for compressed buffers, per input channel. */
+    ADPCMState Decoder[MAX_INPUT_CHANNELS];
+
+    /* Sample frames pulled from a callback buffer that haven't been played
+     * yet, and whether the callback has reached the end of its stream. */
+    ALuint CallbackCount;
+    ALboolean CallbackDone;
+
     BsincState SincState;
 
     struct {
@@ -180,8 +220,16 @@ typedef struct ALsource {
 
     /** Source Buffer Queue info. */
     RWLock queue_lock;
-    ATOMIC(ALbufferlistitem*) queue;
-    ATOMIC(ALbufferlistitem*) current_buffer;
+    ATOMIC(ALbufferqueue*) queue;
+    /**
+     * Queue indices. The queue holds the items [queue_head, queue_tail), and
+     * a current_buffer equal to queue_tail means playback ran off the end.
+     * The tail must be loaded before the queue itself, since the storage may
+     * be reallocated when growing before a new tail is published.
+     */
+    ATOMIC(ALuint) queue_head;
+    ATOMIC(ALuint) queue_tail;
+    ATOMIC(ALuint) current_buffer;
 
     /**
      * Source offset in samples, relative to the currently playing buffer, NOT
@@ -193,9 +241,11 @@ typedef struct ALsource {
 
     ATOMIC(ALboolean) looping;
 
+    /** Published playback position. */
+    ALsourcePos PosSnapshot;
+
     /** Current buffer sample info. */
     ALuint NumChannels;
-    ALuint SampleSize;
 
     ATOMIC(struct ALsourceProps*) Update;
     ATOMIC(struct ALsourceProps*) FreeList;
@@ -221,6 +271,7 @@ inline struct ALsource *RemoveSource(ALCcontext *context, ALuint id)
 void UpdateAllSourceProps(ALCcontext *context);
 ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state);
 ALboolean ApplyOffset(ALsource *Source);
+void UpdateSourcePosSnapshot(ALsource *Source, ALuint64 clocktime);
 
 ALvoid ReleaseALSources(ALCcontext *Context);
 
@@ -265,6 +265,12 @@ enum HrtfRequestMode {
 void aluInitMixer(void);
 
 MixerFunc SelectMixer(void);
+/* Returns the resampler chosen by the config, for resampling done outside of
+ * voice mixing.
+ */
+ResamplerFunc SelectConfiguredResampler(void);
+
+ALboolean BsincPrepare(const ALuint increment, BsincState *state);
 
 /* aluInitRenderer
  *
@@ -351,12 +357,57 @@ void ComputeFirstOrderGainsMC(const ChannelConfig *chancoeffs, ALuint numchans,
 void ComputeFirstOrderGainsBF(const BFChannelConfig *chanmap, ALuint numchans, const ALfloat mtx[4], ALfloat ingain, ALfloat gains[MAX_OUTPUT_CHANNELS]);
 
 
-ALvoid MixSource(struct ALvoice *voice, struct ALsource *source, ALCdevice *Device, ALuint SamplesToDo);
+/* Temporary and mixed samples for a mixing worker, which mixes whole contexts
+ * in parallel with the device's mixer and is summed into the device's buffers
+ * afterward. The device's own mixer uses a NULL MixBuffers instead.
+ */
+typedef struct MixBuffers {
+    alignas(16) ALfloat SourceData[BUFFERSIZE];
+    alignas(16) ALfloat ResampledData[BUFFERSIZE];
+    alignas(16) ALfloat FilteredData[BUFFERSIZE];
+
+    /* Input for the device's default effect slot. */
+    alignas(16) ALfloat DefaultWet[MAX_EFFECT_CHANNELS][BUFFERSIZE];
+
+    /* Laid out the same as the device's Dry.Buffer allocation, which also
+     * holds the FOAOut and RealOut channels.
+     */
+    ALfloat (*Buffer)[BUFFERSIZE];
+    ALuint NumChannels;
+
+    /* Set once anything is mixed in for the current block. */
+    ALboolean Used;
+} MixBuffers;
+
+/* Gets where output meant for the given device or default slot buffer goes
+ * when mixing with mix.
+ */
+inline ALfloatBUFFERSIZE *GetMixBuffer(const ALCdevice *device, MixBuffers *mix, ALfloatBUFFERSIZE *buffer)
+{
+    if(!mix) return buffer;
+    if(buffer >= device->Dry.Buffer && buffer < device->Dry.Buffer+mix->NumChannels)
+        return mix->Buffer + (buffer - device->Dry.Buffer);
+    if(device->DefaultSlot && buffer == device->DefaultSlot->WetBuffer)
+        return mix->DefaultWet;
+    return buffer;
+}
+
+ALvoid MixSource(struct ALvoice *voice, struct ALsource *source, ALCdevice *Device, MixBuffers *mix, ALuint SamplesToDo);
 
 ALvoid aluMixData(ALCdevice *device, ALvoid *buffer, ALsizei size);
+/* Mixes and writes either the real output or the dry mixing buffer to
+ * separate float channel buffers, instead of converting and interleaving. */
+ALvoid aluMixDataPlanar(ALCdevice *device, ALfloat *const *buffers, ALboolean drybus, ALsizei size);
 /* Caller must lock the device. */
 ALvoid aluHandleDisconnect(ALCdevice *device);
 
+/* Starts or stops the threads that mix contexts in parallel, which must be
+ * done while the device isn't mixing. Starting also sizes their buffers for
+ * the device's current mixing buffers.
+ */
+void aluStartMixWorkers(ALCdevice *device, ALsizei count);
+void aluStopMixWorkers(ALCdevice *device);
+
 extern ALfloat ConeScale;
 extern ALfloat ZScale;
 
@@ -6,4 +6,10 @@
 
 void ConvertData(ALvoid *dst, enum UserFmtType dstType, const ALvoid *src, enum UserFmtType srcType, ALsizei numchans, ALsizei len, ALsizei align);
 
+void ADPCMState_reset(ADPCMState *state, enum FmtType type, const ALubyte *src,
+                      ALuint chan, ALuint numchans);
+void DecodeADPCMSamples(ALshort *dst, ADPCMState *state, enum FmtType type,
+                        const ALubyte *src, ALuint chan, ALuint numchans,
+                        ALuint samples);
+
 #endif /* SAMPLE_CVT_H */
@@ -80,7 +80,7 @@ AL_API ALvoid AL_APIENTRY alGenAuxiliaryEffectSlots(ALsizei n, ALuint *effectslo
     first = last = NULL;
     for(cur = 0;cur < n;cur++)
     {
-        ALeffectslot *slot = al_calloc(16, sizeof(ALeffectslot));
+        ALeffectslot *slot = al_calloc_tag(AllocTag_Effect, 16, sizeof(ALeffectslot));
         err = AL_OUT_OF_MEMORY;
         if(!slot || (err=InitEffectSlot(slot)) != AL_NO_ERROR)
         {
@@ -639,7 +639,7 @@ void UpdateEffectSlotProps(ALeffectslot *slot)
     /* Get an unused property container, or allocate a new one as needed. */
     props = ATOMIC_LOAD(&slot->FreeList, almemory_order_relaxed);
     if(!props)
-        props = al_calloc(16, sizeof(*props));
+        props = al_calloc_tag(AllocTag_Props, 16, sizeof(*props));
     else
     {
         struct ALeffectslotProps *next;
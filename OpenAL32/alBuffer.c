@@ -50,6 +50,7 @@ static ALboolean IsValidChannels(ALenum channels);
 static ALboolean DecomposeUserFormat(ALenum format, enum UserFmtChannels *chans, enum UserFmtType *type);
 static ALboolean DecomposeFormat(ALenum format, enum FmtChannels *chans, enum FmtType *type);
 static ALboolean SanitizeAlignment(enum UserFmtType type, ALsizei *align);
+static ALenum LoadStaticData(ALbuffer *ALBuf, ALuint freq, ALenum NewFormat, ALsizei frames, enum UserFmtChannels SrcChannels, enum UserFmtType SrcType, ALvoid *data, ALsizei align);
 
 
 AL_API ALvoid AL_APIENTRY alGenBuffers(ALsizei n, ALuint *buffers)
@@ -238,19 +239,8 @@ AL_API ALvoid AL_APIENTRY alBufferData(ALuint buffer, ALenum format, const ALvoi
             if((size%framesize) != 0)
                 SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
 
-            switch(srcchannels)
-            {
-                case UserFmtMono: newformat = AL_FORMAT_MONO16; break;
-                case UserFmtStereo: newformat = AL_FORMAT_STEREO16; break;
-                case UserFmtRear: newformat = AL_FORMAT_REAR16; break;
-                case UserFmtQuad: newformat = AL_FORMAT_QUAD16; break;
-                case UserFmtX51: newformat = AL_FORMAT_51CHN16; break;
-                case UserFmtX61: newformat = AL_FORMAT_61CHN16; break;
-                case UserFmtX71: newformat = AL_FORMAT_71CHN16; break;
-                case UserFmtBFormat2D: newformat = AL_FORMAT_BFORMAT2D_16; break;
-                case UserFmtBFormat3D: newformat = AL_FORMAT_BFORMAT3D_16; break;
-            }
-            err = LoadData(albuf, freq, newformat, size/framesize*align,
+            /* Compressed data is stored as-is, and decoded while mixing. */
+            err = LoadData(albuf, freq, format, size/framesize*align,
                            srcchannels, srctype, data, align, AL_TRUE);
             if(err != AL_NO_ERROR)
                 SET_ERROR_AND_GOTO(context, err, done);
@@ -262,19 +252,8 @@ AL_API ALvoid AL_APIENTRY alBufferData(ALuint buffer, ALenum format, const ALvoi
             if((size%framesize) != 0)
                 SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
 
-            switch(srcchannels)
-            {
-                case UserFmtMono: newformat = AL_FORMAT_MONO16; break;
-                case UserFmtStereo: newformat = AL_FORMAT_STEREO16; break;
-                case UserFmtRear: newformat = AL_FORMAT_REAR16; break;
-                case UserFmtQuad: newformat = AL_FORMAT_QUAD16; break;
-                case UserFmtX51: newformat = AL_FORMAT_51CHN16; break;
-                case UserFmtX61: newformat = AL_FORMAT_61CHN16; break;
-                case UserFmtX71: newformat = AL_FORMAT_71CHN16; break;
-                case UserFmtBFormat2D: newformat = AL_FORMAT_BFORMAT2D_16; break;
-                case UserFmtBFormat3D: newformat = AL_FORMAT_BFORMAT3D_16; break;
-            }
-            err = LoadData(albuf, freq, newformat, size/framesize*align,
+            /* Compressed data is stored as-is, and decoded while mixing. */
+            err = LoadData(albuf, freq, format, size/framesize*align,
                            srcchannels, srctype, data, align, AL_TRUE);
             if(err != AL_NO_ERROR)
                 SET_ERROR_AND_GOTO(context, err, done);
@@ -286,6 +265,156 @@ done:
     ALCcontext_DecRef(context);
 }
 
+/* Like alBufferData, except the buffer references the given memory instead
+ * of copying it. The data must already be in a storable format, and the app
+ * must keep it valid and unchanged until the buffer is deleted or given new
+ * data. Neither can happen while the buffer is attached to a source.
+ */
+AL_API ALvoid AL_APIENTRY alBufferDataStatic(const ALint buffer, ALenum format, ALvoid *data, ALsizei size, ALsizei freq)
+{
+    enum UserFmtChannels srcchannels = UserFmtMono;
+    enum UserFmtType srctype = UserFmtByte;
+    ALCdevice *device;
+    ALCcontext *context;
+    ALbuffer *albuf;
+    ALuint framesize;
+    ALsizei align;
+    ALenum err;
+
+    context = GetContextRef();
+    if(!context) return;
+
+    device = context->Device;
+    LockBuffersRead(device);
+    if((albuf=LookupBuffer(device, buffer)) == NULL)
+        SET_ERROR_AND_GOTO(context, AL_INVALID_NAME, done);
+    if(!(size >= 0 && freq > 0) || (!data && size > 0))
+        SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+    if(DecomposeUserFormat(format, &srcchannels, &srctype) == AL_FALSE)
+        SET_ERROR_AND_GOTO(context, AL_INVALID_ENUM, done);
+
+    align = ATOMIC_LOAD(&albuf->UnpackAlign);
+    if(SanitizeAlignment(srctype, &align) == AL_FALSE)
+        SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+    switch(srctype)
+    {
+        case UserFmtShort:
+        case UserFmtFloat:
+            framesize = FrameSizeFromUserFmt(srcchannels, srctype) * align;
+            if((size%framesize) != 0)
+                SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+            /* The mixer reads the samples directly, so they must be aligned. */
+            if(((size_t)data % BytesFromUserFmt(srctype)) != 0)
+                SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+            break;
+
+        case UserFmtIMA4:
+            framesize  = (align-1)/2 + 4;
+            framesize *= ChannelsFromUserFmt(srcchannels);
+            if((size%framesize) != 0)
+                SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+            break;
+
+        case UserFmtMSADPCM:
+            framesize  = (align-2)/2 + 7;
+            framesize *= ChannelsFromUserFmt(srcchannels);
+            if((size%framesize) != 0)
+                SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+            break;
+
+        default:
+            /* Anything else needs converting, so can't be used in-place. */
+            SET_ERROR_AND_GOTO(context, AL_INVALID_ENUM, done);
+    }
+
+    err = LoadStaticData(albuf, freq, format, size/framesize*align,
+                         srcchannels, srctype, data, align);
+    if(err != AL_NO_ERROR)
+        SET_ERROR_AND_GOTO(context, err, done);
+
+done:
+    UnlockBuffersRead(device);
+    ALCcontext_DecRef(context);
+}
+
+/* Sets the buffer to pull samples from the given callback as it's played,
+ * instead of holding static data. The callback is invoked from the mixer, so
+ * it must not block or call back into AL. It returns the number of bytes
+ * written, and returning fewer than requested ends the stream. A callback
+ * buffer can only be attached to one source at a time.
+ */
+AL_API void AL_APIENTRY alBufferCallbackSOFT(ALuint buffer, ALenum format, ALsizei freq, ALBUFFERCALLBACKTYPESOFT callback, ALvoid *userptr)
+{
+    enum UserFmtChannels srcchannels = UserFmtMono;
+    enum UserFmtType srctype = UserFmtByte;
+    ALCdevice *device;
+    ALCcontext *context;
+    ALbuffer *albuf;
+    ALuint newsize;
+    void *temp;
+
+    context = GetContextRef();
+    if(!context) return;
+
+    device = context->Device;
+    LockBuffersRead(device);
+    if((albuf=LookupBuffer(device, buffer)) == NULL)
+        SET_ERROR_AND_GOTO(context, AL_INVALID_NAME, done);
+    if(!(freq > 0 && callback != NULL))
+        SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+    if(DecomposeUserFormat(format, &srcchannels, &srctype) == AL_FALSE)
+        SET_ERROR_AND_GOTO(context, AL_INVALID_ENUM, done);
+    /* The callback writes directly into the lookahead, so it must use a
+     * storable format. */
+    if(srctype != UserFmtShort && srctype != UserFmtFloat)
+        SET_ERROR_AND_GOTO(context, AL_INVALID_ENUM, done);
+
+    WriteLock(&albuf->lock);
+    if(ReadRef(&albuf->ref) != 0)
+    {
+        WriteUnlock(&albuf->lock);
+        SET_ERROR_AND_GOTO(context, AL_INVALID_OPERATION, done);
+    }
+
+    /* Enough for the most the mixer needs at once. */
+    newsize = BUFFERSIZE * FrameSizeFromUserFmt(srcchannels, srctype);
+    if(newsize != albuf->BytesAlloc || albuf->StaticData)
+    {
+        if(!(temp=al_calloc_tag(AllocTag_Buffer, 16, newsize)))
+        {
+            WriteUnlock(&albuf->lock);
+            SET_ERROR_AND_GOTO(context, AL_OUT_OF_MEMORY, done);
+        }
+        if(!albuf->StaticData)
+            al_free(albuf->data);
+        albuf->data = temp;
+        albuf->BytesAlloc = newsize;
+        albuf->StaticData = AL_FALSE;
+    }
+    albuf->Callback = callback;
+    albuf->UserData = userptr;
+
+    albuf->OriginalChannels = srcchannels;
+    albuf->OriginalType     = srctype;
+    albuf->OriginalSize     = 0;
+    albuf->OriginalAlign    = 1;
+
+    albuf->Frequency = freq;
+    albuf->FmtChannels = (enum FmtChannels)srcchannels;
+    albuf->FmtType = (enum FmtType)srctype;
+    albuf->Format = format;
+
+    /* The stream length is unknown. */
+    albuf->SampleLen = 0;
+    albuf->LoopStart = 0;
+    albuf->LoopEnd = 0;
+    WriteUnlock(&albuf->lock);
+
+done:
+    UnlockBuffersRead(device);
+    ALCcontext_DecRef(context);
+}
+
 AL_API ALvoid AL_APIENTRY alBufferSubDataSOFT(ALuint buffer, ALenum format, const ALvoid *data, ALsizei offset, ALsizei length)
 {
     enum UserFmtChannels srcchannels = UserFmtMono;
@@ -311,6 +440,11 @@ AL_API ALvoid AL_APIENTRY alBufferSubDataSOFT(ALuint buffer, ALenum format, cons
         SET_ERROR_AND_GOTO(context, AL_INVALID_ENUM, done);
 
     WriteLock(&albuf->lock);
+    if(albuf->StaticData)
+    {
+        WriteUnlock(&albuf->lock);
+        SET_ERROR_AND_GOTO(context, AL_INVALID_OPERATION, done);
+    }
     align = ATOMIC_LOAD(&albuf->UnpackAlign);
     if(SanitizeAlignment(srctype, &align) == AL_FALSE)
     {
@@ -354,8 +488,10 @@ AL_API ALvoid AL_APIENTRY alBufferSubDataSOFT(ALuint buffer, ALenum format, cons
 
     channels = ChannelsFromFmt(albuf->FmtChannels);
     bytes = BytesFromFmt(albuf->FmtType);
-    /* offset -> byte offset, length -> sample count */
-    offset = offset/byte_align * channels*bytes;
+    /* offset -> byte offset, length -> sample count (compressed data is
+     * stored as given, so its byte offset is unchanged) */
+    if(albuf->FmtType != FmtIMA4 && albuf->FmtType != FmtMSADPCM)
+        offset = offset/byte_align * channels*bytes;
     length = length/byte_align * albuf->OriginalAlign;
 
     ConvertData((char*)albuf->data+offset, (enum UserFmtType)albuf->FmtType,
@@ -428,6 +564,11 @@ AL_API void AL_APIENTRY alBufferSubSamplesSOFT(ALuint buffer,
         SET_ERROR_AND_GOTO(context, AL_INVALID_ENUM, done);
 
     WriteLock(&albuf->lock);
+    if(albuf->StaticData)
+    {
+        WriteUnlock(&albuf->lock);
+        SET_ERROR_AND_GOTO(context, AL_INVALID_OPERATION, done);
+    }
     align = ATOMIC_LOAD(&albuf->UnpackAlign);
     if(SanitizeAlignment(type, &align) == AL_FALSE)
     {
@@ -450,8 +591,23 @@ AL_API void AL_APIENTRY alBufferSubSamplesSOFT(ALuint buffer,
         SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
     }
 
-    /* offset -> byte offset */
-    offset *= FrameSizeFromFmt(albuf->FmtChannels, albuf->FmtType);
+    if(albuf->FmtType == FmtIMA4 || albuf->FmtType == FmtMSADPCM)
+    {
+        /* Compressed storage can only be accessed in whole blocks. */
+        if((offset%albuf->OriginalAlign) != 0 || (samples%albuf->OriginalAlign) != 0)
+        {
+            WriteUnlock(&albuf->lock);
+            SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+        }
+        align = albuf->OriginalAlign;
+        /* offset -> byte offset */
+        offset = offset/align * BlockSizeFromFmt(albuf->FmtChannels, albuf->FmtType, align);
+    }
+    else
+    {
+        /* offset -> byte offset */
+        offset *= FrameSizeFromFmt(albuf->FmtChannels, albuf->FmtType);
+    }
     ConvertData((char*)albuf->data+offset, (enum UserFmtType)albuf->FmtType,
                 data, type, ChannelsFromFmt(albuf->FmtChannels), samples, align);
     WriteUnlock(&albuf->lock);
@@ -505,8 +661,23 @@ AL_API void AL_APIENTRY alGetBufferSamplesSOFT(ALuint buffer,
         SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
     }
 
-    /* offset -> byte offset */
-    offset *= FrameSizeFromFmt(albuf->FmtChannels, albuf->FmtType);
+    if(albuf->FmtType == FmtIMA4 || albuf->FmtType == FmtMSADPCM)
+    {
+        /* Compressed storage can only be accessed in whole blocks. */
+        if((offset%albuf->OriginalAlign) != 0 || (samples%albuf->OriginalAlign) != 0)
+        {
+            ReadUnlock(&albuf->lock);
+            SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+        }
+        align = albuf->OriginalAlign;
+        /* offset -> byte offset */
+        offset = offset/align * BlockSizeFromFmt(albuf->FmtChannels, albuf->FmtType, align);
+    }
+    else
+    {
+        /* offset -> byte offset */
+        offset *= FrameSizeFromFmt(albuf->FmtChannels, albuf->FmtType);
+    }
     ConvertData(data, type, (char*)albuf->data+offset, (enum UserFmtType)albuf->FmtType,
                 ChannelsFromFmt(albuf->FmtChannels), samples, align);
     ReadUnlock(&albuf->lock);
@@ -851,7 +1022,10 @@ AL_API ALvoid AL_APIENTRY alGetBufferi(ALuint buffer, ALenum param, ALint *value
         break;
 
     case AL_BITS:
-        *value = BytesFromFmt(albuf->FmtType) * 8;
+        if(albuf->FmtType == FmtIMA4 || albuf->FmtType == FmtMSADPCM)
+            *value = 4;
+        else
+            *value = BytesFromFmt(albuf->FmtType) * 8;
         break;
 
     case AL_CHANNELS:
@@ -860,8 +1034,13 @@ AL_API ALvoid AL_APIENTRY alGetBufferi(ALuint buffer, ALenum param, ALint *value
 
     case AL_SIZE:
         ReadLock(&albuf->lock);
-        *value = albuf->SampleLen * FrameSizeFromFmt(albuf->FmtChannels,
-                                                     albuf->FmtType);
+        if(albuf->FmtType == FmtIMA4 || albuf->FmtType == FmtMSADPCM)
+            *value = albuf->SampleLen / albuf->OriginalAlign *
+                     BlockSizeFromFmt(albuf->FmtChannels, albuf->FmtType,
+                                      albuf->OriginalAlign);
+        else
+            *value = albuf->SampleLen * FrameSizeFromFmt(albuf->FmtChannels,
+                                                         albuf->FmtType);
         ReadUnlock(&albuf->lock);
         break;
 
@@ -986,7 +1165,12 @@ ALenum LoadData(ALbuffer *ALBuf, ALuint freq, ALenum NewFormat, ALsizei frames,
     ALuint NewChannels, NewBytes;
     ALuint64 newsize;
 
-    if(DecomposeFormat(NewFormat, &DstChannels, &DstType) == AL_FALSE)
+    if(SrcType == UserFmtIMA4 || SrcType == UserFmtMSADPCM)
+    {
+        DstChannels = (enum FmtChannels)SrcChannels;
+        DstType = (enum FmtType)SrcType;
+    }
+    else if(DecomposeFormat(NewFormat, &DstChannels, &DstType) == AL_FALSE)
         return AL_INVALID_ENUM;
     if((long)SrcChannels != (long)DstChannels)
         return AL_INVALID_ENUM;
@@ -994,9 +1178,17 @@ ALenum LoadData(ALbuffer *ALBuf, ALuint freq, ALenum NewFormat, ALsizei frames,
     NewChannels = ChannelsFromFmt(DstChannels);
     NewBytes = BytesFromFmt(DstType);
 
-    newsize = frames;
-    newsize *= NewBytes;
-    newsize *= NewChannels;
+    if(DstType == FmtIMA4 || DstType == FmtMSADPCM)
+    {
+        newsize = frames / align;
+        newsize *= BlockSizeFromFmt(DstChannels, DstType, align);
+    }
+    else
+    {
+        newsize = frames;
+        newsize *= NewBytes;
+        newsize *= NewChannels;
+    }
     if(newsize > INT_MAX)
         return AL_OUT_OF_MEMORY;
 
@@ -1014,18 +1206,22 @@ ALenum LoadData(ALbuffer *ALBuf, ALuint freq, ALenum NewFormat, ALsizei frames,
      * use AL_SIZE to try to get the buffer's play length.
      */
     newsize = (newsize+15) & ~0xf;
-    if(newsize != ALBuf->BytesAlloc)
+    if(newsize != ALBuf->BytesAlloc || ALBuf->StaticData)
     {
-        void *temp = al_calloc(16, (size_t)newsize);
+        void *temp = al_calloc_tag(AllocTag_Buffer, 16, (size_t)newsize);
         if(!temp && newsize)
         {
             WriteUnlock(&ALBuf->lock);
             return AL_OUT_OF_MEMORY;
         }
-        al_free(ALBuf->data);
+        if(!ALBuf->StaticData)
+            al_free(ALBuf->data);
         ALBuf->data = temp;
         ALBuf->BytesAlloc = (ALuint)newsize;
+        ALBuf->StaticData = AL_FALSE;
     }
+    ALBuf->Callback = NULL;
+    ALBuf->UserData = NULL;
 
     if(data != NULL)
         ConvertData(ALBuf->data, (enum UserFmtType)DstType, data, SrcType, NewChannels, frames, align);
@@ -1073,6 +1269,58 @@ ALenum LoadData(ALbuffer *ALBuf, ALuint freq, ALenum NewFormat, ALsizei frames,
     return AL_NO_ERROR;
 }
 
+/*
+ * LoadStaticData
+ *
+ * Makes the buffer reference the given data in-place, which must be in the
+ * format it will be stored in. The previous storage is released.
+ */
+static ALenum LoadStaticData(ALbuffer *ALBuf, ALuint freq, ALenum NewFormat, ALsizei frames, enum UserFmtChannels SrcChannels, enum UserFmtType SrcType, ALvoid *data, ALsizei align)
+{
+    ALuint64 size;
+
+    if(SrcType == UserFmtIMA4 || SrcType == UserFmtMSADPCM)
+        size = (ALuint64)(frames/align) * BlockSizeFromFmt((enum FmtChannels)SrcChannels,
+                                                            (enum FmtType)SrcType, align);
+    else
+        size = (ALuint64)frames * FrameSizeFromUserFmt(SrcChannels, SrcType);
+    if(size > INT_MAX)
+        return AL_OUT_OF_MEMORY;
+
+    WriteLock(&ALBuf->lock);
+    if(ReadRef(&ALBuf->ref) != 0)
+    {
+        WriteUnlock(&ALBuf->lock);
+        return AL_INVALID_OPERATION;
+    }
+
+    if(!ALBuf->StaticData)
+        al_free(ALBuf->data);
+    ALBuf->data = data;
+    ALBuf->BytesAlloc = 0;
+    ALBuf->StaticData = AL_TRUE;
+    ALBuf->Callback = NULL;
+    ALBuf->UserData = NULL;
+
+    ALBuf->OriginalChannels = SrcChannels;
+    ALBuf->OriginalType     = SrcType;
+    ALBuf->OriginalSize     = (ALsizei)size;
+    ALBuf->OriginalAlign    = (SrcType == UserFmtIMA4 || SrcType == UserFmtMSADPCM) ?
+                              align : 1;
+
+    ALBuf->Frequency = freq;
+    ALBuf->FmtChannels = (enum FmtChannels)SrcChannels;
+    ALBuf->FmtType = (enum FmtType)SrcType;
+    ALBuf->Format = NewFormat;
+
+    ALBuf->SampleLen = frames;
+    ALBuf->LoopStart = 0;
+    ALBuf->LoopEnd = ALBuf->SampleLen;
+
+    WriteUnlock(&ALBuf->lock);
+    return AL_NO_ERROR;
+}
+
 
 ALuint BytesFromUserFmt(enum UserFmtType type)
 {
@@ -1197,9 +1445,24 @@ ALuint BytesFromFmt(enum FmtType type)
     case FmtByte: return sizeof(ALbyte);
     case FmtShort: return sizeof(ALshort);
     case FmtFloat: return sizeof(ALfloat);
+    case FmtIMA4: break; /* not handled here */
+    case FmtMSADPCM: break; /* not handled here */
     }
     return 0;
 }
+ALuint BlockSizeFromFmt(enum FmtChannels chans, enum FmtType type, ALsizei align)
+{
+    switch(type)
+    {
+    case FmtIMA4: return ((align-1)/2 + 4) * ChannelsFromFmt(chans);
+    case FmtMSADPCM: return ((align-2)/2 + 7) * ChannelsFromFmt(chans);
+    case FmtByte:
+    case FmtShort:
+    case FmtFloat:
+        break;
+    }
+    return align * FrameSizeFromFmt(chans, type);
+}
 ALuint ChannelsFromFmt(enum FmtChannels chans)
 {
     switch(chans)
@@ -1361,7 +1624,7 @@ ALbuffer *NewBuffer(ALCcontext *context)
     ALbuffer *buffer;
     ALenum err;
 
-    buffer = al_calloc(16, sizeof(ALbuffer));
+    buffer = al_calloc_tag(AllocTag_Buffer, 16, sizeof(ALbuffer));
     if(!buffer)
         SET_ERROR_AND_RETURN_VALUE(context, AL_OUT_OF_MEMORY, NULL);
     RWLockInit(&buffer->lock);
@@ -1386,7 +1649,8 @@ void DeleteBuffer(ALCdevice *device, ALbuffer *buffer)
     RemoveBuffer(device, buffer->id);
     FreeThunkEntry(buffer->id);
 
-    al_free(buffer->data);
+    if(!buffer->StaticData)
+        al_free(buffer->data);
 
     memset(buffer, 0, sizeof(*buffer));
     al_free(buffer);
@@ -1406,7 +1670,8 @@ ALvoid ReleaseALBuffers(ALCdevice *device)
         ALbuffer *temp = device->BufferMap.values[i];
         device->BufferMap.values[i] = NULL;
 
-        al_free(temp->data);
+        if(!temp->StaticData)
+            al_free(temp->data);
 
         FreeThunkEntry(temp->id);
         memset(temp, 0, sizeof(ALbuffer));
@@ -60,7 +60,7 @@ AL_API ALvoid AL_APIENTRY alGenEffects(ALsizei n, ALuint *effects)
     device = context->Device;
     for(cur = 0;cur < n;cur++)
     {
-        ALeffect *effect = al_calloc(16, sizeof(ALeffect));
+        ALeffect *effect = al_calloc_tag(AllocTag_Effect, 16, sizeof(ALeffect));
         ALenum err = AL_OUT_OF_MEMORY;
         if(!effect || (err=InitEffect(effect)) != AL_NO_ERROR)
         {
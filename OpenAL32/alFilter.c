@@ -59,7 +59,7 @@ AL_API ALvoid AL_APIENTRY alGenFilters(ALsizei n, ALuint *filters)
     device = context->Device;
     for(cur = 0;cur < n;cur++)
     {
-        ALfilter *filter = al_calloc(16, sizeof(ALfilter));
+        ALfilter *filter = al_calloc_tag(AllocTag_Effect, 16, sizeof(ALfilter));
         if(!filter)
         {
             alDeleteFilters(cur, filters);
@@ -462,7 +462,7 @@ void UpdateListenerProps(ALCcontext *context)
     /* Get an unused proprty container, or allocate a new one as needed. */
     props = ATOMIC_LOAD(&listener->FreeList, almemory_order_acquire);
     if(!props)
-        props = al_calloc(16, sizeof(*props));
+        props = al_calloc_tag(AllocTag_Props, 16, sizeof(*props));
     else
     {
         struct ALlistenerProps *next;
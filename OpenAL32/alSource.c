@@ -46,6 +46,7 @@ extern inline void LockSourcesWrite(ALCcontext *context);
 extern inline void UnlockSourcesWrite(ALCcontext *context);
 extern inline struct ALsource *LookupSource(ALCcontext *context, ALuint id);
 extern inline struct ALsource *RemoveSource(ALCcontext *context, ALuint id);
+extern inline ALbufferlistitem *GetBufferQueueItem(ALbufferqueue *queue, ALuint idx);
 
 static void InitSourceParams(ALsource *Source);
 static void DeinitSource(ALsource *source);
@@ -54,6 +55,9 @@ static ALint64 GetSourceSampleOffset(ALsource *Source, ALCdevice *device, ALuint
 static ALdouble GetSourceSecOffset(ALsource *Source, ALCdevice *device, ALuint64 *clocktime);
 static ALdouble GetSourceOffset(ALsource *Source, ALenum name, ALCdevice *device);
 static ALboolean GetSampleOffset(ALsource *Source, ALuint *offset, ALuint *frac);
+static ALbufferqueue *ReserveBufferQueue(ALsource *source, ALCdevice *device, ALuint count);
+static ALbuffer *GetQueueFormatBuffer(ALbufferqueue *queue, ALuint head, ALuint tail);
+static ALuint64 GetQueueItemOffset(ALbufferqueue *queue, ALuint head, ALuint tail, ALuint idx);
 
 typedef enum SourceProp {
     srcPitch = AL_PITCH,
@@ -520,6 +524,7 @@ static ALboolean SetSourcefv(ALsource *Source, ALCcontext *Context, SourceProp p
                     UnlockContext(Context);
                     SET_ERROR_AND_RETURN_VALUE(Context, AL_INVALID_VALUE, AL_FALSE);
                 }
+                UpdateSourcePosSnapshot(Source, GetDeviceClockTime(Context->Device));
                 WriteUnlock(&Source->queue_lock);
                 UnlockContext(Context);
             }
@@ -616,8 +621,9 @@ static ALboolean SetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
     ALbuffer  *buffer = NULL;
     ALfilter  *filter = NULL;
     ALeffectslot *slot = NULL;
-    ALbufferlistitem *oldlist;
-    ALbufferlistitem *newlist;
+    ALbufferlistitem *item;
+    ALbufferqueue *queue;
+    ALuint head, tail;
     ALfloat fvals[6];
 
     switch(prop)
@@ -663,43 +669,68 @@ static ALboolean SetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
                 SET_ERROR_AND_RETURN_VALUE(Context, AL_INVALID_OPERATION, AL_FALSE);
             }
 
+            queue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+            head = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+            tail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
+
+            if(buffer != NULL && buffer->Callback)
+            {
+                /* A callback buffer's lookahead belongs to a single stream, so
+                 * it can't be used by another source at the same time. */
+                ALuint refs = ReadRef(&buffer->ref);
+                ALuint i;
+                for(i = head;i != tail;i++)
+                {
+                    if(GetBufferQueueItem(queue, i)->buffer == buffer)
+                        refs--;
+                }
+                if(refs != 0)
+                {
+                    WriteUnlock(&Source->queue_lock);
+                    UnlockBuffersRead(device);
+                    SET_ERROR_AND_RETURN_VALUE(Context, AL_INVALID_OPERATION, AL_FALSE);
+                }
+            }
+
+            /* Release all elements in the previous queue */
+            for(;head != tail;head++)
+            {
+                ALbuffer *oldbuffer = GetBufferQueueItem(queue, head)->buffer;
+                if(oldbuffer) DecrementRef(&oldbuffer->ref);
+            }
+            ATOMIC_STORE(&Source->queue_head, head, almemory_order_relaxed);
+            ATOMIC_STORE(&Source->current_buffer, tail, almemory_order_relaxed);
+
             if(buffer != NULL)
             {
                 /* Add the selected buffer to a one-item queue */
-                newlist = malloc(sizeof(ALbufferlistitem));
-                newlist->buffer = buffer;
-                newlist->next = NULL;
+                if(!(queue=ReserveBufferQueue(Source, device, 1)))
+                {
+                    Source->SourceType = AL_UNDETERMINED;
+                    WriteUnlock(&Source->queue_lock);
+                    UnlockBuffersRead(device);
+                    SET_ERROR_AND_RETURN_VALUE(Context, AL_OUT_OF_MEMORY, AL_FALSE);
+                }
+                item = GetBufferQueueItem(queue, tail);
+                item->buffer = buffer;
+                item->SampleStart = 0;
                 IncrementRef(&buffer->ref);
+                ATOMIC_STORE(&Source->queue_tail, tail+1);
 
                 /* Source is now Static */
                 Source->SourceType = AL_STATIC;
 
                 ReadLock(&buffer->lock);
                 Source->NumChannels = ChannelsFromFmt(buffer->FmtChannels);
-                Source->SampleSize  = BytesFromFmt(buffer->FmtType);
                 ReadUnlock(&buffer->lock);
             }
             else
             {
                 /* Source is now Undetermined */
                 Source->SourceType = AL_UNDETERMINED;
-                newlist = NULL;
             }
-            oldlist = ATOMIC_EXCHANGE(ALbufferlistitem*, &Source->queue, newlist);
-            ATOMIC_STORE(&Source->current_buffer, newlist);
             WriteUnlock(&Source->queue_lock);
             UnlockBuffersRead(device);
-
-            /* Delete all elements in the previous queue */
-            while(oldlist != NULL)
-            {
-                ALbufferlistitem *temp = oldlist;
-                oldlist = temp->next;
-
-                if(temp->buffer)
-                    DecrementRef(&temp->buffer->ref);
-                free(temp);
-            }
             return AL_TRUE;
 
         case AL_SEC_OFFSET:
@@ -721,6 +752,7 @@ static ALboolean SetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
                     UnlockContext(Context);
                     SET_ERROR_AND_RETURN_VALUE(Context, AL_INVALID_VALUE, AL_FALSE);
                 }
+                UpdateSourcePosSnapshot(Source, GetDeviceClockTime(Context->Device));
                 WriteUnlock(&Source->queue_lock);
                 UnlockContext(Context);
             }
@@ -1010,7 +1042,8 @@ static ALboolean SetSourcei64v(ALsource *Source, ALCcontext *Context, SourceProp
 static ALboolean GetSourcedv(ALsource *Source, ALCcontext *Context, SourceProp prop, ALdouble *values)
 {
     ALCdevice *device = Context->Device;
-    ALbufferlistitem *BufferList;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
     ClockLatency clocktime;
     ALuint64 srcclock;
     ALint ivals[3];
@@ -1082,21 +1115,16 @@ static ALboolean GetSourcedv(ALsource *Source, ALCcontext *Context, SourceProp p
 
         case AL_SEC_LENGTH_SOFT:
             ReadLock(&Source->queue_lock);
-            if(!(BufferList=ATOMIC_LOAD(&Source->queue)))
-                *values = 0;
-            else
+            BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+            QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+            QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
             {
-                ALint length = 0;
-                ALsizei freq = 1;
-                do {
-                    ALbuffer *buffer = BufferList->buffer;
-                    if(buffer && buffer->SampleLen > 0)
-                    {
-                        freq = buffer->Frequency;
-                        length += buffer->SampleLen;
-                    }
-                } while((BufferList=BufferList->next) != NULL);
-                *values = (ALdouble)length / (ALdouble)freq;
+                const ALbuffer *buffer = GetQueueFormatBuffer(BufferQueue, QueueHead, QueueTail);
+                if(!buffer)
+                    *values = 0;
+                else
+                    *values = (ALdouble)GetQueueItemOffset(BufferQueue, QueueHead, QueueTail,
+                                                           QueueTail) / (ALdouble)buffer->Frequency;
             }
             ReadUnlock(&Source->queue_lock);
             return AL_TRUE;
@@ -1188,7 +1216,9 @@ static ALboolean GetSourcedv(ALsource *Source, ALCcontext *Context, SourceProp p
 
 static ALboolean GetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp prop, ALint *values)
 {
-    ALbufferlistitem *BufferList;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
+    ALuint BufferList;
     ALdouble dvals[6];
     ALboolean err;
 
@@ -1204,9 +1234,18 @@ static ALboolean GetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
 
         case AL_BUFFER:
             ReadLock(&Source->queue_lock);
-            BufferList = (Source->SourceType == AL_STATIC) ? ATOMIC_LOAD(&Source->queue) :
-                                                             ATOMIC_LOAD(&Source->current_buffer);
-            *values = (BufferList && BufferList->buffer) ? BufferList->buffer->id : 0;
+            BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+            QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
+            BufferList = (Source->SourceType == AL_STATIC) ?
+                         ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed) :
+                         ATOMIC_LOAD(&Source->current_buffer);
+            if(BufferList == QueueTail)
+                *values = 0;
+            else
+            {
+                const ALbuffer *buffer = GetBufferQueueItem(BufferQueue, BufferList)->buffer;
+                *values = buffer ? buffer->id : 0;
+            }
             ReadUnlock(&Source->queue_lock);
             return AL_TRUE;
 
@@ -1216,13 +1255,14 @@ static ALboolean GetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
 
         case AL_BYTE_LENGTH_SOFT:
             ReadLock(&Source->queue_lock);
-            if(!(BufferList=ATOMIC_LOAD(&Source->queue)))
-                *values = 0;
-            else
+            BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+            QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+            QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
             {
                 ALint length = 0;
-                do {
-                    ALbuffer *buffer = BufferList->buffer;
+                for(BufferList = QueueHead;BufferList != QueueTail;BufferList++)
+                {
+                    ALbuffer *buffer = GetBufferQueueItem(BufferQueue, BufferList)->buffer;
                     if(buffer && buffer->SampleLen > 0)
                     {
                         ALuint byte_align, sample_align;
@@ -1247,7 +1287,7 @@ static ALboolean GetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
 
                         length += buffer->SampleLen / sample_align * byte_align;
                     }
-                } while((BufferList=BufferList->next) != NULL);
+                }
                 *values = length;
             }
             ReadUnlock(&Source->queue_lock);
@@ -1255,32 +1295,19 @@ static ALboolean GetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
 
         case AL_SAMPLE_LENGTH_SOFT:
             ReadLock(&Source->queue_lock);
-            if(!(BufferList=ATOMIC_LOAD(&Source->queue)))
-                *values = 0;
-            else
-            {
-                ALint length = 0;
-                do {
-                    ALbuffer *buffer = BufferList->buffer;
-                    if(buffer) length += buffer->SampleLen;
-                } while((BufferList=BufferList->next) != NULL);
-                *values = length;
-            }
+            BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+            QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+            QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
+            *values = (ALint)mini64(GetQueueItemOffset(BufferQueue, QueueHead, QueueTail, QueueTail),
+                                    INT_MAX);
             ReadUnlock(&Source->queue_lock);
             return AL_TRUE;
 
         case AL_BUFFERS_QUEUED:
             ReadLock(&Source->queue_lock);
-            if(!(BufferList=ATOMIC_LOAD(&Source->queue)))
-                *values = 0;
-            else
-            {
-                ALsizei count = 0;
-                do {
-                    ++count;
-                } while((BufferList=BufferList->next) != NULL);
-                *values = count;
-            }
+            QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+            QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
+            *values = (ALint)(QueueTail - QueueHead);
             ReadUnlock(&Source->queue_lock);
             return AL_TRUE;
 
@@ -1294,15 +1321,12 @@ static ALboolean GetSourceiv(ALsource *Source, ALCcontext *Context, SourceProp p
             }
             else
             {
-                const ALbufferlistitem *BufferList = ATOMIC_LOAD(&Source->queue);
-                const ALbufferlistitem *Current = ATOMIC_LOAD(&Source->current_buffer);
-                ALsizei played = 0;
-                while(BufferList && BufferList != Current)
-                {
-                    played++;
-                    BufferList = BufferList->next;
-                }
-                *values = played;
+                /* Everything between the head and the current buffer has
+                 * been played.
+                 */
+                QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+                BufferList = ATOMIC_LOAD(&Source->current_buffer);
+                *values = (ALint)(BufferList - QueueHead);
             }
             ReadUnlock(&Source->queue_lock);
             return AL_TRUE;
@@ -1534,7 +1558,7 @@ AL_API ALvoid AL_APIENTRY alGenSources(ALsizei n, ALuint *sources)
         SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
     for(cur = 0;cur < n;cur++)
     {
-        ALsource *source = al_calloc(16, sizeof(ALsource));
+        ALsource *source = al_calloc_tag(AllocTag_Source, 16, sizeof(ALsource));
         if(!source)
         {
             alDeleteSources(cur, sources);
@@ -2271,6 +2295,78 @@ AL_API void AL_APIENTRY alGetSourcei64vSOFT(ALuint source, ALenum param, ALint64
     ALCcontext_DecRef(Context);
 }
 
+AL_API void AL_APIENTRY alGetSourcesOffsetsSOFT(ALsizei n, const ALuint *sources, ALint64SOFT *offsets, ALint64SOFT *clocktimes, ALenum *states)
+{
+    ALCcontext *context;
+    ALsource *source;
+    ALsizei i;
+
+    context = GetContextRef();
+    if(!context) return;
+
+    LockSourcesRead(context);
+    if(!(n >= 0))
+        SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+    if(n > 0 && (!sources || !offsets))
+        SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+    for(i = 0;i < n;i++)
+    {
+        if(!LookupSource(context, sources[i]))
+            SET_ERROR_AND_GOTO(context, AL_INVALID_NAME, done);
+    }
+
+    for(i = 0;i < n;i++)
+    {
+        ALCdevice *device = context->Device;
+        ALbufferqueue *BufferQueue;
+        ALuint QueueHead, QueueTail;
+        ALuint64 offset, clocktime, base;
+        ALenum state;
+        ALuint refcount, seq;
+
+        source = LookupSource(context, sources[i]);
+
+        /* The queue lock keeps the head from moving while the offset is made
+         * relative to it. The head only passes buffers the mixer is done
+         * with, so reading between mixes gets a snapshot that's caught up to
+         * it. */
+        ReadLock(&source->queue_lock);
+        BufferQueue = ATOMIC_LOAD(&source->queue, almemory_order_relaxed);
+        QueueHead = ATOMIC_LOAD(&source->queue_head, almemory_order_relaxed);
+        QueueTail = ATOMIC_LOAD(&source->queue_tail, almemory_order_relaxed);
+        do {
+            while(((refcount=ReadRef(&device->MixCount))&1))
+                althrd_yield();
+            /* Read the last published snapshot, retrying if it was being
+             * written at the same time. */
+            do {
+                while(((seq=ReadRef(&source->PosSnapshot.Seq))&1))
+                    althrd_yield();
+                offset = ATOMIC_LOAD(&source->PosSnapshot.Offset);
+                clocktime = ATOMIC_LOAD(&source->PosSnapshot.ClockTime);
+                state = ATOMIC_LOAD(&source->PosSnapshot.State);
+            } while(seq != ReadRef(&source->PosSnapshot.Seq));
+        } while(refcount != ReadRef(&device->MixCount));
+
+        if((state == AL_PLAYING || state == AL_PAUSED) && QueueHead != QueueTail)
+        {
+            base = GetBufferQueueItem(BufferQueue, QueueHead)->SampleStart << 32;
+            offset = (offset > base) ? offset-base : 0;
+        }
+        else
+            offset = 0;
+        ReadUnlock(&source->queue_lock);
+
+        offsets[i] = (ALint64)minu64(offset, U64(0x7fffffffffffffff));
+        if(clocktimes) clocktimes[i] = (ALint64)clocktime;
+        if(states) states[i] = state;
+    }
+
+done:
+    UnlockSourcesRead(context);
+    ALCcontext_DecRef(context);
+}
+
 
 AL_API ALvoid AL_APIENTRY alSourcePlay(ALuint source)
 {
@@ -2302,7 +2398,7 @@ AL_API ALvoid AL_APIENTRY alSourcePlayv(ALsizei n, const ALuint *sources)
 
         newcount = context->MaxVoices << 1;
         if(newcount > 0)
-            temp = al_malloc(16, newcount * sizeof(context->Voices[0]));
+            temp = al_malloc_tag(AllocTag_Voice, 16, newcount * sizeof(context->Voices[0]));
         if(!temp)
         {
             UnlockContext(context);
@@ -2464,8 +2560,9 @@ AL_API ALvoid AL_APIENTRY alSourceQueueBuffers(ALuint src, ALsizei nb, const ALu
     ALCcontext *context;
     ALsource *source;
     ALsizei i;
-    ALbufferlistitem *BufferListStart;
-    ALbufferlistitem *BufferList;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
+    ALuint64 SampleStart;
     ALbuffer *BufferFmt = NULL;
 
     if(nb == 0)
@@ -2490,23 +2587,25 @@ AL_API ALvoid AL_APIENTRY alSourceQueueBuffers(ALuint src, ALsizei nb, const ALu
         SET_ERROR_AND_GOTO(context, AL_INVALID_OPERATION, done);
     }
 
-    /* Check for a valid Buffer, for its frequency and format */
-    BufferList = ATOMIC_LOAD(&source->queue);
-    while(BufferList)
+    /* Make room for the new items at the end of the queue. */
+    if(!(BufferQueue=ReserveBufferQueue(source, device, nb)))
     {
-        if(BufferList->buffer)
-        {
-            BufferFmt = BufferList->buffer;
-            break;
-        }
-        BufferList = BufferList->next;
+        WriteUnlock(&source->queue_lock);
+        SET_ERROR_AND_GOTO(context, AL_OUT_OF_MEMORY, done);
     }
+    QueueHead = ATOMIC_LOAD(&source->queue_head, almemory_order_relaxed);
+    QueueTail = ATOMIC_LOAD(&source->queue_tail, almemory_order_relaxed);
+
+    /* Check for a valid Buffer, for its frequency and format */
+    BufferFmt = GetQueueFormatBuffer(BufferQueue, QueueHead, QueueTail);
+    SampleStart = (QueueHead == QueueTail) ? 0 :
+                  GetBufferQueueItem(BufferQueue, QueueHead)->SampleStart +
+                  GetQueueItemOffset(BufferQueue, QueueHead, QueueTail, QueueTail);
 
     LockBuffersRead(device);
-    BufferListStart = NULL;
-    BufferList = NULL;
     for(i = 0;i < nb;i++)
     {
+        ALbufferlistitem *item = GetBufferQueueItem(BufferQueue, QueueTail+i);
         ALbuffer *buffer = NULL;
         if(buffers[i] && (buffer=LookupBuffer(device, buffers[i])) == NULL)
         {
@@ -2514,18 +2613,11 @@ AL_API ALvoid AL_APIENTRY alSourceQueueBuffers(ALuint src, ALsizei nb, const ALu
             SET_ERROR_AND_GOTO(context, AL_INVALID_NAME, buffer_error);
         }
 
-        if(!BufferListStart)
-        {
-            BufferListStart = malloc(sizeof(ALbufferlistitem));
-            BufferList = BufferListStart;
-        }
-        else
-        {
-            BufferList->next = malloc(sizeof(ALbufferlistitem));
-            BufferList = BufferList->next;
-        }
-        BufferList->buffer = buffer;
-        BufferList->next = NULL;
+        /* The items aren't visible to the mixer until the tail is updated,
+         * so they can be filled in directly.
+         */
+        item->buffer = buffer;
+        item->SampleStart = SampleStart;
         if(!buffer) continue;
 
         /* Hold a read lock on each buffer being queued while checking all
@@ -2533,65 +2625,59 @@ AL_API ALvoid AL_APIENTRY alSourceQueueBuffers(ALuint src, ALsizei nb, const ALu
          * reference on some buffers if this operation ends up failing. */
         ReadLock(&buffer->lock);
         IncrementRef(&buffer->ref);
+        SampleStart += buffer->SampleLen;
 
+        if(buffer->Callback)
+        {
+            /* Callback buffers provide their own stream, and can't be queued. */
+            WriteUnlock(&source->queue_lock);
+            i++;
+            SET_ERROR_AND_GOTO(context, AL_INVALID_OPERATION, buffer_error);
+        }
         if(BufferFmt == NULL)
         {
             BufferFmt = buffer;
 
             source->NumChannels = ChannelsFromFmt(buffer->FmtChannels);
-            source->SampleSize  = BytesFromFmt(buffer->FmtType);
         }
         else if(BufferFmt->Frequency != buffer->Frequency ||
                 BufferFmt->OriginalChannels != buffer->OriginalChannels ||
                 BufferFmt->OriginalType != buffer->OriginalType)
         {
             WriteUnlock(&source->queue_lock);
+            i++;
             SET_ERROR_AND_GOTO(context, AL_INVALID_OPERATION, buffer_error);
 
         buffer_error:
             /* A buffer failed (invalid ID or format), so unlock and release
              * each buffer we had. */
-            while(BufferListStart)
+            while(i-- > 0)
             {
-                ALbufferlistitem *next = BufferListStart->next;
-                if((buffer=BufferListStart->buffer) != NULL)
+                if((buffer=GetBufferQueueItem(BufferQueue, QueueTail+i)->buffer) != NULL)
                 {
                     DecrementRef(&buffer->ref);
                     ReadUnlock(&buffer->lock);
                 }
-                free(BufferListStart);
-                BufferListStart = next;
             }
             UnlockBuffersRead(device);
             goto done;
         }
     }
     /* All buffers good, unlock them now. */
-    BufferList = BufferListStart;
-    while(BufferList != NULL)
+    for(i = 0;i < nb;i++)
     {
-        ALbuffer *buffer = BufferList->buffer;
+        ALbuffer *buffer = GetBufferQueueItem(BufferQueue, QueueTail+i)->buffer;
         if(buffer) ReadUnlock(&buffer->lock);
-        BufferList = BufferList->next;
     }
     UnlockBuffersRead(device);
 
     /* Source is now streaming */
     source->SourceType = AL_STREAMING;
 
-    BufferList = NULL;
-    if(!ATOMIC_COMPARE_EXCHANGE_STRONG(ALbufferlistitem*, &source->queue, &BufferList, BufferListStart))
-    {
-        /* Queue head is not NULL, append to the end of the queue */
-        while(BufferList->next != NULL)
-            BufferList = BufferList->next;
-        BufferList->next = BufferListStart;
-    }
-    /* If the current buffer was at the end (NULL), put it at the start of the newly queued
-     * buffers.
+    /* Publish the new items. If the current buffer was at the end, it will
+     * now refer to the start of the newly queued buffers.
      */
-    BufferList = NULL;
-    ATOMIC_COMPARE_EXCHANGE_STRONG(ALbufferlistitem*, &source->current_buffer, &BufferList, BufferListStart);
+    ATOMIC_STORE(&source->queue_tail, QueueTail+nb);
     WriteUnlock(&source->queue_lock);
 
 done:
@@ -2603,10 +2689,10 @@ AL_API ALvoid AL_APIENTRY alSourceUnqueueBuffers(ALuint src, ALsizei nb, ALuint
 {
     ALCcontext *context;
     ALsource *source;
-    ALbufferlistitem *OldHead;
-    ALbufferlistitem *OldTail;
-    ALbufferlistitem *Current;
-    ALsizei i = 0;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead;
+    ALuint Current;
+    ALsizei i;
 
     if(nb == 0)
         return;
@@ -2629,61 +2715,36 @@ AL_API ALvoid AL_APIENTRY alSourceUnqueueBuffers(ALuint src, ALsizei nb, ALuint
         SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
     }
 
-    /* Find the new buffer queue head */
-    OldTail = ATOMIC_LOAD(&source->queue);
+    /* Only the buffers before the current one have been processed. */
+    BufferQueue = ATOMIC_LOAD(&source->queue, almemory_order_relaxed);
+    QueueHead = ATOMIC_LOAD(&source->queue_head, almemory_order_relaxed);
     Current = ATOMIC_LOAD(&source->current_buffer);
-    if(OldTail != Current)
-    {
-        for(i = 1;i < nb;i++)
-        {
-            ALbufferlistitem *next = OldTail->next;
-            if(!next || next == Current) break;
-            OldTail = next;
-        }
-    }
-    if(i != nb)
+    if((ALuint)nb > Current-QueueHead)
     {
         WriteUnlock(&source->queue_lock);
         /* Trying to unqueue pending buffers. */
         SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
     }
 
-    /* Swap it, and cut the new head from the old. */
-    OldHead = ATOMIC_EXCHANGE(ALbufferlistitem*, &source->queue, OldTail->next);
-    if(OldTail->next)
-    {
-        ALCdevice *device = context->Device;
-        uint count;
-
-        /* Once the active mix (if any) is done, it's safe to cut the old tail
-         * from the new head.
-         */
-        if(((count=ReadRef(&device->MixCount))&1) != 0)
-        {
-            while(count == ReadRef(&device->MixCount))
-                althrd_yield();
-        }
-        OldTail->next = NULL;
-    }
-    WriteUnlock(&source->queue_lock);
-
-    while(OldHead != NULL)
+    for(i = 0;i < nb;i++)
     {
-        ALbufferlistitem *next = OldHead->next;
-        ALbuffer *buffer = OldHead->buffer;
-
+        ALbuffer *buffer = GetBufferQueueItem(BufferQueue, QueueHead+i)->buffer;
         if(!buffer)
-            *(buffers++) = 0;
+            buffers[i] = 0;
         else
         {
-            *(buffers++) = buffer->id;
+            buffers[i] = buffer->id;
             DecrementRef(&buffer->ref);
         }
-
-        free(OldHead);
-        OldHead = next;
     }
 
+    /* The mixer never looks behind the current buffer on a non-looping
+     * source, so the head can simply be moved forward.
+     */
+    QueueHead += nb;
+    ATOMIC_STORE(&source->queue_head, QueueHead);
+    WriteUnlock(&source->queue_lock);
+
 done:
     UnlockSourcesRead(context);
     ALCcontext_DecRef(context);
@@ -2759,20 +2820,28 @@ static void InitSourceParams(ALsource *Source)
     Source->new_state = AL_NONE;
 
     ATOMIC_INIT(&Source->queue, NULL);
-    ATOMIC_INIT(&Source->current_buffer, NULL);
+    ATOMIC_INIT(&Source->queue_head, 0);
+    ATOMIC_INIT(&Source->queue_tail, 0);
+    ATOMIC_INIT(&Source->current_buffer, 0);
 
     ATOMIC_INIT(&Source->position, 0);
     ATOMIC_INIT(&Source->position_fraction, 0);
 
     ATOMIC_INIT(&Source->looping, AL_FALSE);
 
+    InitRef(&Source->PosSnapshot.Seq, 0);
+    ATOMIC_INIT(&Source->PosSnapshot.Offset, 0);
+    ATOMIC_INIT(&Source->PosSnapshot.ClockTime, 0);
+    ATOMIC_INIT(&Source->PosSnapshot.State, AL_INITIAL);
+
     ATOMIC_INIT(&Source->Update, NULL);
     ATOMIC_INIT(&Source->FreeList, NULL);
 }
 
 static void DeinitSource(ALsource *source)
 {
-    ALbufferlistitem *BufferList;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
     struct ALsourceProps *props;
     size_t count = 0;
     size_t i;
@@ -2795,15 +2864,17 @@ static void DeinitSource(ALsource *source)
     if(count > 3)
         WARN("Freed "SZFMT" Source property objects\n", count);
 
-    BufferList = ATOMIC_EXCHANGE(ALbufferlistitem*, &source->queue, NULL);
-    while(BufferList != NULL)
+    BufferQueue = ATOMIC_EXCHANGE(ALbufferqueue*, &source->queue, NULL);
+    QueueHead = ATOMIC_LOAD(&source->queue_head, almemory_order_relaxed);
+    QueueTail = ATOMIC_LOAD(&source->queue_tail, almemory_order_relaxed);
+    for(;QueueHead != QueueTail;QueueHead++)
     {
-        ALbufferlistitem *next = BufferList->next;
-        if(BufferList->buffer != NULL)
-            DecrementRef(&BufferList->buffer->ref);
-        free(BufferList);
-        BufferList = next;
+        ALbuffer *buffer = GetBufferQueueItem(BufferQueue, QueueHead)->buffer;
+        if(buffer != NULL)
+            DecrementRef(&buffer->ref);
     }
+    ATOMIC_STORE(&source->queue_head, QueueHead, almemory_order_relaxed);
+    al_free(BufferQueue);
 
     for(i = 0;i < MAX_SENDS;++i)
     {
@@ -2821,7 +2892,7 @@ static void UpdateSourceProps(ALsource *source, ALuint num_sends)
     /* Get an unused property container, or allocate a new one as needed. */
     props = ATOMIC_LOAD(&source->FreeList, almemory_order_acquire);
     if(!props)
-        props = al_calloc(16, sizeof(*props));
+        props = al_calloc_tag(AllocTag_Props, 16, sizeof(*props));
     else
     {
         struct ALsourceProps *next;
@@ -2933,20 +3004,22 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
     if(state == AL_PLAYING)
     {
         ALCdevice *device = Context->Device;
-        ALbufferlistitem *BufferList;
+        ALbufferqueue *BufferQueue;
+        ALuint BufferList, QueueTail;
         ALboolean discontinuity;
         ALvoice *voice = NULL;
         ALsizei i;
 
         /* Check that there is a queue containing at least one valid, non zero
          * length Buffer. */
-        BufferList = ATOMIC_LOAD(&Source->queue);
-        while(BufferList)
+        BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+        BufferList = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+        QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
+        for(;BufferList != QueueTail;BufferList++)
         {
-            ALbuffer *buffer;
-            if((buffer=BufferList->buffer) != NULL && buffer->SampleLen > 0)
+            ALbuffer *buffer = GetBufferQueueItem(BufferQueue, BufferList)->buffer;
+            if(buffer != NULL && (buffer->SampleLen > 0 || buffer->Callback))
                 break;
-            BufferList = BufferList->next;
         }
 
         if(Source->state != AL_PAUSED)
@@ -2972,7 +3045,7 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
 
         /* If there's nothing to play, or device is disconnected, go right to
          * stopped */
-        if(!BufferList || !device->Connected)
+        if(BufferList == QueueTail || !device->Connected)
             goto do_stop;
 
         /* Make sure this source isn't already active, while looking for an
@@ -3003,6 +3076,8 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
         {
             /* Clear previous samples if playback is discontinuous. */
             memset(voice->PrevSamples, 0, sizeof(voice->PrevSamples));
+            voice->CallbackCount = 0;
+            voice->CallbackDone = AL_FALSE;
 
             /* Clear the stepping value so the mixer knows not to mix this
              * until the update gets applied.
@@ -3021,6 +3096,7 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
                 voice->Chan[i].Direct.Hrtf.State.Values[j][0] = 0.0f;
                 voice->Chan[i].Direct.Hrtf.State.Values[j][1] = 0.0f;
             }
+            voice->Decoder[i].Buffer = NULL;
         }
 
         UpdateSourceProps(Source, device->NumAuxSends);
@@ -3036,7 +3112,8 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
         if(Source->state != AL_INITIAL)
         {
             Source->state = AL_STOPPED;
-            ATOMIC_STORE(&Source->current_buffer, NULL);
+            ATOMIC_STORE(&Source->current_buffer,
+                         ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed));
         }
         Source->OffsetType = AL_NONE;
         Source->Offset = 0.0;
@@ -3046,7 +3123,8 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
         if(Source->state != AL_INITIAL)
         {
             Source->state = AL_INITIAL;
-            ATOMIC_STORE(&Source->current_buffer, ATOMIC_LOAD(&Source->queue),
+            ATOMIC_STORE(&Source->current_buffer,
+                         ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed),
                          almemory_order_relaxed);
             ATOMIC_STORE(&Source->position, 0, almemory_order_relaxed);
             ATOMIC_STORE(&Source->position_fraction, 0);
@@ -3054,6 +3132,7 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
         Source->OffsetType = AL_NONE;
         Source->Offset = 0.0;
     }
+    UpdateSourcePosSnapshot(Source, GetDeviceClockTime(Context->Device));
     WriteUnlock(&Source->queue_lock);
 }
 
@@ -3065,8 +3144,9 @@ ALvoid SetSourceState(ALsource *Source, ALCcontext *Context, ALenum state)
  */
 static ALint64 GetSourceSampleOffset(ALsource *Source, ALCdevice *device, ALuint64 *clocktime)
 {
-    const ALbufferlistitem *BufferList;
-    const ALbufferlistitem *Current;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
+    ALuint Current;
     ALuint64 readPos;
     ALuint refcount;
 
@@ -3082,24 +3162,21 @@ static ALint64 GetSourceSampleOffset(ALsource *Source, ALCdevice *device, ALuint
         return 0;
     }
 
+    BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+    QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+    QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
     do {
         while(((refcount=ReadRef(&device->MixCount))&1))
             althrd_yield();
         *clocktime = GetDeviceClockTime(device);
 
-        BufferList = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
         Current = ATOMIC_LOAD(&Source->current_buffer, almemory_order_relaxed);
 
         readPos  = (ALuint64)ATOMIC_LOAD(&Source->position, almemory_order_relaxed) << 32;
         readPos |= (ALuint64)ATOMIC_LOAD(&Source->position_fraction, almemory_order_relaxed) <<
                    (32-FRACTIONBITS);
     } while(refcount != ReadRef(&device->MixCount));
-    while(BufferList && BufferList != Current)
-    {
-        if(BufferList->buffer)
-            readPos += (ALuint64)BufferList->buffer->SampleLen << 32;
-        BufferList = BufferList->next;
-    }
+    readPos += GetQueueItemOffset(BufferQueue, QueueHead, QueueTail, Current) << 32;
 
     ReadUnlock(&Source->queue_lock);
     return (ALint64)minu64(readPos, U64(0x7fffffffffffffff));
@@ -3112,9 +3189,10 @@ static ALint64 GetSourceSampleOffset(ALsource *Source, ALCdevice *device, ALuint
  */
 static ALdouble GetSourceSecOffset(ALsource *Source, ALCdevice *device, ALuint64 *clocktime)
 {
-    const ALbufferlistitem *BufferList;
-    const ALbufferlistitem *Current;
-    const ALbuffer *Buffer = NULL;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
+    ALuint Current;
+    const ALbuffer *Buffer;
     ALuint64 readPos;
     ALuint refcount;
 
@@ -3130,33 +3208,22 @@ static ALdouble GetSourceSecOffset(ALsource *Source, ALCdevice *device, ALuint64
         return 0.0;
     }
 
+    BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+    QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+    QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
     do {
         while(((refcount=ReadRef(&device->MixCount))&1))
             althrd_yield();
         *clocktime = GetDeviceClockTime(device);
 
-        BufferList = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
         Current = ATOMIC_LOAD(&Source->current_buffer, almemory_order_relaxed);
 
         readPos  = (ALuint64)ATOMIC_LOAD(&Source->position, almemory_order_relaxed)<<FRACTIONBITS;
         readPos |= (ALuint64)ATOMIC_LOAD(&Source->position_fraction, almemory_order_relaxed);
     } while(refcount != ReadRef(&device->MixCount));
-    while(BufferList && BufferList != Current)
-    {
-        const ALbuffer *buffer = BufferList->buffer;
-        if(buffer != NULL)
-        {
-            if(!Buffer) Buffer = buffer;
-            readPos += (ALuint64)buffer->SampleLen << FRACTIONBITS;
-        }
-        BufferList = BufferList->next;
-    }
+    readPos += GetQueueItemOffset(BufferQueue, QueueHead, QueueTail, Current) << FRACTIONBITS;
 
-    while(BufferList && !Buffer)
-    {
-        Buffer = BufferList->buffer;
-        BufferList = BufferList->next;
-    }
+    Buffer = GetQueueFormatBuffer(BufferQueue, QueueHead, QueueTail);
     assert(Buffer != NULL);
 
     ReadUnlock(&Source->queue_lock);
@@ -3171,12 +3238,12 @@ static ALdouble GetSourceSecOffset(ALsource *Source, ALCdevice *device, ALuint64
  */
 static ALdouble GetSourceOffset(ALsource *Source, ALenum name, ALCdevice *device)
 {
-    const ALbufferlistitem *BufferList;
-    const ALbufferlistitem *Current;
-    const ALbuffer *Buffer = NULL;
-    ALboolean readFin = AL_FALSE;
-    ALuint readPos, readPosFrac;
-    ALuint totalBufferLen;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
+    ALuint Current;
+    const ALbuffer *Buffer;
+    ALuint64 readPos, totalBufferLen;
+    ALuint readPosFrac;
     ALdouble offset = 0.0;
     ALboolean looping;
     ALuint refcount;
@@ -3188,11 +3255,12 @@ static ALdouble GetSourceOffset(ALsource *Source, ALenum name, ALCdevice *device
         return 0.0;
     }
 
-    totalBufferLen = 0;
+    BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+    QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+    QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
     do {
         while(((refcount=ReadRef(&device->MixCount))&1))
             althrd_yield();
-        BufferList = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
         Current = ATOMIC_LOAD(&Source->current_buffer, almemory_order_relaxed);
 
         readPos = ATOMIC_LOAD(&Source->position, almemory_order_relaxed);
@@ -3201,21 +3269,13 @@ static ALdouble GetSourceOffset(ALsource *Source, ALenum name, ALCdevice *device
         looping = ATOMIC_LOAD(&Source->looping, almemory_order_relaxed);
     } while(refcount != ReadRef(&device->MixCount));
 
-    while(BufferList != NULL)
-    {
-        const ALbuffer *buffer;
-        readFin = readFin || (BufferList == Current);
-        if((buffer=BufferList->buffer) != NULL)
-        {
-            if(!Buffer) Buffer = buffer;
-            totalBufferLen += buffer->SampleLen;
-            if(!readFin) readPos += buffer->SampleLen;
-        }
-        BufferList = BufferList->next;
-    }
+    Buffer = GetQueueFormatBuffer(BufferQueue, QueueHead, QueueTail);
     assert(Buffer != NULL);
 
-    if(looping)
+    totalBufferLen = GetQueueItemOffset(BufferQueue, QueueHead, QueueTail, QueueTail);
+    readPos += GetQueueItemOffset(BufferQueue, QueueHead, QueueTail, Current);
+
+    if(looping && totalBufferLen > 0)
         readPos %= totalBufferLen;
     else
     {
@@ -3273,39 +3333,85 @@ static ALdouble GetSourceOffset(ALsource *Source, ALenum name, ALCdevice *device
  */
 ALboolean ApplyOffset(ALsource *Source)
 {
-    ALbufferlistitem *BufferList;
-    const ALbuffer *Buffer;
-    ALuint bufferLen, totalBufferLen;
+    ALbufferqueue *BufferQueue;
+    ALuint QueueHead, QueueTail;
+    const ALbufferlistitem *item;
+    ALuint64 base, start;
     ALuint offset=0, frac=0;
+    ALuint lo, count;
 
     /* Get sample frame offset */
     if(!GetSampleOffset(Source, &offset, &frac))
         return AL_FALSE;
 
-    totalBufferLen = 0;
-    BufferList = ATOMIC_LOAD(&Source->queue);
-    while(BufferList && totalBufferLen <= offset)
-    {
-        Buffer = BufferList->buffer;
-        bufferLen = Buffer ? Buffer->SampleLen : 0;
+    BufferQueue = ATOMIC_LOAD(&Source->queue, almemory_order_relaxed);
+    QueueHead = ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed);
+    QueueTail = ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed);
+    if(QueueHead == QueueTail)
+        return AL_FALSE;
 
-        if(bufferLen > offset-totalBufferLen)
+    /* Binary search for the last item starting at or before the offset. Empty
+     * items share a start with the item after them, so this finds the buffer
+     * containing the offset if there is one.
+     */
+    base = GetBufferQueueItem(BufferQueue, QueueHead)->SampleStart;
+    lo = QueueHead;
+    count = QueueTail - QueueHead;
+    while(count > 1)
+    {
+        ALuint step = count / 2;
+        if(GetBufferQueueItem(BufferQueue, lo+step)->SampleStart - base <= offset)
         {
-            /* Offset is in this buffer */
-            ATOMIC_STORE(&Source->current_buffer, BufferList, almemory_order_relaxed);
-
-            ATOMIC_STORE(&Source->position, offset - totalBufferLen, almemory_order_relaxed);
-            ATOMIC_STORE(&Source->position_fraction, frac);
-            return AL_TRUE;
+            lo += step;
+            count -= step;
         }
+        else
+            count = step;
+    }
+
+    item = GetBufferQueueItem(BufferQueue, lo);
+    start = item->SampleStart - base;
+    if(!item->buffer || start + item->buffer->SampleLen <= offset)
+    {
+        /* Offset is out of range of the queue */
+        return AL_FALSE;
+    }
+
+    /* Offset is in this buffer */
+    ATOMIC_STORE(&Source->current_buffer, lo, almemory_order_relaxed);
 
-        totalBufferLen += bufferLen;
+    ATOMIC_STORE(&Source->position, (ALuint)(offset - start), almemory_order_relaxed);
+    ATOMIC_STORE(&Source->position_fraction, frac);
+    return AL_TRUE;
+}
+
+/* UpdateSourcePosSnapshot
+ *
+ * Publishes the Source's current playback position along with the device
+ * clock time it corresponds to. Must only be called by the mixer or with the
+ * device locked, so there's never more than one writer.
+ */
+void UpdateSourcePosSnapshot(ALsource *Source, ALuint64 clocktime)
+{
+    ALuint Current = ATOMIC_LOAD(&Source->current_buffer, almemory_order_relaxed);
+    ALuint QueueTail = ATOMIC_LOAD(&Source->queue_tail);
+    ALenum state = Source->state;
+    ALuint64 offset = 0;
 
-        BufferList = BufferList->next;
+    if((state == AL_PLAYING || state == AL_PAUSED) && Current != QueueTail)
+    {
+        ALbufferqueue *BufferQueue = ATOMIC_LOAD(&Source->queue);
+        offset  = GetBufferQueueItem(BufferQueue, Current)->SampleStart << 32;
+        offset += (ALuint64)ATOMIC_LOAD(&Source->position, almemory_order_relaxed) << 32;
+        offset |= (ALuint64)ATOMIC_LOAD(&Source->position_fraction, almemory_order_relaxed) <<
+                  (32-FRACTIONBITS);
     }
 
-    /* Offset is out of range of the queue */
-    return AL_FALSE;
+    IncrementRef(&Source->PosSnapshot.Seq);
+    ATOMIC_STORE(&Source->PosSnapshot.Offset, offset);
+    ATOMIC_STORE(&Source->PosSnapshot.ClockTime, clocktime);
+    ATOMIC_STORE(&Source->PosSnapshot.State, state);
+    IncrementRef(&Source->PosSnapshot.Seq);
 }
 
 
@@ -3317,21 +3423,13 @@ ALboolean ApplyOffset(ALsource *Source)
  */
 static ALboolean GetSampleOffset(ALsource *Source, ALuint *offset, ALuint *frac)
 {
-    const ALbuffer *Buffer = NULL;
-    const ALbufferlistitem *BufferList;
+    const ALbuffer *Buffer;
     ALdouble dbloff, dblfrac;
 
     /* Find the first valid Buffer in the Queue */
-    BufferList = ATOMIC_LOAD(&Source->queue);
-    while(BufferList)
-    {
-        if(BufferList->buffer)
-        {
-            Buffer = BufferList->buffer;
-            break;
-        }
-        BufferList = BufferList->next;
-    }
+    Buffer = GetQueueFormatBuffer(ATOMIC_LOAD(&Source->queue, almemory_order_relaxed),
+                                  ATOMIC_LOAD(&Source->queue_head, almemory_order_relaxed),
+                                  ATOMIC_LOAD(&Source->queue_tail, almemory_order_relaxed));
     if(!Buffer)
     {
         Source->OffsetType = AL_NONE;
@@ -3380,6 +3478,90 @@ static ALboolean GetSampleOffset(ALsource *Source, ALuint *offset, ALuint *frac)
 }
 
 
+/* ReserveBufferQueue
+ *
+ * Makes sure the Source's buffer queue has room for the given number of new
+ * items, reallocating it as needed. The queue must be write-locked.
+ */
+static ALbufferqueue *ReserveBufferQueue(ALsource *source, ALCdevice *device, ALuint count)
+{
+    ALbufferqueue *oldqueue, *newqueue;
+    ALuint head, tail, newsize;
+    ALuint refcount;
+
+    oldqueue = ATOMIC_LOAD(&source->queue, almemory_order_relaxed);
+    head = ATOMIC_LOAD(&source->queue_head, almemory_order_relaxed);
+    tail = ATOMIC_LOAD(&source->queue_tail, almemory_order_relaxed);
+    if(oldqueue && oldqueue->Size-(tail-head) >= count)
+        return oldqueue;
+
+    if(count > (INT_MAX>>1) - (tail-head))
+        return NULL;
+    newsize = NextPowerOf2(maxu(tail-head + count, 4));
+    newqueue = al_calloc_tag(AllocTag_Source, 16,
+        sizeof(ALbufferqueue) + newsize*sizeof(ALbufferlistitem)
+    );
+    if(!newqueue) return NULL;
+    newqueue->Size = newsize;
+
+    /* Items keep their indices, so the mixer sees the same queue whichever
+     * storage it loaded.
+     */
+    for(;head != tail;head++)
+        *GetBufferQueueItem(newqueue, head) = *GetBufferQueueItem(oldqueue, head);
+    ATOMIC_STORE(&source->queue, newqueue);
+
+    if(oldqueue)
+    {
+        /* Once the active mix (if any) is done, it's safe to free the old
+         * storage.
+         */
+        if(((refcount=ReadRef(&device->MixCount))&1) != 0)
+        {
+            while(refcount == ReadRef(&device->MixCount))
+                althrd_yield();
+        }
+        al_free(oldqueue);
+    }
+    return newqueue;
+}
+
+/* GetQueueFormatBuffer
+ *
+ * Returns the first valid buffer in the queue, which all other buffers in it
+ * must match the format of.
+ */
+static ALbuffer *GetQueueFormatBuffer(ALbufferqueue *queue, ALuint head, ALuint tail)
+{
+    for(;head != tail;head++)
+    {
+        ALbuffer *buffer = GetBufferQueueItem(queue, head)->buffer;
+        if(buffer) return buffer;
+    }
+    return NULL;
+}
+
+/* GetQueueItemOffset
+ *
+ * Returns the sample offset of the given queue item, relative to the start of
+ * the queue. Passing the tail gives the total length of the queue.
+ */
+static ALuint64 GetQueueItemOffset(ALbufferqueue *queue, ALuint head, ALuint tail, ALuint idx)
+{
+    const ALbufferlistitem *item;
+    ALuint64 base;
+
+    if(head == tail)
+        return 0;
+    base = GetBufferQueueItem(queue, head)->SampleStart;
+    if(idx != tail)
+        return GetBufferQueueItem(queue, idx)->SampleStart - base;
+
+    item = GetBufferQueueItem(queue, tail-1);
+    return item->SampleStart - base + (item->buffer ? item->buffer->SampleLen : 0);
+}
+
+
 /* ReleaseALSources
  *
  * Destroys all sources in the source map.
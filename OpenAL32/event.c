@@ -0,0 +1,185 @@
+/**
+ * OpenAL cross platform audio library
+ * Copyright (C) 1999-2007 by authors.
+ * This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Library General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ *  License along with this library; if not, write to the
+ *  Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * Or go to http://www.gnu.org/copyleft/lgpl.html
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "alMain.h"
+#include "alError.h"
+#include "AL/al.h"
+#include "AL/alext.h"
+
+
+static int EventThread(void *arg)
+{
+    ALCcontext *context = arg;
+    ALboolean quitnow = AL_FALSE;
+
+    althrd_setname(althrd_current(), EVENT_THREAD_NAME);
+
+    while(!quitnow)
+    {
+        AsyncEvent evt;
+
+        if(ll_ringbuffer_read(context->AsyncEvents, (char*)&evt, 1) == 0)
+        {
+            alsem_wait(&context->EventSem);
+            continue;
+        }
+
+        almtx_lock(&context->EventCbLock);
+        do {
+            ALuint enabledevts = ATOMIC_LOAD(&context->EnabledEvts, almemory_order_acquire);
+            char msg[256];
+            ALenum type;
+            int len;
+
+            if(evt.EnumType == EventType_KillThread)
+            {
+                quitnow = AL_TRUE;
+                break;
+            }
+            if(!context->EventCb)
+                continue;
+            if(evt.EnumType == EventType_EventsLost ? !enabledevts :
+               !(enabledevts&evt.EnumType))
+                continue;
+
+            if(evt.EnumType == EventType_EventsLost)
+            {
+                type = AL_EVENT_TYPE_EVENTS_LOST_SOFT;
+                len = snprintf(msg, sizeof(msg), "%u event%s lost, sources need polling",
+                               evt.Param, (evt.Param==1) ? " was" : "s were");
+            }
+            else if(evt.EnumType == EventType_SourceStateChange)
+            {
+                type = AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT;
+                len = snprintf(msg, sizeof(msg), "Source ID %u state changed to %s",
+                               evt.ObjectId, (evt.Param==AL_STOPPED) ? "AL_STOPPED" :
+                               (evt.Param==AL_PLAYING) ? "AL_PLAYING" :
+                               (evt.Param==AL_PAUSED) ? "AL_PAUSED" : "AL_INITIAL");
+            }
+            else
+            {
+                type = AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT;
+                len = snprintf(msg, sizeof(msg), "Source ID %u completed %u buffer%s",
+                               evt.ObjectId, evt.Param, (evt.Param==1) ? "" : "s");
+            }
+            if(len < 0 || len >= (int)sizeof(msg))
+                len = (int)strlen(msg);
+            context->EventCb(type, evt.ObjectId, evt.Param, len, msg, context->EventParam);
+        } while(ll_ringbuffer_read(context->AsyncEvents, (char*)&evt, 1) != 0);
+        almtx_unlock(&context->EventCbLock);
+    }
+    return 0;
+}
+
+/* Starts the event thread, if it isn't already. The context's EventCbLock
+ * must be held. */
+static void StartEventThrd(ALCcontext *context)
+{
+    if(context->EventThreadStarted)
+        return;
+    if(althrd_create(&context->EventThread, EventThread, context) != althrd_success)
+    {
+        ERR("Failed to start event thread\n");
+        return;
+    }
+    context->EventThreadStarted = AL_TRUE;
+}
+
+void StopEventThrd(ALCcontext *context)
+{
+    static const AsyncEvent kill_evt = { EventType_KillThread, 0, 0 };
+    int res;
+
+    if(!context->EventThreadStarted)
+        return;
+
+    /* The thread drains the ring before stopping, so keep trying until the
+     * kill event fits. */
+    while(ll_ringbuffer_write(context->AsyncEvents, (const char*)&kill_evt, 1) == 0)
+    {
+        alsem_post(&context->EventSem);
+        althrd_yield();
+    }
+    alsem_post(&context->EventSem);
+    althrd_join(context->EventThread, &res);
+    context->EventThreadStarted = AL_FALSE;
+}
+
+
+AL_API void AL_APIENTRY alEventControlSOFT(ALsizei count, const ALenum *types, ALboolean enable)
+{
+    ALCcontext *context;
+    ALuint flags = 0;
+    ALsizei i;
+
+    context = GetContextRef();
+    if(!context) return;
+
+    if(count < 0) SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+    if(count == 0) goto done;
+    if(!types) SET_ERROR_AND_GOTO(context, AL_INVALID_VALUE, done);
+
+    for(i = 0;i < count;i++)
+    {
+        if(types[i] == AL_EVENT_TYPE_BUFFER_COMPLETED_SOFT)
+            flags |= EventType_BufferCompleted;
+        else if(types[i] == AL_EVENT_TYPE_SOURCE_STATE_CHANGED_SOFT)
+            flags |= EventType_SourceStateChange;
+        else
+            SET_ERROR_AND_GOTO(context, AL_INVALID_ENUM, done);
+    }
+
+    almtx_lock(&context->EventCbLock);
+    if(enable)
+    {
+        ALuint enabledevts = ATOMIC_LOAD(&context->EnabledEvts, almemory_order_relaxed);
+        ATOMIC_STORE(&context->EnabledEvts, enabledevts|flags, almemory_order_release);
+        StartEventThrd(context);
+    }
+    else
+    {
+        ALuint enabledevts = ATOMIC_LOAD(&context->EnabledEvts, almemory_order_relaxed);
+        ATOMIC_STORE(&context->EnabledEvts, enabledevts&~flags, almemory_order_release);
+    }
+    almtx_unlock(&context->EventCbLock);
+
+done:
+    ALCcontext_DecRef(context);
+}
+
+AL_API void AL_APIENTRY alEventCallbackSOFT(ALEVENTPROCSOFT callback, void *userParam)
+{
+    ALCcontext *context;
+
+    context = GetContextRef();
+    if(!context) return;
+
+    almtx_lock(&context->EventCbLock);
+    context->EventCb = callback;
+    context->EventParam = userParam;
+    almtx_unlock(&context->EventCbLock);
+
+    ALCcontext_DecRef(context);
+}
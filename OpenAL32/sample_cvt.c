@@ -418,6 +418,115 @@ static void DecodeMSADPCMBlock(ALshort *dst, const ALmsadpcm *src, ALint numchan
     }
 }
 
+/* Resets the decoder state to the start of the given IMA4 or MSADPCM block,
+ * for the specified channel. */
+void ADPCMState_reset(ADPCMState *state, enum FmtType type, const ALubyte *src,
+                      ALuint chan, ALuint numchans)
+{
+    ALint val;
+
+    state->Pos = 0;
+    if(type == FmtIMA4)
+    {
+        src += chan*4;
+        val  = src[0] | (src[1]<<8);
+        state->Sample[0] = (val^0x8000) - 32768;
+        val  = src[2] | (src[3]<<8);
+        state->Index = clampi((val^0x8000) - 32768, 0, 88);
+        state->Sample[1] = 0;
+        state->Pred = 0;
+    }
+    else
+    {
+        state->Pred = minu(src[chan], 6);
+        src += numchans;
+        val  = src[chan*2] | (src[chan*2 + 1]<<8);
+        state->Index = (val^0x8000) - 0x8000;
+        src += numchans*2;
+        val  = src[chan*2] | (src[chan*2 + 1]<<8);
+        state->Sample[0] = (val^0x8000) - 0x8000;
+        src += numchans*2;
+        val  = src[chan*2] | (src[chan*2 + 1]<<8);
+        state->Sample[1] = (val^0x8000) - 0x8000;
+    }
+}
+
+/* Decodes the next 'samples' samples of a single channel from an IMA4 or
+ * MSADPCM block, continuing from the state's position. If dst is NULL, the
+ * samples are decoded to update the state but not stored. */
+void DecodeADPCMSamples(ALshort *dst, ADPCMState *state, enum FmtType type,
+                        const ALubyte *src, ALuint chan, ALuint numchans,
+                        ALuint samples)
+{
+    ALuint pos = state->Pos;
+    ALuint end = pos + samples;
+
+    if(type == FmtIMA4)
+    {
+        ALint sample = state->Sample[0];
+        ALint index = state->Index;
+
+        if(pos == 0 && pos < end)
+        {
+            if(dst) *(dst++) = sample;
+            pos++;
+        }
+        for(;pos < end;pos++)
+        {
+            /* Each channel's nibbles come in groups of 8 (4 bytes),
+             * interleaved with the other channels, after the headers. */
+            ALuint k = pos - 1;
+            ALubyte code = src[(numchans + (k>>3)*numchans + chan)*4 + ((k&7)>>1)];
+            int nibble = (k&1) ? (code>>4) : (code&0x0f);
+
+            sample += IMA4Codeword[nibble] * IMAStep_size[index] / 8;
+            sample = clampi(sample, -32768, 32767);
+
+            index += IMA4Index_adjust[nibble];
+            index = clampi(index, 0, 88);
+
+            if(dst) *(dst++) = sample;
+        }
+
+        state->Sample[0] = sample;
+        state->Index = index;
+    }
+    else
+    {
+        const ALint *coeff = MSADPCMAdaptionCoeff[state->Pred];
+        ALint delta = state->Index;
+
+        /* The second sample is stored first. */
+        for(;pos < 2 && pos < end;pos++)
+        {
+            if(dst) *(dst++) = state->Sample[pos^1];
+        }
+        for(;pos < end;pos++)
+        {
+            /* Nibbles are interleaved by channel, first in the upper bits. */
+            ALuint num = (pos-2)*numchans + chan;
+            ALubyte code = src[numchans*7 + (num>>1)];
+            ALint nibble = (num&1) ? (code&0x0f) : (code>>4);
+            ALint pred;
+
+            pred  = (state->Sample[0]*coeff[0] + state->Sample[1]*coeff[1]) / 256;
+            pred += ((nibble^0x08) - 0x08) * delta;
+            pred  = clampi(pred, -32768, 32767);
+
+            state->Sample[1] = state->Sample[0];
+            state->Sample[0] = pred;
+
+            delta = (MSADPCMAdaption[nibble] * delta) / 256;
+            delta = maxi(16, delta);
+
+            if(dst) *(dst++) = pred;
+        }
+
+        state->Index = delta;
+    }
+    state->Pos = pos;
+}
+
 /* NOTE: This encoder is pretty dumb/simplistic. Some kind of pre-processing
  * that tries to find the optimal block predictors would be nice, at least. A
  * multi-pass method that can generate better deltas would be good, too. */
@@ -962,20 +1071,24 @@ DECL_TEMPLATE(ALubyte3)
 
 #undef DECL_TEMPLATE
 
-/* NOTE: We don't store compressed samples internally, so these conversions
- * should never happen. */
-static void Convert_ALima4_ALima4(ALima4* UNUSED(dst), const ALima4* UNUSED(src),
-                                  ALuint UNUSED(numchans), ALuint UNUSED(len),
-                                  ALuint UNUSED(align))
+/* Compressed samples are stored internally as given, so same-type
+ * conversions are straight block copies. */
+static void Convert_ALima4_ALima4(ALima4 *dst, const ALima4 *src, ALuint numchans,
+                                  ALuint len, ALuint align)
 {
-    ERR("Unexpected IMA4-to-IMA4 conversion!\n");
+    ALsizei byte_align = ((align-1)/2 + 4) * numchans;
+
+    assert(align > 0 && (len%align) == 0);
+    memcpy(dst, src, len/align * byte_align);
 }
 
-static void Convert_ALmsadpcm_ALmsadpcm(ALmsadpcm* UNUSED(dst), const ALmsadpcm* UNUSED(src),
-                                        ALuint UNUSED(numchans), ALuint UNUSED(len),
-                                        ALuint UNUSED(align))
+static void Convert_ALmsadpcm_ALmsadpcm(ALmsadpcm *dst, const ALmsadpcm *src,
+                                        ALuint numchans, ALuint len, ALuint align)
 {
-    ERR("Unexpected MSADPCM-to-MSADPCM conversion!\n");
+    ALsizei byte_align = ((align-2)/2 + 7) * numchans;
+
+    assert(align > 0 && (len%align) == 0);
+    memcpy(dst, src, len/align * byte_align);
 }
 
 static void Convert_ALmsadpcm_ALima4(ALmsadpcm* UNUSED(dst), const ALima4* UNUSED(src),
@@ -5,58 +5,206 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
 #endif
 #ifdef HAVE_WINDOWS_H
 #include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
-void *al_malloc(size_t alignment, size_t size)
+#include "atomic.h"
+#include "rtaudit.h"
+
+
+/* Each allocation is preceded by a header recording where the underlying
+ * allocation starts, the size and tag to remove from the counters when it's
+ * freed, and whether it was locked into memory.
+ */
+typedef struct AllocHeader {
+    void *Base;
+    size_t Size;
+    unsigned int Tag;
+    unsigned int Locked;
+} AllocHeader;
+
+static ATOMIC(size_t) AllocLive[AllocTag_Count];
+static ATOMIC(size_t) AllocPeak[AllocTag_Count];
+
+/* Bitmask of tags whose allocations get locked into memory. */
+static ATOMIC(unsigned int) AllocLockMask = ATOMIC_INIT_STATIC(0);
+/* Set once a lock fails, so it's only reported the first time. */
+static ATOMIC(int) AllocLockFailed = ATOMIC_INIT_STATIC(0);
+
+static const char *const AllocTagNames[AllocTag_Count] = {
+    "Misc", "Device", "Context", "Buffer", "Source", "Voice", "Effect", "HRTF",
+    "Ring buffer", "Properties"
+};
+
+
+static size_t get_page_size(void)
+{
+#ifdef HAVE_WINDOWS_H
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long ret = sysconf(_SC_PAGESIZE);
+    return (ret > 0) ? (size_t)ret : 4096;
+#endif
+}
+
+/* Locks the given memory so it can't be paged out, and touches each page so
+ * the mixer doesn't take the page faults when first using it. Returns 0 if
+ * the memory couldn't be locked, which is reported the first time.
+ */
+static int lock_mem(char *ptr, size_t size)
+{
+    size_t pagesize = get_page_size();
+    size_t i;
+    int ok;
+
+#ifdef HAVE_WINDOWS_H
+    ok = (VirtualLock(ptr, size) != 0);
+#else
+    ok = (mlock(ptr, size) == 0);
+#endif
+    if(!ok && !ATOMIC_EXCHANGE(int, &AllocLockFailed, 1, almemory_order_relaxed))
+        fprintf(stderr, "AL lib: (WW) lock_mem: Failed to lock %lu bytes of memory, further "
+                        "failures won't be reported\n", (unsigned long)size);
+
+    /* Writing is needed, since reading may just map a shared zero page. This
+     * is before the caller gets the memory, so clobbering it is fine.
+     */
+    for(i = 0;i < size;i += pagesize)
+        ((volatile char*)ptr)[i] = 0;
+    if(size > 0)
+        ((volatile char*)ptr)[size-1] = 0;
+    return ok;
+}
+
+/* Unlocks the pages that are wholly within the given memory. Pages at either
+ * end may be shared with other locked allocations, so they stay locked.
+ */
+static void unlock_mem(char *ptr, size_t size)
+{
+    size_t pagesize = get_page_size();
+    size_t start = ((size_t)ptr + pagesize-1) & ~(pagesize-1);
+    size_t end = ((size_t)ptr + size) & ~(pagesize-1);
+
+    if(end <= start)
+        return;
+#ifdef HAVE_WINDOWS_H
+    VirtualUnlock((void*)start, end-start);
+#else
+    munlock((void*)start, end-start);
+#endif
+}
+
+void *al_malloc_tag(enum AllocTag tag, size_t alignment, size_t size)
 {
+    AllocHeader *hdr;
+    size_t offset, live, peak;
+    char *base, *ret;
+    int locked;
+
+    RT_AUDIT_CHECK("al_malloc");
+
+    if(alignment < sizeof(void*))
+        alignment = sizeof(void*);
+    offset = (sizeof(AllocHeader)+(alignment-1)) & ~(alignment-1);
+
 #if defined(HAVE_ALIGNED_ALLOC)
-    size = (size+(alignment-1))&~(alignment-1);
-    return aligned_alloc(alignment, size);
+    base = aligned_alloc(alignment, (offset+size+(alignment-1)) & ~(alignment-1));
 #elif defined(HAVE_POSIX_MEMALIGN)
-    void *ret;
-    if(posix_memalign(&ret, alignment, size) == 0)
-        return ret;
-    return NULL;
+    if(posix_memalign((void**)&base, alignment, offset+size) != 0)
+        base = NULL;
 #elif defined(HAVE__ALIGNED_MALLOC)
-    return _aligned_malloc(size, alignment);
+    base = _aligned_malloc(offset+size, alignment);
 #else
-    char *ret = malloc(size+alignment);
-    if(ret != NULL)
+    /* Over-allocate so the returned pointer can be aligned by hand. */
+    base = malloc(offset+size+(alignment-1));
+#endif
+    if(base == NULL)
+        return NULL;
+
+    /* Locking touches the memory, so it's done before writing the header. */
+    locked = 0;
+    if((ATOMIC_LOAD(&AllocLockMask, almemory_order_relaxed)&(1u<<tag)))
+        locked = lock_mem(base, offset+size);
+
+    ret = (char*)(((size_t)base + sizeof(AllocHeader) + (alignment-1)) & ~(alignment-1));
+    hdr = (AllocHeader*)ret - 1;
+    hdr->Base = base;
+    hdr->Size = size;
+    hdr->Tag = tag;
+    hdr->Locked = locked;
+
+    live = ATOMIC_ADD(size_t, &AllocLive[tag], size, almemory_order_relaxed) + size;
+    peak = ATOMIC_LOAD(&AllocPeak[tag], almemory_order_relaxed);
+    while(live > peak && !ATOMIC_COMPARE_EXCHANGE_WEAK(size_t, &AllocPeak[tag], &peak, live,
+                                                       almemory_order_relaxed,
+                                                       almemory_order_relaxed))
     {
-        *(ret++) = 0x00;
-        while(((ptrdiff_t)ret&(alignment-1)) != 0)
-            *(ret++) = 0x55;
+        /* peak is updated with the current value on failure. */
     }
+
     return ret;
-#endif
 }
 
-void *al_calloc(size_t alignment, size_t size)
+void *al_calloc_tag(enum AllocTag tag, size_t alignment, size_t size)
 {
-    void *ret = al_malloc(alignment, size);
+    void *ret = al_malloc_tag(tag, alignment, size);
     if(ret) memset(ret, 0, size);
     return ret;
 }
 
+void *al_malloc(size_t alignment, size_t size)
+{
+    return al_malloc_tag(AllocTag_Misc, alignment, size);
+}
+
+void *al_calloc(size_t alignment, size_t size)
+{
+    return al_calloc_tag(AllocTag_Misc, alignment, size);
+}
+
 void al_free(void *ptr)
 {
-#if defined(HAVE_ALIGNED_ALLOC) || defined(HAVE_POSIX_MEMALIGN)
-    free(ptr);
-#elif defined(HAVE__ALIGNED_MALLOC)
-    _aligned_free(ptr);
+    AllocHeader *hdr;
+
+    if(ptr == NULL)
+        return;
+    RT_AUDIT_CHECK("al_free");
+
+    hdr = (AllocHeader*)ptr - 1;
+    ATOMIC_SUB(size_t, &AllocLive[hdr->Tag], hdr->Size, almemory_order_relaxed);
+    if(hdr->Locked)
+        unlock_mem(hdr->Base, (size_t)((char*)ptr - (char*)hdr->Base) + hdr->Size);
+
+#if !defined(HAVE_ALIGNED_ALLOC) && !defined(HAVE_POSIX_MEMALIGN) && defined(HAVE__ALIGNED_MALLOC)
+    _aligned_free(hdr->Base);
 #else
-    if(ptr != NULL)
-    {
-        char *finder = ptr;
-        do {
-            --finder;
-        } while(*finder == 0x55);
-        free(finder);
-    }
+    free(hdr->Base);
 #endif
 }
+
+
+void al_get_alloc_stats(enum AllocTag tag, size_t *live, size_t *peak)
+{
+    *live = ATOMIC_LOAD(&AllocLive[tag], almemory_order_relaxed);
+    *peak = ATOMIC_LOAD(&AllocPeak[tag], almemory_order_relaxed);
+}
+
+void al_set_locked_tags(unsigned int tagmask)
+{
+    ATOMIC_STORE(&AllocLockMask, tagmask, almemory_order_relaxed);
+}
+
+const char *al_get_alloc_tag_name(enum AllocTag tag)
+{
+    return AllocTagNames[tag];
+}
@@ -0,0 +1,119 @@
+
+#include "config.h"
+
+#include "rtaudit.h"
+
+#ifdef ALSOFT_RT_AUDIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#include <unistd.h>
+#endif
+
+#include "atomic.h"
+#include "threads.h"
+
+
+#define MAX_BACKTRACE_DEPTH 32
+
+/* The calling thread's real-time section depth is kept in its TLS value. */
+static altss_t RTAuditKey;
+static alonce_flag RTAuditOnce = AL_ONCE_FLAG_INIT;
+static ATOMIC(int) RTAuditReady = ATOMIC_INIT_STATIC(0);
+static int RTAuditTrap = 0;
+
+static ATOMIC(unsigned int) RTAuditViolations = ATOMIC_INIT_STATIC(0);
+
+
+static void RTAuditInit(void)
+{
+    const char *str;
+
+    if(altss_create(&RTAuditKey, NULL) != althrd_success)
+    {
+        fprintf(stderr, "AL lib: (EE) RTAuditInit: Failed to create audit key\n");
+        return;
+    }
+
+    str = getenv("ALSOFT_RT_AUDIT");
+    if(str && strcmp(str, "trap") == 0)
+        RTAuditTrap = 1;
+
+    ATOMIC_STORE(&RTAuditReady, 1, almemory_order_release);
+}
+
+void RTAuditEnter(void)
+{
+    intptr_t depth;
+
+    alcall_once(&RTAuditOnce, RTAuditInit);
+    if(!ATOMIC_LOAD(&RTAuditReady, almemory_order_acquire))
+        return;
+
+    depth = (intptr_t)altss_get(RTAuditKey);
+    altss_set(RTAuditKey, (void*)(depth+1));
+}
+
+void RTAuditLeave(void)
+{
+    intptr_t depth;
+
+    if(!ATOMIC_LOAD(&RTAuditReady, almemory_order_acquire))
+        return;
+
+    depth = (intptr_t)altss_get(RTAuditKey);
+    if(depth > 0)
+        altss_set(RTAuditKey, (void*)(depth-1));
+}
+
+void RTAuditCheck(const char *what)
+{
+#ifdef HAVE_EXECINFO_H
+    void *frames[MAX_BACKTRACE_DEPTH];
+    int count;
+#endif
+    unsigned int num;
+    intptr_t depth;
+
+    if(!ATOMIC_LOAD(&RTAuditReady, almemory_order_acquire))
+        return;
+    depth = (intptr_t)altss_get(RTAuditKey);
+    if(depth <= 0)
+        return;
+
+    /* Leave the section while reporting, so anything the report itself
+     * allocates or waits on doesn't recurse back here.
+     */
+    altss_set(RTAuditKey, (void*)0);
+
+    num = ATOMIC_ADD(unsigned int, &RTAuditViolations, 1, almemory_order_relaxed) + 1;
+    fprintf(stderr, "AL lib: (EE) RT audit: %s on a real-time thread (violation %u)\n",
+            what, num);
+#ifdef HAVE_EXECINFO_H
+    count = backtrace(frames, MAX_BACKTRACE_DEPTH);
+    /* Skip this function's own frame. */
+    if(count > 1)
+        backtrace_symbols_fd(frames+1, count-1, STDERR_FILENO);
+#endif
+    fflush(stderr);
+
+    if(RTAuditTrap)
+    {
+#if defined(_WIN32)
+        DebugBreak();
+#elif defined(SIGTRAP)
+        raise(SIGTRAP);
+#else
+        abort();
+#endif
+    }
+
+    altss_set(RTAuditKey, (void*)depth);
+}
+
+#endif /* ALSOFT_RT_AUDIT */
@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 
 #include "uintmap.h"
@@ -178,6 +179,7 @@ int althrd_join(althrd_t thr, int *res)
 int althrd_sleep(const struct timespec *ts, struct timespec* UNUSED(rem))
 {
     DWORD msec;
+    RT_AUDIT_CHECK("althrd_sleep");
 
     if(ts->tv_sec < 0 || ts->tv_sec >= (0x7fffffff / 1000) ||
        ts->tv_nsec < 0 || ts->tv_nsec >= 1000000000)
@@ -210,6 +212,8 @@ void almtx_destroy(almtx_t *mtx)
 
 int almtx_timedlock(almtx_t* UNUSED(mtx), const struct timespec* UNUSED(ts))
 {
+    RT_AUDIT_CHECK("almtx_timedlock wait");
+
     /* Windows CRITICAL_SECTIONs don't seem to have a timedlock method. */
     return althrd_error;
 }
@@ -235,6 +239,8 @@ int alcnd_broadcast(alcnd_t *cond)
 
 int alcnd_wait(alcnd_t *cond, almtx_t *mtx)
 {
+    RT_AUDIT_CHECK("alcnd_wait");
+
     if(SleepConditionVariableCS(cond, mtx, INFINITE) != 0)
         return althrd_success;
     return althrd_error;
@@ -244,6 +250,7 @@ int alcnd_timedwait(alcnd_t *cond, almtx_t *mtx, const struct timespec *time_poi
 {
     struct timespec curtime;
     DWORD sleeptime;
+    RT_AUDIT_CHECK("alcnd_timedwait");
 
     if(altimespec_get(&curtime, AL_TIME_UTC) != AL_TIME_UTC)
         return althrd_error;
@@ -335,6 +342,7 @@ int alcnd_wait(alcnd_t *cond, almtx_t *mtx)
 {
     _int_alcnd_t *icond = cond->Ptr;
     int res;
+    RT_AUDIT_CHECK("alcnd_wait");
 
     IncrementRef(&icond->wait_count);
     LeaveCriticalSection(mtx);
@@ -354,6 +362,7 @@ int alcnd_timedwait(alcnd_t *cond, almtx_t *mtx, const struct timespec *time_poi
     struct timespec curtime;
     DWORD sleeptime;
     int res;
+    RT_AUDIT_CHECK("alcnd_timedwait");
 
     if(altimespec_get(&curtime, AL_TIME_UTC) != AL_TIME_UTC)
         return althrd_error;
@@ -389,6 +398,36 @@ void alcnd_destroy(alcnd_t *cond)
 #endif /* defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0600 */
 
 
+int alsem_init(alsem_t *sem, unsigned int initial)
+{
+    *sem = CreateSemaphore(NULL, initial, INT_MAX, NULL);
+    if(*sem != NULL) return althrd_success;
+    return althrd_error;
+}
+
+void alsem_destroy(alsem_t *sem)
+{
+    CloseHandle(*sem);
+}
+
+int alsem_post(alsem_t *sem)
+{
+    DWORD ret = ReleaseSemaphore(*sem, 1, NULL);
+    if(ret) return althrd_success;
+    return althrd_error;
+}
+
+int alsem_wait(alsem_t *sem)
+{
+    DWORD ret;
+    RT_AUDIT_CHECK("alsem_wait");
+
+    ret = WaitForSingleObject(*sem, INFINITE);
+    if(ret == WAIT_OBJECT_0) return althrd_success;
+    return althrd_error;
+}
+
+
 /* An associative map of uint:void* pairs. The key is the TLS index (given by
  * TlsAlloc), and the value is the altss_dtor_t callback. When a thread exits,
  * we iterate over the TLS indices for their thread-local value and call the
@@ -465,6 +504,15 @@ int altimespec_get(struct timespec *ts, int base)
         ts->tv_nsec = (systime.ulint.QuadPart%10000000) * 100;
         return base;
     }
+    if(base == AL_TIME_MONOTONIC)
+    {
+        LARGE_INTEGER freq, count;
+        if(!QueryPerformanceFrequency(&freq) || !QueryPerformanceCounter(&count))
+            return 0;
+        ts->tv_sec = (time_t)(count.QuadPart / freq.QuadPart);
+        ts->tv_nsec = (long)((count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart);
+        return base;
+    }
 
     return 0;
 }
@@ -627,7 +675,10 @@ void almtx_destroy(almtx_t *mtx)
 int almtx_timedlock(almtx_t *mtx, const struct timespec *ts)
 {
 #ifdef HAVE_PTHREAD_MUTEX_TIMEDLOCK
-    int ret = pthread_mutex_timedlock(mtx, ts);
+    int ret;
+    RT_AUDIT_CHECK("almtx_timedlock wait");
+
+    ret = pthread_mutex_timedlock(mtx, ts);
     switch(ret)
     {
         case 0: return althrd_success;
@@ -661,6 +712,8 @@ int alcnd_broadcast(alcnd_t *cond)
 
 int alcnd_wait(alcnd_t *cond, almtx_t *mtx)
 {
+    RT_AUDIT_CHECK("alcnd_wait");
+
     if(pthread_cond_wait(cond, mtx) == 0)
         return althrd_success;
     return althrd_error;
@@ -668,6 +721,8 @@ int alcnd_wait(alcnd_t *cond, almtx_t *mtx)
 
 int alcnd_timedwait(alcnd_t *cond, almtx_t *mtx, const struct timespec *time_point)
 {
+    RT_AUDIT_CHECK("alcnd_timedwait");
+
     if(pthread_cond_timedwait(cond, mtx, time_point) == 0)
         return althrd_success;
     return althrd_error;
@@ -679,6 +734,69 @@ void alcnd_destroy(alcnd_t *cond)
 }
 
 
+#ifdef __APPLE__
+
+int alsem_init(alsem_t *sem, unsigned int initial)
+{
+    *sem = dispatch_semaphore_create(initial);
+    return *sem ? althrd_success : althrd_error;
+}
+
+void alsem_destroy(alsem_t *sem)
+{
+    dispatch_release(*sem);
+}
+
+int alsem_post(alsem_t *sem)
+{
+    dispatch_semaphore_signal(*sem);
+    return althrd_success;
+}
+
+int alsem_wait(alsem_t *sem)
+{
+    RT_AUDIT_CHECK("alsem_wait");
+
+    dispatch_semaphore_wait(*sem, DISPATCH_TIME_FOREVER);
+    return althrd_success;
+}
+
+#else /* !__APPLE__ */
+
+int alsem_init(alsem_t *sem, unsigned int initial)
+{
+    if(sem_init(sem, 0, initial) == 0)
+        return althrd_success;
+    return althrd_error;
+}
+
+void alsem_destroy(alsem_t *sem)
+{
+    sem_destroy(sem);
+}
+
+int alsem_post(alsem_t *sem)
+{
+    if(sem_post(sem) == 0)
+        return althrd_success;
+    return althrd_error;
+}
+
+int alsem_wait(alsem_t *sem)
+{
+    int ret;
+    RT_AUDIT_CHECK("alsem_wait");
+
+    do {
+        ret = sem_wait(sem);
+    } while(ret != 0 && errno == EINTR);
+    if(ret == 0) return althrd_success;
+    return althrd_error;
+}
+
+#endif /* __APPLE__ */
+
+
 int altss_create(altss_t *tss_id, altss_dtor_t callback)
 {
     if(pthread_key_create(tss_id, callback) != 0)
@@ -711,6 +829,13 @@ int altimespec_get(struct timespec *ts, int base)
         }
 #endif
     }
+#if _POSIX_TIMERS > 0 && defined(CLOCK_MONOTONIC)
+    if(base == AL_TIME_MONOTONIC)
+    {
+        if(clock_gettime(CLOCK_MONOTONIC, ts) == 0)
+            return base;
+    }
+#endif
 
     return 0;
 }
@@ -0,0 +1,222 @@
+
+#include "config.h"
+
+#include "wavfile.h"
+
+#include <string.h>
+#ifdef HAVE_FSEEKO
+#include <sys/types.h>
+#endif
+
+
+static const unsigned char SUBTYPE_PCM[] = {
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa,
+    0x00, 0x38, 0x9b, 0x71
+};
+static const unsigned char SUBTYPE_FLOAT[] = {
+    0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa,
+    0x00, 0x38, 0x9b, 0x71
+};
+
+static const unsigned char SUBTYPE_BFORMAT_PCM[] = {
+    0x01, 0x00, 0x00, 0x00, 0x21, 0x07, 0xd3, 0x11, 0x86, 0x44, 0xc8, 0xc1,
+    0xca, 0x00, 0x00, 0x00
+};
+static const unsigned char SUBTYPE_BFORMAT_FLOAT[] = {
+    0x03, 0x00, 0x00, 0x00, 0x21, 0x07, 0xd3, 0x11, 0x86, 0x44, 0xc8, 0xc1,
+    0xca, 0x00, 0x00, 0x00
+};
+
+/* Sony Wave64 chunk IDs are GUIDs. Each chunk's size is 64-bit and includes
+ * the 24-byte chunk header. */
+static const unsigned char W64_RIFF[] = {
+    'r', 'i', 'f', 'f', 0x2e, 0x91, 0xcf, 0x11, 0xa5, 0xd6, 0x28, 0xdb,
+    0x04, 0xc1, 0x00, 0x00
+};
+static const unsigned char W64_WAVE[] = {
+    'w', 'a', 'v', 'e', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0,
+    0x4f, 0x8e, 0xdb, 0x8a
+};
+static const unsigned char W64_FMT[] = {
+    'f', 'm', 't', ' ', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0,
+    0x4f, 0x8e, 0xdb, 0x8a
+};
+static const unsigned char W64_DATA[] = {
+    'd', 'a', 't', 'a', 0xf3, 0xac, 0xd3, 0x11, 0x8c, 0xd1, 0x00, 0xc0,
+    0x4f, 0x8e, 0xdb, 0x8a
+};
+
+
+/* Plain ftell/fseek use a long, which is only 32-bit on Windows and 32-bit
+ * systems.
+ */
+static long long wav_ftell(FILE *f)
+{
+#ifdef _WIN32
+    return _ftelli64(f);
+#elif defined(HAVE_FSEEKO)
+    return ftello(f);
+#else
+    return ftell(f);
+#endif
+}
+
+static int wav_fseek(FILE *f, long long offset, int whence)
+{
+#ifdef _WIN32
+    return _fseeki64(f, offset, whence);
+#elif defined(HAVE_FSEEKO)
+    return fseeko(f, (off_t)offset, whence);
+#else
+    return fseek(f, (long)offset, whence);
+#endif
+}
+
+
+static void fwrite16le(unsigned int val, FILE *f)
+{
+    unsigned char data[2] = { val&0xff, (val>>8)&0xff };
+    fwrite(data, 1, 2, f);
+}
+
+static void fwrite32le(unsigned int val, FILE *f)
+{
+    unsigned char data[4] = { val&0xff, (val>>8)&0xff, (val>>16)&0xff, (val>>24)&0xff };
+    fwrite(data, 1, 4, f);
+}
+
+static void fwrite64le(unsigned long long val, FILE *f)
+{
+    fwrite32le((unsigned int)(val&0xffffffff), f);
+    fwrite32le((unsigned int)(val>>32), f);
+}
+
+
+long long WriteWaveHeader(FILE *f, enum WaveFileType type, const WaveFormat *fmt)
+{
+    const unsigned char *subtype;
+    unsigned int framesize;
+
+    framesize = fmt->Channels * fmt->Bits / 8;
+    if(fmt->IsFloat)
+        subtype = fmt->IsBFormat ? SUBTYPE_BFORMAT_FLOAT : SUBTYPE_FLOAT;
+    else
+        subtype = fmt->IsBFormat ? SUBTYPE_BFORMAT_PCM : SUBTYPE_PCM;
+
+    if(type == WaveFile_W64)
+    {
+        fwrite(W64_RIFF, 1, 16, f);
+        fwrite64le(~0ull, f); // 'riff' header len; filled in at close
+        fwrite(W64_WAVE, 1, 16, f);
+
+        fwrite(W64_FMT, 1, 16, f);
+        fwrite64le(24+40, f); // 'fmt ' chunk len, including the chunk header
+    }
+    else if(type == WaveFile_RF64)
+    {
+        fprintf(f, "RF64");
+        fwrite32le(0xFFFFFFFF, f); // always -1; the real length is in 'ds64'
+
+        fprintf(f, "WAVE");
+
+        fprintf(f, "ds64");
+        fwrite32le(28, f); // 'ds64' header len
+        fwrite64le(0, f); // 'RF64' header len; filled in at close
+        fwrite64le(0, f); // 'data' header len; filled in at close
+        fwrite64le(0, f); // sample count; only used with a 'fact' chunk
+        fwrite32le(0, f); // table length; no other chunks need 64-bit lengths
+
+        fprintf(f, "fmt ");
+        fwrite32le(40, f); // 'fmt ' header len; 40 bytes for EXTENSIBLE
+    }
+    else
+    {
+        fprintf(f, "RIFF");
+        fwrite32le(0xFFFFFFFF, f); // 'RIFF' header len; filled in at close
+
+        fprintf(f, "WAVE");
+
+        fprintf(f, "fmt ");
+        fwrite32le(40, f); // 'fmt ' header len; 40 bytes for EXTENSIBLE
+    }
+
+    // 16-bit val, format type id (extensible: 0xFFFE)
+    fwrite16le(0xFFFE, f);
+    // 16-bit val, channel count
+    fwrite16le(fmt->Channels, f);
+    // 32-bit val, frequency
+    fwrite32le(fmt->SampleRate, f);
+    // 32-bit val, bytes per second
+    fwrite32le(fmt->SampleRate * framesize, f);
+    // 16-bit val, frame size
+    fwrite16le(framesize, f);
+    // 16-bit val, bits per sample
+    fwrite16le(fmt->Bits, f);
+    // 16-bit val, extra byte count
+    fwrite16le(22, f);
+    // 16-bit val, valid bits per sample
+    fwrite16le(fmt->Bits, f);
+    // 32-bit val, channel mask
+    fwrite32le(fmt->ChannelMask, f);
+    // 16 byte GUID, sub-type format
+    fwrite(subtype, 1, 16, f);
+
+    if(type == WaveFile_W64)
+    {
+        fwrite(W64_DATA, 1, 16, f);
+        fwrite64le(~0ull, f); // 'data' chunk len; filled in at close
+    }
+    else
+    {
+        fprintf(f, "data");
+        // 'data' header len; filled in at close (stays -1 for RF64)
+        fwrite32le(0xFFFFFFFF, f);
+    }
+
+    if(ferror(f))
+        return -1;
+    return wav_ftell(f);
+}
+
+void FinishWaveFile(FILE *f, enum WaveFileType type, long long dataStart)
+{
+    long long size = wav_ftell(f);
+    if(size <= 0 || dataStart < 0)
+        return;
+
+    if(type == WaveFile_W64)
+    {
+        /* Chunks are 8-byte aligned. */
+        unsigned long long dataLen = (unsigned long long)(size - dataStart);
+        if((dataLen&7))
+        {
+            static const unsigned char pad[8];
+            fwrite(pad, 1, 8 - (size_t)(dataLen&7), f);
+            size = wav_ftell(f);
+        }
+        if(wav_fseek(f, dataStart-8, SEEK_SET) == 0)
+            fwrite64le(dataLen+24, f); // 'data' chunk len
+        if(wav_fseek(f, 16, SEEK_SET) == 0)
+            fwrite64le((unsigned long long)size, f); // 'riff' chunk len
+    }
+    else if(type == WaveFile_RF64)
+    {
+        if(wav_fseek(f, 20, SEEK_SET) == 0)
+        {
+            fwrite64le((unsigned long long)(size-8), f); // 'RF64' header len
+            fwrite64le((unsigned long long)(size - dataStart), f); // 'data' header len
+        }
+    }
+    else
+    {
+        /* Lengths that don't fit are left at their maximum; W64 or RF64
+         * should be used for files this large. */
+        unsigned long long dataLen = (unsigned long long)(size - dataStart);
+        unsigned long long riffLen = (unsigned long long)(size - 8);
+        if(wav_fseek(f, dataStart-4, SEEK_SET) == 0)
+            fwrite32le((dataLen > 0xFFFFFFFF) ? 0xFFFFFFFF : (unsigned int)dataLen, f); // 'data' header len
+        if(wav_fseek(f, 4, SEEK_SET) == 0)
+            fwrite32le((riffLen > 0xFFFFFFFF) ? 0xFFFFFFFF : (unsigned int)riffLen, f); // 'WAVE' header len
+    }
+    wav_fseek(f, 0, SEEK_END);
+}
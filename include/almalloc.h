@@ -7,10 +7,46 @@
 extern "C" {
 #endif
 
+/* Allocations are tagged with the subsystem they're for, so memory use can be
+ * accounted per subsystem.
+ */
+enum AllocTag {
+    AllocTag_Misc,
+    /* Devices, their mixing buffers, and output decoders. */
+    AllocTag_Device,
+    AllocTag_Context,
+    AllocTag_Buffer,
+    /* Sources and their buffer queues. */
+    AllocTag_Source,
+    AllocTag_Voice,
+    /* Effect slots, effects, filters, and effect delay lines. */
+    AllocTag_Effect,
+    AllocTag_Hrtf,
+    AllocTag_Ring,
+    /* Listener, source, and effect slot property updates. */
+    AllocTag_Props,
+
+    AllocTag_Count
+};
+
+void *al_malloc_tag(enum AllocTag tag, size_t alignment, size_t size);
+void *al_calloc_tag(enum AllocTag tag, size_t alignment, size_t size);
+
 void *al_malloc(size_t alignment, size_t size);
 void *al_calloc(size_t alignment, size_t size);
 void al_free(void *ptr);
 
+/* Gets the number of bytes currently allocated with the given tag, and the
+ * most that has been allocated at once.
+ */
+void al_get_alloc_stats(enum AllocTag tag, size_t *live, size_t *peak);
+const char *al_get_alloc_tag_name(enum AllocTag tag);
+
+/* Sets which tags (as a bitmask of 1<<tag) have their allocations locked into
+ * memory and prefaulted as they're made.
+ */
+void al_set_locked_tags(unsigned int tagmask);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,39 @@
+#ifndef AL_RTAUDIT_H
+#define AL_RTAUDIT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ALSOFT_RT_AUDIT
+
+/* Marks the calling thread as being in a real-time section (e.g. mixing),
+ * during which it must not allocate, free, or wait. Sections may nest.
+ */
+void RTAuditEnter(void);
+void RTAuditLeave(void);
+
+/* Reports the named operation, along with a backtrace, if the calling thread
+ * is in a real-time section. If the ALSOFT_RT_AUDIT environment variable is
+ * set to "trap", the process is stopped with SIGTRAP (or aborted) instead of
+ * continuing after the report.
+ */
+void RTAuditCheck(const char *what);
+
+#define RT_AUDIT_ENTER() RTAuditEnter()
+#define RT_AUDIT_LEAVE() RTAuditLeave()
+#define RT_AUDIT_CHECK(what) RTAuditCheck((what))
+
+#else
+
+#define RT_AUDIT_ENTER() ((void)0)
+#define RT_AUDIT_LEAVE() ((void)0)
+#define RT_AUDIT_CHECK(what) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AL_RTAUDIT_H */
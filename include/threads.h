@@ -3,6 +3,8 @@
 
 #include <time.h>
 
+#include "rtaudit.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -26,6 +28,8 @@ typedef void (*altss_dtor_t)(void*);
 
 
 #define AL_TIME_UTC 1
+/* A clock unaffected by system time changes, for measuring intervals. */
+#define AL_TIME_MONOTONIC 2
 
 
 #ifdef _WIN32
@@ -53,6 +57,7 @@ typedef CONDITION_VARIABLE alcnd_t;
 #else
 typedef struct { void *Ptr; } alcnd_t;
 #endif
+typedef HANDLE alsem_t;
 typedef DWORD altss_t;
 typedef LONG alonce_flag;
 
@@ -79,6 +84,7 @@ inline void althrd_exit(int res)
 
 inline void althrd_yield(void)
 {
+    RT_AUDIT_CHECK("althrd_yield");
     SwitchToThread();
 }
 
@@ -86,6 +92,12 @@ inline void althrd_yield(void)
 inline int almtx_lock(almtx_t *mtx)
 {
     if(!mtx) return althrd_error;
+#ifdef ALSOFT_RT_AUDIT
+    /* Only report the lock if it has to wait for another thread. */
+    if(TryEnterCriticalSection(mtx))
+        return althrd_success;
+    RT_AUDIT_CHECK("almtx_lock wait");
+#endif
     EnterCriticalSection(mtx);
     return althrd_success;
 }
@@ -123,11 +135,21 @@ inline int altss_set(altss_t tss_id, void *val)
 #include <stdint.h>
 #include <errno.h>
 #include <pthread.h>
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
 
 
 typedef pthread_t althrd_t;
 typedef pthread_mutex_t almtx_t;
 typedef pthread_cond_t alcnd_t;
+#ifdef __APPLE__
+typedef dispatch_semaphore_t alsem_t;
+#else
+typedef sem_t alsem_t;
+#endif
 typedef pthread_key_t altss_t;
 typedef pthread_once_t alonce_flag;
 
@@ -151,12 +173,15 @@ inline void althrd_exit(int res)
 
 inline void althrd_yield(void)
 {
+    RT_AUDIT_CHECK("althrd_yield");
     sched_yield();
 }
 
 inline int althrd_sleep(const struct timespec *ts, struct timespec *rem)
 {
-    int ret = nanosleep(ts, rem);
+    int ret;
+    RT_AUDIT_CHECK("althrd_sleep");
+    ret = nanosleep(ts, rem);
     if(ret != 0)
     {
         ret = ((errno==EINTR) ? -1 : -2);
@@ -168,6 +193,12 @@ inline int althrd_sleep(const struct timespec *ts, struct timespec *rem)
 
 inline int almtx_lock(almtx_t *mtx)
 {
+#ifdef ALSOFT_RT_AUDIT
+    /* Only report the lock if it has to wait for another thread. */
+    if(pthread_mutex_trylock(mtx) == 0)
+        return althrd_success;
+    RT_AUDIT_CHECK("almtx_lock wait");
+#endif
     if(pthread_mutex_lock(mtx) != 0)
         return althrd_error;
     return althrd_success;
@@ -229,6 +260,11 @@ int alcnd_wait(alcnd_t *cond, almtx_t *mtx);
 int alcnd_timedwait(alcnd_t *cond, almtx_t *mtx, const struct timespec *time_point);
 void alcnd_destroy(alcnd_t *cond);
 
+int alsem_init(alsem_t *sem, unsigned int initial);
+void alsem_destroy(alsem_t *sem);
+int alsem_post(alsem_t *sem);
+int alsem_wait(alsem_t *sem);
+
 int altss_create(altss_t *tss_id, altss_dtor_t callback);
 void altss_delete(altss_t tss_id);
 
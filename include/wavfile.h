@@ -0,0 +1,43 @@
+#ifndef AL_WAVFILE_H
+#define AL_WAVFILE_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum WaveFileType {
+    WaveFile_RIFF,
+    WaveFile_W64,
+    /* EBU Tech 3306 RF64, a RIFF variant with 64-bit lengths kept in a
+     * 'ds64' chunk. */
+    WaveFile_RF64
+};
+
+typedef struct WaveFormat {
+    unsigned int Channels;
+    /* 8, 16, or 32. 32-bit samples may be integer or float. */
+    unsigned int Bits;
+    int IsFloat;
+    /* B-Format (.amb) files use their own sub-type GUIDs and no channel
+     * mask. */
+    int IsBFormat;
+    unsigned int ChannelMask;
+    unsigned int SampleRate;
+} WaveFormat;
+
+/* Writes a WAVE_FORMAT_EXTENSIBLE header for the given format, with the
+ * lengths left as placeholders. Returns the file offset the sample data
+ * starts at, or -1 on error. Offsets are 64-bit so files past 2GB work on
+ * systems with a 32-bit long.
+ */
+long long WriteWaveHeader(FILE *f, enum WaveFileType type, const WaveFormat *fmt);
+/* Fills in the header lengths after all sample data has been written. */
+void FinishWaveFile(FILE *f, enum WaveFileType type, long long dataStart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AL_WAVFILE_H */
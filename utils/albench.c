@@ -0,0 +1,623 @@
+/*
+ * OpenAL Mixer Benchmark
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Drives a loopback device through a matrix of mixing scenarios and reports
+ * how long rendering takes, as CSV or JSON. Starting from a baseline scenario,
+ * each axis (voice count, buffer format, pitch, output mode, send count, and
+ * effect type) is swept on its own, for every requested resampler.
+ *
+ * The resampler is a process-wide setting that's read when the library first
+ * initializes, so on POSIX systems each resampler is run in a forked child
+ * process with its own config file. Elsewhere, only the first requested
+ * resampler is run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "AL/al.h"
+#include "AL/alc.h"
+#include "AL/alext.h"
+#include "AL/efx.h"
+
+#include "threads.h"
+
+/* The source directory at build time, used when no data directory is given
+ * on the command line or in the environment.
+ */
+#ifndef ALBENCH_DATA_DIR
+#define ALBENCH_DATA_DIR "."
+#endif
+
+#define BENCH_RATE        48000
+#define BENCH_BLOCK_SIZE  1024
+#define MAX_SENDS         4
+
+
+typedef struct BufferFormat {
+    const char *Name;
+    ALenum Format;
+    int Channels;
+    int BytesPerSample;
+    int IsIMA4;
+} BufferFormat;
+
+static const BufferFormat Formats[] = {
+    { "mono8", AL_FORMAT_MONO8, 1, 1, 0 },
+    { "mono16", AL_FORMAT_MONO16, 1, 2, 0 },
+    { "monof32", AL_FORMAT_MONO_FLOAT32, 1, 4, 0 },
+    { "mono-ima4", AL_FORMAT_MONO_IMA4, 1, 0, 1 },
+    { "stereo16", AL_FORMAT_STEREO16, 2, 2, 0 },
+    { "bformat3d16", AL_FORMAT_BFORMAT3D_16, 4, 2, 0 },
+};
+#define FMT_MONO16 (&Formats[1])
+
+typedef struct Scenario {
+    const char *Output;
+    int Voices;
+    const BufferFormat *Format;
+    float Pitch;
+    int Sends;
+    const char *Effect;
+} Scenario;
+
+static const int VoiceCounts[] = { 1, 16, 64, 256, 1024, 4096 };
+static const float Pitches[] = { 0.5f, 1.0f, 1.37f, 2.0f };
+static const char *const Outputs[] = { "stereo", "quad", "5.1-hq", "hrtf" };
+static const int SendCounts[] = { 0, 1, 2, 4 };
+static const char *const Effects[] = { "none", "reverb", "eaxreverb", "echo", "chorus" };
+
+static const char *const Resamplers[] = { "point", "linear", "sinc4", "sinc8", "bsinc" };
+
+static const Scenario Baseline = { "stereo", 64, FMT_MONO16, 1.37f, 0, "none" };
+
+
+static LPALCLOOPBACKOPENDEVICESOFT palcLoopbackOpenDeviceSOFT;
+static LPALCRENDERSAMPLESSOFT palcRenderSamplesSOFT;
+
+static LPALGENEFFECTS palGenEffects;
+static LPALDELETEEFFECTS palDeleteEffects;
+static LPALEFFECTI palEffecti;
+static LPALGENAUXILIARYEFFECTSLOTS palGenAuxiliaryEffectSlots;
+static LPALDELETEAUXILIARYEFFECTSLOTS palDeleteAuxiliaryEffectSlots;
+static LPALAUXILIARYEFFECTSLOTI palAuxiliaryEffectSloti;
+
+static int OutputJSON = 0;
+static ALCsizei BenchFrames = BENCH_RATE;
+static const char *DataDir = NULL;
+/* Whether a result has been printed yet, for JSON separators. */
+static int PrintedResult = 0;
+
+
+static double GetTimeNanoseconds(void)
+{
+    struct timespec ts;
+    if(altimespec_get(&ts, AL_TIME_MONOTONIC) != AL_TIME_MONOTONIC &&
+       altimespec_get(&ts, AL_TIME_UTC) != AL_TIME_UTC)
+        return 0.0;
+    return (double)ts.tv_sec*1000000000.0 + (double)ts.tv_nsec;
+}
+
+static unsigned int RandomSeed = 22222;
+static float RandomFloat(void)
+{
+    RandomSeed = RandomSeed*96314165 + 907633515;
+    return (float)(RandomSeed>>8) / 16777216.0f;
+}
+
+
+/* Fills a one-second buffer of noise in the given format. */
+static int FillBuffer(ALuint buffer, const BufferFormat *fmt)
+{
+    const ALsizei frames = BENCH_RATE;
+    unsigned char *data;
+    ALsizei size, i;
+
+    if(fmt->IsIMA4)
+    {
+        /* 65 sample frames per 36-byte block: a 4-byte header with the
+         * initial sample and step index, followed by 64 4-bit samples. */
+        ALsizei blocks = frames / 65;
+        size = blocks * 36;
+        data = malloc(size);
+        if(!data) return 0;
+        for(i = 0;i < size;i++)
+        {
+            if(i%36 < 4)
+                data[i] = (i%36 == 2) ? 40 : 0;
+            else
+                data[i] = (unsigned char)(RandomFloat()*256.0f);
+        }
+    }
+    else
+    {
+        ALsizei count = frames * fmt->Channels;
+        size = count * fmt->BytesPerSample;
+        data = malloc(size);
+        if(!data) return 0;
+        for(i = 0;i < count;i++)
+        {
+            float val = RandomFloat()*2.0f - 1.0f;
+            if(fmt->BytesPerSample == 1)
+                data[i] = (unsigned char)(val*127.0f + 128.0f);
+            else if(fmt->BytesPerSample == 2)
+                ((ALshort*)data)[i] = (ALshort)(val*32767.0f);
+            else
+                ((ALfloat*)data)[i] = val;
+        }
+    }
+
+    alBufferData(buffer, fmt->Format, data, size, BENCH_RATE);
+    free(data);
+    return alGetError() == AL_NO_ERROR;
+}
+
+static ALenum GetEffectType(const char *name)
+{
+    if(strcmp(name, "reverb") == 0) return AL_EFFECT_REVERB;
+    if(strcmp(name, "eaxreverb") == 0) return AL_EFFECT_EAXREVERB;
+    if(strcmp(name, "echo") == 0) return AL_EFFECT_ECHO;
+    if(strcmp(name, "chorus") == 0) return AL_EFFECT_CHORUS;
+    return AL_EFFECT_NULL;
+}
+
+
+static void PrintHeader(void)
+{
+    if(OutputJSON)
+        printf("[\n");
+    else
+        printf("resampler,output,voices,format,pitch,sends,effect,frames,"
+               "ns_per_frame,ns_per_voice_frame,realtime_factor\n");
+    fflush(stdout);
+}
+
+static void PrintFooter(void)
+{
+    if(OutputJSON)
+        printf("\n]\n");
+    fflush(stdout);
+}
+
+static void PrintResult(const char *resampler, const Scenario *scen, double ns)
+{
+    double nsPerFrame = ns / BenchFrames;
+    double nsPerVoiceFrame = nsPerFrame / scen->Voices;
+    double rtFactor = ((double)BenchFrames/BENCH_RATE*1000000000.0) / ns;
+
+    if(OutputJSON)
+        printf("%s  { \"resampler\": \"%s\", \"output\": \"%s\", \"voices\": %d, "
+               "\"format\": \"%s\", \"pitch\": %g, \"sends\": %d, \"effect\": \"%s\", "
+               "\"frames\": %d, \"ns_per_frame\": %.2f, \"ns_per_voice_frame\": %.3f, "
+               "\"realtime_factor\": %.2f }", PrintedResult ? ",\n" : "", resampler,
+               scen->Output, scen->Voices, scen->Format->Name, scen->Pitch, scen->Sends,
+               scen->Effect, BenchFrames, nsPerFrame, nsPerVoiceFrame, rtFactor);
+    else
+        printf("%s,%s,%d,%s,%g,%d,%s,%d,%.2f,%.3f,%.2f\n", resampler, scen->Output,
+               scen->Voices, scen->Format->Name, scen->Pitch, scen->Sends, scen->Effect,
+               BenchFrames, nsPerFrame, nsPerVoiceFrame, rtFactor);
+    fflush(stdout);
+    PrintedResult = 1;
+}
+
+
+/* Sets up and renders one scenario, returning the time taken to render
+ * BenchFrames sample frames in nanoseconds, or a negative value if the
+ * scenario couldn't be run. */
+static double RunScenario(const Scenario *scen)
+{
+    ALCint attrs[16];
+    ALCdevice *device;
+    ALCcontext *context = NULL;
+    ALuint buffer = 0, *sources = NULL;
+    ALuint effect = 0, slots[MAX_SENDS] = { 0 };
+    ALfloat *samples = NULL;
+    ALCsizei done;
+    double start, ns = -1.0;
+    int i, j;
+
+    i = 0;
+    attrs[i++] = ALC_FORMAT_CHANNELS_SOFT;
+    attrs[i++] = (strcmp(scen->Output, "quad") == 0) ? ALC_QUAD_SOFT :
+                 (strcmp(scen->Output, "5.1-hq") == 0) ? ALC_5POINT1_SOFT : ALC_STEREO_SOFT;
+    attrs[i++] = ALC_FORMAT_TYPE_SOFT;
+    attrs[i++] = ALC_FLOAT_SOFT;
+    attrs[i++] = ALC_FREQUENCY;
+    attrs[i++] = BENCH_RATE;
+    attrs[i++] = ALC_HRTF_SOFT;
+    attrs[i++] = (strcmp(scen->Output, "hrtf") == 0) ? ALC_TRUE : ALC_FALSE;
+    attrs[i++] = ALC_MAX_AUXILIARY_SENDS;
+    attrs[i++] = scen->Sends;
+    attrs[i++] = ALC_MONO_SOURCES;
+    attrs[i++] = scen->Voices;
+    attrs[i++] = ALC_STEREO_SOURCES;
+    attrs[i++] = 0;
+    attrs[i++] = 0;
+
+    device = palcLoopbackOpenDeviceSOFT(NULL);
+    if(!device)
+        return -1.0;
+    context = alcCreateContext(device, attrs);
+    if(!context || !alcMakeContextCurrent(context))
+        goto done;
+
+    if(strcmp(scen->Output, "hrtf") == 0)
+    {
+        ALCint status = ALC_HRTF_DISABLED_SOFT;
+        alcGetIntegerv(device, ALC_HRTF_STATUS_SOFT, 1, &status);
+        if(status != ALC_HRTF_ENABLED_SOFT)
+        {
+            fprintf(stderr, "HRTF unavailable, skipping\n");
+            goto done;
+        }
+    }
+
+    sources = calloc(scen->Voices, sizeof(ALuint));
+    samples = malloc(BENCH_BLOCK_SIZE * 8 * sizeof(ALfloat));
+    if(!sources || !samples)
+        goto done;
+
+    alGenBuffers(1, &buffer);
+    if(!FillBuffer(buffer, scen->Format))
+    {
+        fprintf(stderr, "Failed to load %s buffer, skipping\n", scen->Format->Name);
+        goto done;
+    }
+
+    if(scen->Sends > 0)
+    {
+        palGenEffects(1, &effect);
+        palEffecti(effect, AL_EFFECT_TYPE, GetEffectType(scen->Effect));
+        palGenAuxiliaryEffectSlots(scen->Sends, slots);
+        for(j = 0;j < scen->Sends;j++)
+            palAuxiliaryEffectSloti(slots[j], AL_EFFECTSLOT_EFFECT, (ALint)effect);
+    }
+
+    alGenSources(scen->Voices, sources);
+    if(alGetError() != AL_NO_ERROR)
+    {
+        fprintf(stderr, "Failed to create %d sources, skipping\n", scen->Voices);
+        goto done;
+    }
+    for(i = 0;i < scen->Voices;i++)
+    {
+        alSourcei(sources[i], AL_BUFFER, (ALint)buffer);
+        alSourcei(sources[i], AL_LOOPING, AL_TRUE);
+        alSourcef(sources[i], AL_PITCH, scen->Pitch);
+        alSource3f(sources[i], AL_POSITION, RandomFloat()*20.0f - 10.0f,
+                   RandomFloat()*4.0f - 2.0f, RandomFloat()*20.0f - 10.0f);
+        for(j = 0;j < scen->Sends;j++)
+            alSource3i(sources[i], AL_AUXILIARY_SEND_FILTER, (ALint)slots[j], j,
+                       AL_FILTER_NULL);
+    }
+    alSourcePlayv(scen->Voices, sources);
+    if(alGetError() != AL_NO_ERROR)
+    {
+        fprintf(stderr, "Failed to start sources, skipping\n");
+        goto done;
+    }
+
+    /* Warm up caches and let the initial parameter updates go through. */
+    for(done = 0;done < BENCH_RATE/10;done += BENCH_BLOCK_SIZE)
+        palcRenderSamplesSOFT(device, samples, BENCH_BLOCK_SIZE);
+
+    start = GetTimeNanoseconds();
+    for(done = 0;done < BenchFrames;)
+    {
+        ALCsizei todo = BenchFrames - done;
+        if(todo > BENCH_BLOCK_SIZE) todo = BENCH_BLOCK_SIZE;
+        palcRenderSamplesSOFT(device, samples, todo);
+        done += todo;
+    }
+    ns = GetTimeNanoseconds() - start;
+    if(ns <= 0.0) ns = 1.0;
+
+done:
+    if(context)
+    {
+        if(sources)
+        {
+            alSourceStopv(scen->Voices, sources);
+            alDeleteSources(scen->Voices, sources);
+        }
+        if(slots[0])
+            palDeleteAuxiliaryEffectSlots(scen->Sends, slots);
+        if(effect)
+            palDeleteEffects(1, &effect);
+        if(buffer)
+            alDeleteBuffers(1, &buffer);
+        alcMakeContextCurrent(NULL);
+        alcDestroyContext(context);
+    }
+    alcCloseDevice(device);
+    free(samples);
+    free(sources);
+    return ns;
+}
+
+static void RunMatrix(const char *resampler)
+{
+    Scenario scen;
+    size_t i;
+    double ns;
+
+#define RUN() do {                                                            \
+    ns = RunScenario(&scen);                                                  \
+    if(ns >= 0.0) PrintResult(resampler, &scen, ns);                          \
+} while(0)
+
+    scen = Baseline;
+    RUN();
+
+    for(i = 0;i < sizeof(VoiceCounts)/sizeof(VoiceCounts[0]);i++)
+    {
+        if(VoiceCounts[i] == Baseline.Voices) continue;
+        scen = Baseline;
+        scen.Voices = VoiceCounts[i];
+        RUN();
+    }
+    for(i = 0;i < sizeof(Formats)/sizeof(Formats[0]);i++)
+    {
+        if(&Formats[i] == Baseline.Format) continue;
+        scen = Baseline;
+        scen.Format = &Formats[i];
+        RUN();
+    }
+    for(i = 0;i < sizeof(Pitches)/sizeof(Pitches[0]);i++)
+    {
+        if(Pitches[i] == Baseline.Pitch) continue;
+        scen = Baseline;
+        scen.Pitch = Pitches[i];
+        RUN();
+    }
+    for(i = 0;i < sizeof(Outputs)/sizeof(Outputs[0]);i++)
+    {
+        if(strcmp(Outputs[i], Baseline.Output) == 0) continue;
+        scen = Baseline;
+        scen.Output = Outputs[i];
+        RUN();
+    }
+    for(i = 0;i < sizeof(SendCounts)/sizeof(SendCounts[0]);i++)
+    {
+        if(SendCounts[i] == Baseline.Sends) continue;
+        scen = Baseline;
+        scen.Sends = SendCounts[i];
+        RUN();
+    }
+    for(i = 0;i < sizeof(Effects)/sizeof(Effects[0]);i++)
+    {
+        if(strcmp(Effects[i], "none") == 0) continue;
+        scen = Baseline;
+        scen.Sends = 1;
+        scen.Effect = Effects[i];
+        RUN();
+    }
+#undef RUN
+}
+
+
+/* Writes a config file selecting the resampler, and pointing the library at
+ * the HRTF data and surround decoder preset, then initializes it. */
+static int InitLibrary(const char *resampler, char *confname, size_t confsize)
+{
+    const char *tmpdir;
+    FILE *f;
+
+    tmpdir = getenv("TMPDIR");
+    if(!tmpdir || !tmpdir[0]) tmpdir = getenv("TEMP");
+    if(!tmpdir || !tmpdir[0]) tmpdir = ".";
+    snprintf(confname, confsize, "%s/albench-%s.conf", tmpdir, resampler);
+
+    f = fopen(confname, "w");
+    if(!f)
+    {
+        fprintf(stderr, "Failed to create %s\n", confname);
+        return 0;
+    }
+    fprintf(f, "[general]\n"
+               "resampler = %s\n"
+               "sources = 4096\n"
+               "hrtf-paths = %s/hrtf\n"
+               "[decoder]\n"
+               "hq-mode = true\n"
+               "surround51 = %s/presets/itu5.1.ambdec\n", resampler, DataDir, DataDir);
+    fclose(f);
+
+#ifdef _WIN32
+    {
+        char envstr[1024];
+        snprintf(envstr, sizeof(envstr), "ALSOFT_CONF=%s", confname);
+        _putenv(envstr);
+    }
+#else
+    setenv("ALSOFT_CONF", confname, 1);
+#endif
+
+    if(!alcIsExtensionPresent(NULL, "ALC_SOFT_loopback"))
+    {
+        fprintf(stderr, "ALC_SOFT_loopback not supported\n");
+        return 0;
+    }
+    palcLoopbackOpenDeviceSOFT = (LPALCLOOPBACKOPENDEVICESOFT)
+        alcGetProcAddress(NULL, "alcLoopbackOpenDeviceSOFT");
+    palcRenderSamplesSOFT = (LPALCRENDERSAMPLESSOFT)alcGetProcAddress(NULL, "alcRenderSamplesSOFT");
+
+#define LOAD_PROC(x, T)  ((p##x) = (T)alGetProcAddress(#x))
+    LOAD_PROC(alGenEffects, LPALGENEFFECTS);
+    LOAD_PROC(alDeleteEffects, LPALDELETEEFFECTS);
+    LOAD_PROC(alEffecti, LPALEFFECTI);
+    LOAD_PROC(alGenAuxiliaryEffectSlots, LPALGENAUXILIARYEFFECTSLOTS);
+    LOAD_PROC(alDeleteAuxiliaryEffectSlots, LPALDELETEAUXILIARYEFFECTSLOTS);
+    LOAD_PROC(alAuxiliaryEffectSloti, LPALAUXILIARYEFFECTSLOTI);
+#undef LOAD_PROC
+
+    return 1;
+}
+
+static int RunResampler(const char *resampler)
+{
+    char confname[1024];
+    int ret = 0;
+
+    if(InitLibrary(resampler, confname, sizeof(confname)))
+    {
+        RunMatrix(resampler);
+        ret = 1;
+    }
+    remove(confname);
+    return ret;
+}
+
+
+static void PrintUsage(const char *name)
+{
+    printf("Usage: %s [options]\n\n"
+           "Options:\n"
+           "  -r <list>        Comma-separated resamplers to run (default all of\n"
+           "                   point,linear,sinc4,sinc8,bsinc)\n"
+           "  -n <frames>      Sample frames to time per scenario (default %d)\n"
+           "  -d <dir>         Source directory with the hrtf and presets data\n"
+           "                   (default $ALBENCH_DATA_DIR, or %s)\n"
+           "  --json           Write results as JSON instead of CSV\n",
+           name, BENCH_RATE, ALBENCH_DATA_DIR);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *resamplers[sizeof(Resamplers)/sizeof(Resamplers[0])];
+    char reslist[256] = "";
+    int numres = 0;
+    int failed = 0;
+    int i;
+
+    for(i = 1;i < argc;i++)
+    {
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+        {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[i], "--json") == 0)
+            OutputJSON = 1;
+        else if(strcmp(argv[i], "-r") == 0 && i+1 < argc)
+            snprintf(reslist, sizeof(reslist), "%s", argv[++i]);
+        else if(strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            BenchFrames = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-d") == 0 && i+1 < argc)
+            DataDir = argv[++i];
+        else
+        {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(BenchFrames <= 0)
+    {
+        fprintf(stderr, "Invalid frame count\n");
+        return 1;
+    }
+    if(!DataDir)
+    {
+        DataDir = getenv("ALBENCH_DATA_DIR");
+        if(!DataDir || !DataDir[0])
+            DataDir = ALBENCH_DATA_DIR;
+    }
+    {
+        char presetname[1024];
+        FILE *f;
+
+        snprintf(presetname, sizeof(presetname), "%s/presets/itu5.1.ambdec", DataDir);
+        if(!(f=fopen(presetname, "r")))
+            fprintf(stderr, "Warning: no presets in %s, use -d or ALBENCH_DATA_DIR to set the "
+                            "data directory\n", DataDir);
+        else
+            fclose(f);
+    }
+
+    if(!reslist[0])
+    {
+        for(i = 0;i < (int)(sizeof(Resamplers)/sizeof(Resamplers[0]));i++)
+            resamplers[numres++] = Resamplers[i];
+    }
+    else
+    {
+        char *name = strtok(reslist, ",");
+        while(name)
+        {
+            for(i = 0;i < (int)(sizeof(Resamplers)/sizeof(Resamplers[0]));i++)
+            {
+                if(strcmp(name, Resamplers[i]) == 0)
+                    break;
+            }
+            if(i == (int)(sizeof(Resamplers)/sizeof(Resamplers[0])))
+            {
+                fprintf(stderr, "Unknown resampler: %s\n", name);
+                return 1;
+            }
+            if(numres < (int)(sizeof(resamplers)/sizeof(resamplers[0])))
+                resamplers[numres++] = Resamplers[i];
+            name = strtok(NULL, ",");
+        }
+    }
+
+    PrintHeader();
+#ifndef _WIN32
+    for(i = 0;i < numres;i++)
+    {
+        int status = 0;
+        pid_t pid;
+
+        fflush(stdout);
+        pid = fork();
+        if(pid < 0)
+        {
+            fprintf(stderr, "Failed to fork: %s\n", strerror(errno));
+            failed = 1;
+            break;
+        }
+        if(pid == 0)
+        {
+            /* Results printed by earlier children need a separator. */
+            PrintedResult = (i > 0);
+            _exit(RunResampler(resamplers[i]) ? 0 : 1);
+        }
+        if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+    }
+#else
+    if(numres > 1)
+        fprintf(stderr, "Only running the %s resampler\n", resamplers[0]);
+    if(!RunResampler(resamplers[0]))
+        failed = 1;
+#endif
+    PrintFooter();
+
+    return failed;
+}
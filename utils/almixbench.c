@@ -0,0 +1,567 @@
+/*
+ * OpenAL Mixer Kernel Benchmark
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Times every build- and CPU-supported variant of the mixer's inner kernels
+ * (resamplers, gain mixers, row mixers, HRTF mixers, and the biquad filter)
+ * across block sizes, channel counts, and HRIR sizes, and checks each
+ * variant's output against the C reference. The kernels aren't exported from
+ * the library, so this is built directly from the library sources.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "alMain.h"
+#include "alu.h"
+#include "alFilter.h"
+#include "hrtf.h"
+#include "align.h"
+#include "threads.h"
+
+#include "mixer_defs.h"
+
+
+#define CHECK_CALLS 3
+#define TIME_REPEATS 3
+
+static const ALuint BlockSizes[] = { 64, 256, 1024, BUFFERSIZE };
+static const ALuint OutChannelCounts[] = { 2, 4, 8, 16 };
+static const ALuint InChannelCounts[] = { 4, 9, 16 };
+static const ALuint IrSizes[] = { 16, 32, 64, 128 };
+
+/* Pitch used for the resampler runs, as a fixed-point increment. */
+#define RESAMPLE_INCREMENT ((ALuint)(FRACTIONONE*1.37f))
+
+
+typedef struct ResamplerVariant {
+    const char *Kernel;
+    const char *Name;
+    ALuint Caps;
+    ResamplerFunc Func;
+} ResamplerVariant;
+
+static const ResamplerVariant Resamplers[] = {
+    { "point", "C", 0, Resample_point32_C },
+    { "lerp", "C", 0, Resample_lerp32_C },
+#ifdef HAVE_SSE2
+    { "lerp", "SSE2", CPU_CAP_SSE2, Resample_lerp32_SSE2 },
+#endif
+#ifdef HAVE_SSE4_1
+    { "lerp", "SSE4.1", CPU_CAP_SSE4_1, Resample_lerp32_SSE41 },
+#endif
+    { "fir4", "C", 0, Resample_fir4_32_C },
+#ifdef HAVE_SSE3
+    { "fir4", "SSE3", CPU_CAP_SSE3, Resample_fir4_32_SSE3 },
+#endif
+#ifdef HAVE_SSE4_1
+    { "fir4", "SSE4.1", CPU_CAP_SSE4_1, Resample_fir4_32_SSE41 },
+#endif
+    { "fir8", "C", 0, Resample_fir8_32_C },
+#ifdef HAVE_SSE3
+    { "fir8", "SSE3", CPU_CAP_SSE3, Resample_fir8_32_SSE3 },
+#endif
+#ifdef HAVE_SSE4_1
+    { "fir8", "SSE4.1", CPU_CAP_SSE4_1, Resample_fir8_32_SSE41 },
+#endif
+    { "bsinc", "C", 0, Resample_bsinc32_C },
+#ifdef HAVE_SSE
+    { "bsinc", "SSE", CPU_CAP_SSE, Resample_bsinc32_SSE },
+#endif
+};
+
+typedef struct MixerVariant {
+    const char *Name;
+    ALuint Caps;
+    MixerFunc Mix;
+    RowMixerFunc MixRow;
+    HrtfMixerFunc MixHrtf;
+    HrtfDirectMixerFunc MixDirectHrtf;
+} MixerVariant;
+
+static const MixerVariant Mixers[] = {
+    { "C", 0, Mix_C, MixRow_C, MixHrtf_C, MixDirectHrtf_C },
+#ifdef HAVE_SSE
+    { "SSE", CPU_CAP_SSE, Mix_SSE, MixRow_SSE, MixHrtf_SSE, MixDirectHrtf_SSE },
+#endif
+#ifdef HAVE_NEON
+    { "Neon", CPU_CAP_NEON, Mix_Neon, MixRow_Neon, MixHrtf_Neon, MixDirectHrtf_Neon },
+#endif
+};
+
+
+static alignas(16) ALfloat SrcData[MAX_PRE_SAMPLES + BUFFERSIZE*CHECK_CALLS + MAX_POST_SAMPLES];
+static alignas(16) ALfloat DstData[BUFFERSIZE];
+static alignas(16) ALfloat RefData[BUFFERSIZE*CHECK_CALLS];
+static alignas(16) ALfloat MixData[MAX_OUTPUT_CHANNELS][BUFFERSIZE];
+static alignas(16) ALfloat OutBuffer[MAX_OUTPUT_CHANNELS][BUFFERSIZE];
+static alignas(16) ALfloat RefBuffer[MAX_OUTPUT_CHANNELS][BUFFERSIZE];
+
+/* Scratch coefficients for the bsinc resampler, in the same layout as the
+ * bsincTab entries for the largest (24-point) filter scale. */
+static alignas(16) ALfloat BsincCoeffs[4][BSINC_PHASE_COUNT][24];
+
+static ALuint TotalFrames = 1<<21;
+static int Failures = 0;
+
+
+static unsigned int RandomSeed = 22222;
+static ALfloat RandomFloat(void)
+{
+    RandomSeed = RandomSeed*96314165 + 907633515;
+    return (ALfloat)(RandomSeed>>8)/8388608.0f - 1.0f;
+}
+
+static void FillRandom(ALfloat *data, size_t count, ALfloat scale)
+{
+    size_t i;
+    for(i = 0;i < count;i++)
+        data[i] = RandomFloat() * scale;
+}
+
+static double GetTimeNanoseconds(void)
+{
+    struct timespec ts;
+    if(altimespec_get(&ts, AL_TIME_UTC) != AL_TIME_UTC)
+        return 0.0;
+    return (double)ts.tv_sec*1000000000.0 + (double)ts.tv_nsec;
+}
+
+/* Returns the largest difference between two sets of samples, relative to the
+ * reference magnitude. SIMD variants may sum in a different order than the C
+ * reference, so small differences are expected. */
+static ALfloat CompareSamples(const ALfloat *ref, const ALfloat *test, ALuint count)
+{
+    ALfloat maxdiff = 0.0f;
+    ALuint i;
+    for(i = 0;i < count;i++)
+    {
+        ALfloat diff = fabsf(ref[i] - test[i]) / (1.0f + fabsf(ref[i]));
+        if(!(diff <= maxdiff)) maxdiff = diff;
+    }
+    return maxdiff;
+}
+
+static void PrintResult(const char *kernel, const char *variant, ALuint block,
+                        const char *param, double ns, double refns, ALfloat maxdiff)
+{
+    const int ok = (maxdiff <= 1e-4f);
+    printf("%s,%s,%u,%s,%.3f,%.2f,%s,%g\n", kernel, variant, block, param,
+           ns, refns/ns, ok ? "ok" : "MISMATCH", maxdiff);
+    fflush(stdout);
+    if(!ok) Failures++;
+}
+
+/* Times a kernel call, returning the best ns per sample frame over a few
+ * repeats. */
+#define TIME_KERNEL(ns_, block_, call_) do {                                  \
+    ALuint iters_ = maxu(TotalFrames / (block_), 1);                          \
+    ALuint rep_, it_;                                                         \
+    (ns_) = 0.0;                                                              \
+    for(rep_ = 0;rep_ < TIME_REPEATS;rep_++)                                  \
+    {                                                                         \
+        double start_ = GetTimeNanoseconds();                                 \
+        double took_;                                                         \
+        for(it_ = 0;it_ < iters_;it_++)                                       \
+        {                                                                     \
+            call_;                                                            \
+        }                                                                     \
+        took_ = (GetTimeNanoseconds() - start_) / ((double)iters_*(block_));  \
+        if(rep_ == 0 || took_ < (ns_)) (ns_) = took_;                         \
+    }                                                                         \
+    if((ns_) <= 0.0) (ns_) = 1e-3;                                            \
+} while(0)
+
+
+static void PrepareBsinc(BsincState *state)
+{
+    ALuint pi;
+
+    FillRandom(&BsincCoeffs[0][0][0], sizeof(BsincCoeffs)/sizeof(ALfloat), 0.1f);
+    state->sf = 0.5f;
+    state->m = 24;
+    state->l = -11;
+    for(pi = 0;pi < BSINC_PHASE_COUNT;pi++)
+    {
+        state->coeffs[pi].filter  = BsincCoeffs[0][pi];
+        state->coeffs[pi].scDelta = BsincCoeffs[1][pi];
+        state->coeffs[pi].phDelta = BsincCoeffs[2][pi];
+        state->coeffs[pi].spDelta = BsincCoeffs[3][pi];
+    }
+}
+
+static void BenchResamplers(void)
+{
+    const ALfloat *src = SrcData + MAX_PRE_SAMPLES;
+    BsincState bsinc;
+    size_t i, b;
+    ALuint j;
+
+    /* Any coefficients will do, as long as every variant uses the same ones.
+     * The FIR4 and FIR8 tables share storage, so fill the whole union. */
+    FillRandom(&ResampleCoeffs.FIR8[0][0], sizeof(ResampleCoeffs)/sizeof(ALfloat), 0.5f);
+    PrepareBsinc(&bsinc);
+
+    for(b = 0;b < COUNTOF(BlockSizes);b++)
+    {
+        const ALuint block = BlockSizes[b];
+        double refns = 0.0;
+
+        for(i = 0;i < COUNTOF(Resamplers);i++)
+        {
+            const ResamplerVariant *var = &Resamplers[i];
+            const ALfloat *res = NULL;
+            ALfloat maxdiff = 0.0f;
+            ALuint frac;
+            double ns;
+
+            if((var->Caps&CPUCapFlags) != var->Caps)
+                continue;
+
+            /* Check a few calls at different fractional offsets, saving the
+             * C variant's output as the reference for the others. */
+            for(j = 0;j < CHECK_CALLS;j++)
+            {
+                frac = (j*1237) & FRACTIONMASK;
+                res = var->Func(&bsinc, src+j, frac, RESAMPLE_INCREMENT, DstData, block);
+                if(strcmp(var->Name, "C") == 0)
+                    memcpy(&RefData[j*BUFFERSIZE], res, block*sizeof(ALfloat));
+                else
+                    maxdiff = maxf(maxdiff, CompareSamples(&RefData[j*BUFFERSIZE], res, block));
+            }
+
+            frac = 0;
+            TIME_KERNEL(ns, block,
+                res = var->Func(&bsinc, src, frac, RESAMPLE_INCREMENT, DstData, block));
+            (void)res;
+            if(strcmp(var->Name, "C") == 0)
+                refns = ns;
+
+            PrintResult(var->Kernel, var->Name, block, "inc=1.37", ns, refns, maxdiff);
+        }
+    }
+}
+
+
+static void InitGains(MixGains *gains, ALuint count, ALboolean stepping)
+{
+    ALuint c;
+    for(c = 0;c < count;c++)
+    {
+        gains[c].Current = 0.25f + 0.5f*fabsf(RandomFloat());
+        gains[c].Target = stepping ? 0.25f + 0.5f*fabsf(RandomFloat()) : gains[c].Current;
+        gains[c].Step = 0.0f;
+    }
+}
+
+static void BenchMixers(void)
+{
+    MixGains refgains[MAX_OUTPUT_CHANNELS];
+    MixGains gains[MAX_OUTPUT_CHANNELS];
+    char param[64];
+    size_t i, b, n;
+
+    for(b = 0;b < COUNTOF(BlockSizes);b++)
+    {
+        const ALuint block = BlockSizes[b];
+        for(n = 0;n < COUNTOF(OutChannelCounts);n++)
+        {
+            const ALuint chans = OutChannelCounts[n];
+            double refns = 0.0;
+            ALuint c;
+
+            /* Check with the gains stepping over half the block. */
+            InitGains(refgains, chans, AL_TRUE);
+            for(c = 0;c < chans;c++)
+                refgains[c].Step = (refgains[c].Target - refgains[c].Current) / (block/2);
+
+            for(i = 0;i < COUNTOF(Mixers);i++)
+            {
+                const MixerVariant *var = &Mixers[i];
+                ALfloat maxdiff = 0.0f;
+                double ns;
+
+                if((var->Caps&CPUCapFlags) != var->Caps)
+                    continue;
+
+                memset(OutBuffer, 0, sizeof(OutBuffer));
+                memcpy(gains, refgains, sizeof(gains));
+                var->Mix(SrcData, chans, OutBuffer, gains, block/2, 0, block);
+                if(i == 0)
+                    memcpy(RefBuffer, OutBuffer, sizeof(RefBuffer));
+                else for(c = 0;c < chans;c++)
+                    maxdiff = maxf(maxdiff, CompareSamples(RefBuffer[c], OutBuffer[c], block));
+
+                /* Time the steady-state (non-stepping) mix. */
+                memcpy(gains, refgains, sizeof(gains));
+                for(c = 0;c < chans;c++)
+                    gains[c].Step = 0.0f;
+                TIME_KERNEL(ns, block,
+                    var->Mix(SrcData, chans, OutBuffer, gains, 0, 0, block));
+                if(i == 0) refns = ns;
+
+                snprintf(param, sizeof(param), "chans=%u", chans);
+                PrintResult("Mix", var->Name, block, param, ns, refns, maxdiff);
+            }
+        }
+    }
+}
+
+static void BenchRowMixers(void)
+{
+    ALfloat gains[MAX_OUTPUT_CHANNELS];
+    char param[64];
+    size_t i, b, n;
+
+    FillRandom(gains, MAX_OUTPUT_CHANNELS, 0.5f);
+    for(b = 0;b < COUNTOF(BlockSizes);b++)
+    {
+        const ALuint block = BlockSizes[b];
+        for(n = 0;n < COUNTOF(InChannelCounts);n++)
+        {
+            const ALuint chans = InChannelCounts[n];
+            double refns = 0.0;
+
+            for(i = 0;i < COUNTOF(Mixers);i++)
+            {
+                const MixerVariant *var = &Mixers[i];
+                ALfloat maxdiff = 0.0f;
+                double ns;
+
+                if((var->Caps&CPUCapFlags) != var->Caps)
+                    continue;
+
+                memset(DstData, 0, sizeof(DstData));
+                var->MixRow(DstData, gains, MixData, chans, block);
+                if(i == 0)
+                    memcpy(RefData, DstData, block*sizeof(ALfloat));
+                else
+                    maxdiff = CompareSamples(RefData, DstData, block);
+
+                TIME_KERNEL(ns, block,
+                    var->MixRow(DstData, gains, MixData, chans, block));
+                if(i == 0) refns = ns;
+
+                snprintf(param, sizeof(param), "chans=%u", chans);
+                PrintResult("MixRow", var->Name, block, param, ns, refns, maxdiff);
+            }
+        }
+    }
+}
+
+static void BenchHrtfMixers(void)
+{
+    static HrtfParams current, target, refcurrent;
+    static HrtfState state, refstate;
+    MixHrtfParams params;
+    char param[64];
+    size_t i, b, n;
+    ALuint j, k;
+
+    for(k = 0;k < HRIR_LENGTH;k++)
+    {
+        refcurrent.Coeffs[k][0] = RandomFloat() * 0.05f;
+        refcurrent.Coeffs[k][1] = RandomFloat() * 0.05f;
+        target.Coeffs[k][0] = RandomFloat() * 0.05f;
+        target.Coeffs[k][1] = RandomFloat() * 0.05f;
+    }
+    refcurrent.Delay[0] = 3 << HRTFDELAY_BITS;
+    refcurrent.Delay[1] = (12 << HRTFDELAY_BITS) + (HRTFDELAY_FRACONE/3);
+    target.Delay[0] = 5 << HRTFDELAY_BITS;
+    target.Delay[1] = 10 << HRTFDELAY_BITS;
+    memset(&refstate, 0, sizeof(refstate));
+
+    for(b = 0;b < COUNTOF(BlockSizes);b++)
+    {
+        const ALuint block = BlockSizes[b];
+        for(n = 0;n < COUNTOF(IrSizes);n++)
+        {
+            const ALuint irsize = IrSizes[n];
+            double refns = 0.0, drefns = 0.0;
+
+            params.Target = &target;
+            params.Current = &current;
+            for(k = 0;k < HRIR_LENGTH;k++)
+            {
+                params.Steps.Coeffs[k][0] = (target.Coeffs[k][0]-refcurrent.Coeffs[k][0]) / (block/2);
+                params.Steps.Coeffs[k][1] = (target.Coeffs[k][1]-refcurrent.Coeffs[k][1]) / (block/2);
+            }
+            params.Steps.Delay[0] = ((ALint)target.Delay[0]-(ALint)refcurrent.Delay[0]) / (ALint)(block/2);
+            params.Steps.Delay[1] = ((ALint)target.Delay[1]-(ALint)refcurrent.Delay[1]) / (ALint)(block/2);
+
+            for(i = 0;i < COUNTOF(Mixers);i++)
+            {
+                const MixerVariant *var = &Mixers[i];
+                ALfloat maxdiff = 0.0f;
+                ALuint offset;
+                double ns;
+
+                if((var->Caps&CPUCapFlags) != var->Caps)
+                    continue;
+
+                /* Check a stepping call followed by steady-state calls, each
+                 * continuing from the previous call's state. */
+                current = refcurrent;
+                state = refstate;
+                offset = 0;
+                memset(OutBuffer, 0, sizeof(OutBuffer));
+                for(j = 0;j < CHECK_CALLS;j++)
+                {
+                    var->MixHrtf(OutBuffer, 0, 1, SrcData + j*block, j ? 0 : block/2,
+                                 offset, 0, irsize, &params, &state, block);
+                    offset += block;
+                    if(i == 0)
+                    {
+                        memcpy(&RefData[j*BUFFERSIZE], OutBuffer[0], block*sizeof(ALfloat));
+                        memcpy(RefBuffer[j], OutBuffer[1], block*sizeof(ALfloat));
+                    }
+                    else
+                    {
+                        maxdiff = maxf(maxdiff, CompareSamples(&RefData[j*BUFFERSIZE], OutBuffer[0], block));
+                        maxdiff = maxf(maxdiff, CompareSamples(RefBuffer[j], OutBuffer[1], block));
+                    }
+                    memset(OutBuffer[0], 0, block*sizeof(ALfloat));
+                    memset(OutBuffer[1], 0, block*sizeof(ALfloat));
+                }
+
+                TIME_KERNEL(ns, block,
+                    var->MixHrtf(OutBuffer, 0, 1, SrcData, 0, offset, 0, irsize, &params,
+                                 &state, block); offset += block);
+                if(i == 0) refns = ns;
+
+                snprintf(param, sizeof(param), "ir=%u", irsize);
+                PrintResult("MixHrtf", var->Name, block, param, ns, refns, maxdiff);
+
+                /* The direct HRTF mixer applies fixed coefficients with no
+                 * delay, as used for the ambisonic-to-HRTF decode. */
+                state = refstate;
+                offset = 0;
+                memset(OutBuffer, 0, sizeof(OutBuffer));
+                var->MixDirectHrtf(OutBuffer, 0, 1, SrcData, offset, irsize, refcurrent.Coeffs,
+                                   state.Values, block);
+                if(i == 0)
+                {
+                    memcpy(RefBuffer[CHECK_CALLS+0], OutBuffer[0], block*sizeof(ALfloat));
+                    memcpy(RefBuffer[CHECK_CALLS+1], OutBuffer[1], block*sizeof(ALfloat));
+                    maxdiff = 0.0f;
+                }
+                else
+                    maxdiff = maxf(CompareSamples(RefBuffer[CHECK_CALLS+0], OutBuffer[0], block),
+                                   CompareSamples(RefBuffer[CHECK_CALLS+1], OutBuffer[1], block));
+
+                TIME_KERNEL(ns, block,
+                    var->MixDirectHrtf(OutBuffer, 0, 1, SrcData, offset, irsize,
+                                       refcurrent.Coeffs, state.Values, block);
+                    offset += block);
+                if(i == 0) drefns = ns;
+
+                PrintResult("MixDirectHrtf", var->Name, block, param, ns, drefns, maxdiff);
+            }
+        }
+    }
+}
+
+static void BenchFilters(void)
+{
+    ALfilterState filter;
+    size_t b;
+
+    /* There's only the C implementation, which is timed as a reference for
+     * the other kernels' per-sample costs. */
+    ALfilterState_setParams(&filter, ALfilterType_HighShelf, 0.5f, 5000.0f/44100.0f,
+                            calc_rcpQ_from_slope(0.5f, 0.75f));
+    for(b = 0;b < COUNTOF(BlockSizes);b++)
+    {
+        const ALuint block = BlockSizes[b];
+        double ns;
+
+        ALfilterState_clear(&filter);
+        TIME_KERNEL(ns, block,
+            ALfilterState_processC(&filter, DstData, SrcData, block));
+        PrintResult("ALfilterState_process", "C", block, "highshelf", ns, ns, 0.0f);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *only = NULL;
+    int i;
+
+    for(i = 1;i < argc;i++)
+    {
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+        {
+            printf("Usage: %s [-n <frames>] [-k <kernel>]\n\n"
+                   "  -n <frames>   Sample frames to time per kernel, block size, and\n"
+                   "                variant (default %u)\n"
+                   "  -k <kernel>   Only run one kernel group: resample, mix, mixrow,\n"
+                   "                hrtf, or filter\n", argv[0], TotalFrames);
+            return 0;
+        }
+        if(strcmp(argv[i], "-n") == 0 && i+1 < argc)
+            TotalFrames = (ALuint)strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "-k") == 0 && i+1 < argc)
+            only = argv[++i];
+        else
+        {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(TotalFrames == 0)
+    {
+        fprintf(stderr, "Invalid frame count\n");
+        return 1;
+    }
+
+    FillCPUCaps(~0u);
+    fprintf(stderr, "CPU extensions:%s%s%s%s%s\n",
+        (CPUCapFlags&CPU_CAP_SSE) ? " SSE" : "", (CPUCapFlags&CPU_CAP_SSE2) ? " SSE2" : "",
+        (CPUCapFlags&CPU_CAP_SSE3) ? " SSE3" : "", (CPUCapFlags&CPU_CAP_SSE4_1) ? " SSE4.1" : "",
+        (CPUCapFlags&CPU_CAP_NEON) ? " Neon" : "");
+
+    FillRandom(SrcData, COUNTOF(SrcData), 1.0f);
+    FillRandom(&MixData[0][0], sizeof(MixData)/sizeof(ALfloat), 1.0f);
+
+    printf("kernel,variant,block,param,ns_per_frame,speedup_vs_c,check,max_rel_diff\n");
+    if(!only || strcmp(only, "resample") == 0)
+        BenchResamplers();
+    if(!only || strcmp(only, "mix") == 0)
+        BenchMixers();
+    if(!only || strcmp(only, "mixrow") == 0)
+        BenchRowMixers();
+    if(!only || strcmp(only, "hrtf") == 0)
+        BenchHrtfMixers();
+    if(!only || strcmp(only, "filter") == 0)
+        BenchFilters();
+
+    if(Failures > 0)
+    {
+        fprintf(stderr, "%d kernel variant(s) didn't match the C reference\n", Failures);
+        return 1;
+    }
+    return 0;
+}
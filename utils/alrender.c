@@ -0,0 +1,973 @@
+/*
+ * OpenAL Offline Render Utility
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Renders scene descriptions through a loopback device, as fast as possible,
+ * to WAV, W64, or RF64 files. Each scene is a text file with one statement per line
+ * ('#' starts a comment):
+ *
+ *   length <seconds>
+ *   buffer <name> <file.wav>
+ *   buffer <name> sine <hz> <seconds>
+ *   source <name> <buffer name>
+ *   at <time> <source|listener> <play|pause|stop|rewind>
+ *   at <time> <source|listener> <property> <values...>
+ *   ramp <start> <end> <source|listener> <property> <values...>
+ *
+ * Source properties are gain, pitch, reference_distance, rolloff_factor,
+ * max_distance, position, velocity, direction, looping, and relative. The
+ * listener has gain, position, velocity, and orientation. Ramps move a
+ * property linearly from its value at the start time to the given values.
+ * Changes are applied on render block boundaries, and a block never crosses
+ * the start time of a statement.
+ *
+ * Scenes given on the command line are rendered on separate threads, each
+ * with its own loopback device, with the output written next to the scene
+ * file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "AL/al.h"
+#include "AL/alc.h"
+#include "AL/alext.h"
+
+#include "threads.h"
+#include "wavfile.h"
+
+#ifndef M_PI
+#define M_PI  3.14159265358979323846
+#endif
+
+#define MAX_NAME_LEN  64
+#define MAX_LINE_LEN  1024
+
+
+typedef struct Property {
+    const char *name;
+    ALenum param;
+    int count;
+    int isint;
+} Property;
+
+static const Property SourceProps[] = {
+    { "gain", AL_GAIN, 1, 0 },
+    { "pitch", AL_PITCH, 1, 0 },
+    { "reference_distance", AL_REFERENCE_DISTANCE, 1, 0 },
+    { "rolloff_factor", AL_ROLLOFF_FACTOR, 1, 0 },
+    { "max_distance", AL_MAX_DISTANCE, 1, 0 },
+    { "position", AL_POSITION, 3, 0 },
+    { "velocity", AL_VELOCITY, 3, 0 },
+    { "direction", AL_DIRECTION, 3, 0 },
+    { "looping", AL_LOOPING, 1, 1 },
+    { "relative", AL_SOURCE_RELATIVE, 1, 1 },
+    { NULL, 0, 0, 0 }
+};
+
+static const Property ListenerProps[] = {
+    { "gain", AL_GAIN, 1, 0 },
+    { "position", AL_POSITION, 3, 0 },
+    { "velocity", AL_VELOCITY, 3, 0 },
+    { "orientation", AL_ORIENTATION, 6, 0 },
+    { NULL, 0, 0, 0 }
+};
+
+enum Command {
+    CmdPlay,
+    CmdPause,
+    CmdStop,
+    CmdRewind,
+    CmdSet,
+    CmdRamp
+};
+
+typedef struct Event {
+    double Time, EndTime;
+    /* -1 for the listener, otherwise a source index. */
+    int Target;
+    enum Command Cmd;
+    const Property *Prop;
+    ALfloat Values[6];
+    ALfloat StartValues[6];
+    /* Line number, to keep the file order of statements with the same
+     * time. */
+    int Line;
+} Event;
+
+typedef struct BufferDef {
+    char Name[MAX_NAME_LEN];
+    /* Either a file to load, or a sine tone to generate. */
+    char *Filename;
+    double SineFreq, SineLength;
+} BufferDef;
+
+typedef struct SourceDef {
+    char Name[MAX_NAME_LEN];
+    int Buffer;
+} SourceDef;
+
+typedef struct Scene {
+    const char *Filename;
+    char *OutName;
+    double Length;
+
+    BufferDef *Buffers;
+    int NumBuffers;
+    SourceDef *Sources;
+    int NumSources;
+    Event *Events;
+    int NumEvents, MaxEvents;
+
+    /* Wall-clock time spent rendering, and whether it succeeded. */
+    double RenderTime;
+    int Failed;
+} Scene;
+
+
+/* Render options, shared by all scenes. */
+static ALCint OutRate = 48000;
+static ALCenum OutChannels = ALC_STEREO_SOFT;
+static ALCenum OutType = ALC_FLOAT_SOFT;
+static enum WaveFileType OutFileType = WaveFile_RIFF;
+static ALCsizei BlockSize = 1024;
+
+static LPALCLOOPBACKOPENDEVICESOFT palcLoopbackOpenDeviceSOFT;
+static LPALCRENDERSAMPLESSOFT palcRenderSamplesSOFT;
+static PFNALCSETTHREADCONTEXTPROC palcSetThreadContext;
+
+static Scene *Scenes;
+static int NumScenes;
+static int NextScene;
+static almtx_t SceneLock;
+
+
+static double GetTimeSeconds(void)
+{
+    struct timespec ts;
+    if(altimespec_get(&ts, AL_TIME_MONOTONIC) != AL_TIME_MONOTONIC &&
+       altimespec_get(&ts, AL_TIME_UTC) != AL_TIME_UTC)
+        return 0.0;
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1000000000.0;
+}
+
+static int IsBigEndian(void)
+{
+    union { unsigned int u; unsigned char b[sizeof(unsigned int)]; } test = { 1 };
+    return test.b[0] == 0;
+}
+
+static void SwapBytes(void *data, size_t bytes, unsigned int samplesize)
+{
+    unsigned char *ptr = data;
+    size_t i;
+
+    if(samplesize == 2)
+    {
+        for(i = 0;i+1 < bytes;i += 2)
+        {
+            unsigned char t = ptr[i];
+            ptr[i] = ptr[i+1];
+            ptr[i+1] = t;
+        }
+    }
+    else if(samplesize == 4)
+    {
+        for(i = 0;i+3 < bytes;i += 4)
+        {
+            unsigned char t0 = ptr[i], t1 = ptr[i+1];
+            ptr[i] = ptr[i+3];
+            ptr[i+1] = ptr[i+2];
+            ptr[i+2] = t1;
+            ptr[i+3] = t0;
+        }
+    }
+}
+
+
+static const Property *FindProperty(const Property *props, const char *name)
+{
+    for(;props->name;props++)
+    {
+        if(strcmp(props->name, name) == 0)
+            return props;
+    }
+    return NULL;
+}
+
+static int FindName(const char *name, const void *list, size_t stride, int count)
+{
+    int i;
+    for(i = 0;i < count;i++)
+    {
+        if(strcmp((const char*)list + i*stride, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int CompareEvents(const void *a, const void *b)
+{
+    const Event *ea = a, *eb = b;
+    if(ea->Time < eb->Time) return -1;
+    if(ea->Time > eb->Time) return 1;
+    return ea->Line - eb->Line;
+}
+
+static int AddEvent(Scene *scene, const Event *evt)
+{
+    if(scene->NumEvents == scene->MaxEvents)
+    {
+        int newsize = scene->MaxEvents ? scene->MaxEvents*2 : 16;
+        Event *events = realloc(scene->Events, newsize*sizeof(Event));
+        if(!events) return 0;
+        scene->Events = events;
+        scene->MaxEvents = newsize;
+    }
+    scene->Events[scene->NumEvents++] = *evt;
+    return 1;
+}
+
+/* Parses the target, command/property, and values of an 'at' or 'ramp'
+ * statement into evt. */
+static int ParseEventArgs(Scene *scene, Event *evt, char **tokens, int numtokens, int isramp)
+{
+    const Property *props;
+    int i;
+
+    if(numtokens < 2)
+        return 0;
+
+    if(strcmp(tokens[0], "listener") == 0)
+    {
+        evt->Target = -1;
+        props = ListenerProps;
+    }
+    else
+    {
+        evt->Target = FindName(tokens[0], scene->Sources, sizeof(SourceDef), scene->NumSources);
+        if(evt->Target < 0)
+        {
+            fprintf(stderr, "%s:%d: Unknown source '%s'\n", scene->Filename, evt->Line,
+                    tokens[0]);
+            return 0;
+        }
+        props = SourceProps;
+    }
+
+    evt->Prop = NULL;
+    if(!isramp && evt->Target >= 0 && numtokens == 2)
+    {
+        if(strcmp(tokens[1], "play") == 0) evt->Cmd = CmdPlay;
+        else if(strcmp(tokens[1], "pause") == 0) evt->Cmd = CmdPause;
+        else if(strcmp(tokens[1], "stop") == 0) evt->Cmd = CmdStop;
+        else if(strcmp(tokens[1], "rewind") == 0) evt->Cmd = CmdRewind;
+        else goto property;
+        return 1;
+    }
+
+property:
+    evt->Cmd = isramp ? CmdRamp : CmdSet;
+    evt->Prop = FindProperty(props, tokens[1]);
+    if(!evt->Prop)
+    {
+        fprintf(stderr, "%s:%d: Unknown command or property '%s'\n", scene->Filename,
+                evt->Line, tokens[1]);
+        return 0;
+    }
+    if(isramp && evt->Prop->isint)
+    {
+        fprintf(stderr, "%s:%d: Cannot ramp '%s'\n", scene->Filename, evt->Line,
+                tokens[1]);
+        return 0;
+    }
+    if(numtokens-2 != evt->Prop->count)
+    {
+        fprintf(stderr, "%s:%d: '%s' takes %d value(s)\n", scene->Filename, evt->Line,
+                tokens[1], evt->Prop->count);
+        return 0;
+    }
+    for(i = 0;i < evt->Prop->count;i++)
+        evt->Values[i] = (ALfloat)atof(tokens[2+i]);
+    return 1;
+}
+
+static int LoadScene(Scene *scene, const char *filename)
+{
+    char line[MAX_LINE_LEN];
+    int linenum = 0;
+    const char *ext;
+    FILE *f;
+
+    memset(scene, 0, sizeof(*scene));
+    scene->Filename = filename;
+    scene->Length = -1.0;
+
+    f = fopen(filename, "r");
+    if(!f)
+    {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return 0;
+    }
+
+    while(fgets(line, sizeof(line), f))
+    {
+        char *tokens[16];
+        int numtokens = 0;
+        char *tok, *comment;
+
+        linenum++;
+        if((comment=strchr(line, '#')) != NULL)
+            *comment = '\0';
+        tok = strtok(line, " \t\r\n");
+        while(tok && numtokens < 16)
+        {
+            tokens[numtokens++] = tok;
+            tok = strtok(NULL, " \t\r\n");
+        }
+        if(numtokens == 0)
+            continue;
+
+        if(strcmp(tokens[0], "length") == 0 && numtokens == 2)
+            scene->Length = atof(tokens[1]);
+        else if(strcmp(tokens[0], "buffer") == 0 && (numtokens == 3 || numtokens == 5))
+        {
+            BufferDef *buf;
+
+            if(numtokens == 5 && strcmp(tokens[2], "sine") != 0)
+                goto syntax_error;
+            buf = realloc(scene->Buffers, (scene->NumBuffers+1)*sizeof(BufferDef));
+            if(!buf) goto error;
+            scene->Buffers = buf;
+            buf = &scene->Buffers[scene->NumBuffers++];
+            memset(buf, 0, sizeof(*buf));
+            strncpy(buf->Name, tokens[1], MAX_NAME_LEN-1);
+            if(numtokens == 5)
+            {
+                buf->SineFreq = atof(tokens[3]);
+                buf->SineLength = atof(tokens[4]);
+            }
+            else
+            {
+                buf->Filename = malloc(strlen(tokens[2])+1);
+                if(!buf->Filename) goto error;
+                strcpy(buf->Filename, tokens[2]);
+            }
+        }
+        else if(strcmp(tokens[0], "source") == 0 && numtokens == 3)
+        {
+            SourceDef *src;
+            int bufidx = FindName(tokens[2], scene->Buffers, sizeof(BufferDef),
+                                  scene->NumBuffers);
+            if(bufidx < 0)
+            {
+                fprintf(stderr, "%s:%d: Unknown buffer '%s'\n", filename, linenum, tokens[2]);
+                goto error;
+            }
+            src = realloc(scene->Sources, (scene->NumSources+1)*sizeof(SourceDef));
+            if(!src) goto error;
+            scene->Sources = src;
+            src = &scene->Sources[scene->NumSources++];
+            memset(src, 0, sizeof(*src));
+            strncpy(src->Name, tokens[1], MAX_NAME_LEN-1);
+            src->Buffer = bufidx;
+        }
+        else if(strcmp(tokens[0], "at") == 0 && numtokens >= 3)
+        {
+            Event evt;
+            memset(&evt, 0, sizeof(evt));
+            evt.Line = linenum;
+            evt.Time = evt.EndTime = atof(tokens[1]);
+            if(!ParseEventArgs(scene, &evt, tokens+2, numtokens-2, 0) || !AddEvent(scene, &evt))
+                goto error;
+        }
+        else if(strcmp(tokens[0], "ramp") == 0 && numtokens >= 4)
+        {
+            Event evt;
+            memset(&evt, 0, sizeof(evt));
+            evt.Line = linenum;
+            evt.Time = atof(tokens[1]);
+            evt.EndTime = atof(tokens[2]);
+            if(!(evt.EndTime > evt.Time))
+            {
+                fprintf(stderr, "%s:%d: Ramp must end after it starts\n", filename, linenum);
+                goto error;
+            }
+            if(!ParseEventArgs(scene, &evt, tokens+3, numtokens-3, 1) || !AddEvent(scene, &evt))
+                goto error;
+        }
+        else
+            goto syntax_error;
+    }
+    fclose(f);
+
+    if(!(scene->Length > 0.0))
+    {
+        fprintf(stderr, "%s: Missing or invalid scene length\n", filename);
+        return 0;
+    }
+    if(scene->NumEvents > 1)
+        qsort(scene->Events, scene->NumEvents, sizeof(Event), CompareEvents);
+
+    ext = strrchr(filename, '.');
+    if(!ext || strchr(ext, '/') || strchr(ext, '\\'))
+        ext = filename + strlen(filename);
+    scene->OutName = malloc((ext-filename) + 5);
+    if(!scene->OutName)
+        return 0;
+    memcpy(scene->OutName, filename, ext-filename);
+    strcpy(scene->OutName + (ext-filename), (OutFileType==WaveFile_W64) ? ".w64" : ".wav");
+
+    return 1;
+
+syntax_error:
+    fprintf(stderr, "%s:%d: Syntax error\n", filename, linenum);
+error:
+    fclose(f);
+    return 0;
+}
+
+static void FreeScene(Scene *scene)
+{
+    int i;
+    for(i = 0;i < scene->NumBuffers;i++)
+        free(scene->Buffers[i].Filename);
+    free(scene->Buffers);
+    free(scene->Sources);
+    free(scene->Events);
+    free(scene->OutName);
+}
+
+
+static unsigned int ReadLE(const unsigned char *data, int bytes)
+{
+    unsigned int ret = 0;
+    while(bytes-- > 0)
+        ret = (ret<<8) | data[bytes];
+    return ret;
+}
+
+/* Loads a PCM (8- or 16-bit) or 32-bit float mono or stereo WAV file into the
+ * given buffer. */
+static int LoadWaveFile(ALuint buffer, const char *filename)
+{
+    unsigned char header[12], chunk[8], fmt[40];
+    unsigned int fmttag=0, channels=0, rate=0, bits=0;
+    unsigned char *data = NULL;
+    unsigned int datalen = 0;
+    ALenum format = AL_NONE;
+    FILE *f;
+
+    f = fopen(filename, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "Failed to open %s\n", filename);
+        return 0;
+    }
+
+    if(fread(header, 1, 12, f) != 12 || memcmp(header, "RIFF", 4) != 0 ||
+       memcmp(header+8, "WAVE", 4) != 0)
+        goto bad_file;
+
+    while(fread(chunk, 1, 8, f) == 8)
+    {
+        unsigned int len = ReadLE(chunk+4, 4);
+        unsigned int pad = len&1;
+
+        if(memcmp(chunk, "fmt ", 4) == 0 && len >= 16)
+        {
+            unsigned int toread = (len < sizeof(fmt)) ? len : (unsigned int)sizeof(fmt);
+            if(fread(fmt, 1, toread, f) != toread)
+                goto bad_file;
+            fmttag = ReadLE(fmt, 2);
+            channels = ReadLE(fmt+2, 2);
+            rate = ReadLE(fmt+4, 4);
+            bits = ReadLE(fmt+14, 2);
+            /* For WAVE_FORMAT_EXTENSIBLE, the sub-type starts with the tag. */
+            if(fmttag == 0xFFFE && toread >= 26)
+                fmttag = ReadLE(fmt+24, 2);
+            len -= toread;
+        }
+        else if(memcmp(chunk, "data", 4) == 0 && !data)
+        {
+            data = malloc(len ? len : 1);
+            if(!data) goto bad_file;
+            datalen = (unsigned int)fread(data, 1, len, f);
+            len -= datalen;
+        }
+        fseek(f, (long)(len + pad), SEEK_CUR);
+    }
+    fclose(f);
+    f = NULL;
+
+    if(fmttag == 1 && bits == 8)
+        format = (channels==1) ? AL_FORMAT_MONO8 : (channels==2) ? AL_FORMAT_STEREO8 : AL_NONE;
+    else if(fmttag == 1 && bits == 16)
+        format = (channels==1) ? AL_FORMAT_MONO16 : (channels==2) ? AL_FORMAT_STEREO16 : AL_NONE;
+    else if(fmttag == 3 && bits == 32 && alIsExtensionPresent("AL_EXT_FLOAT32"))
+        format = (channels==1) ? AL_FORMAT_MONO_FLOAT32 :
+                 (channels==2) ? AL_FORMAT_STEREO_FLOAT32 : AL_NONE;
+    if(format == AL_NONE || !data || rate == 0)
+    {
+        fprintf(stderr, "%s: Unsupported format (tag 0x%04x, %u channels, %u bits)\n",
+                filename, fmttag, channels, bits);
+        free(data);
+        return 0;
+    }
+
+    if(IsBigEndian())
+        SwapBytes(data, datalen, bits/8);
+    datalen -= datalen % (channels*bits/8);
+    alBufferData(buffer, format, data, (ALsizei)datalen, (ALsizei)rate);
+    free(data);
+    return alGetError() == AL_NO_ERROR;
+
+bad_file:
+    fprintf(stderr, "%s: Invalid or unreadable WAV file\n", filename);
+    free(data);
+    if(f) fclose(f);
+    return 0;
+}
+
+static int GenerateSine(ALuint buffer, double freq, double length)
+{
+    ALsizei count = (ALsizei)(length * OutRate);
+    ALshort *data;
+    ALsizei i;
+
+    if(count <= 0)
+        return 0;
+    data = malloc(count * sizeof(ALshort));
+    if(!data) return 0;
+    for(i = 0;i < count;i++)
+        data[i] = (ALshort)(sin(i * freq * 2.0*M_PI / OutRate) * 32767.0 * 0.5);
+    alBufferData(buffer, AL_FORMAT_MONO16, data, count*sizeof(ALshort), OutRate);
+    free(data);
+    return alGetError() == AL_NO_ERROR;
+}
+
+
+static void StartEvent(Event *evt, const ALuint *sources)
+{
+    ALint ivals[6];
+    int i;
+
+    if(evt->Cmd == CmdRamp)
+    {
+        if(evt->Target < 0)
+            alGetListenerfv(evt->Prop->param, evt->StartValues);
+        else
+            alGetSourcefv(sources[evt->Target], evt->Prop->param, evt->StartValues);
+        return;
+    }
+    if(evt->Cmd != CmdSet)
+    {
+        ALuint source = sources[evt->Target];
+        switch(evt->Cmd)
+        {
+            case CmdPlay: alSourcePlay(source); break;
+            case CmdPause: alSourcePause(source); break;
+            case CmdStop: alSourceStop(source); break;
+            case CmdRewind: alSourceRewind(source); break;
+            case CmdSet: case CmdRamp: break;
+        }
+        return;
+    }
+
+    if(evt->Prop->isint)
+    {
+        for(i = 0;i < evt->Prop->count;i++)
+            ivals[i] = (ALint)evt->Values[i];
+        alSourceiv(sources[evt->Target], evt->Prop->param, ivals);
+    }
+    else if(evt->Target < 0)
+        alListenerfv(evt->Prop->param, evt->Values);
+    else
+        alSourcefv(sources[evt->Target], evt->Prop->param, evt->Values);
+}
+
+static void UpdateRamp(const Event *evt, const ALuint *sources, double now)
+{
+    ALfloat vals[6];
+    double mu;
+    int i;
+
+    mu = (now - evt->Time) / (evt->EndTime - evt->Time);
+    if(mu > 1.0) mu = 1.0;
+    for(i = 0;i < evt->Prop->count;i++)
+        vals[i] = (ALfloat)(evt->StartValues[i] + (evt->Values[i]-evt->StartValues[i])*mu);
+
+    if(evt->Target < 0)
+        alListenerfv(evt->Prop->param, vals);
+    else
+        alSourcefv(sources[evt->Target], evt->Prop->param, vals);
+}
+
+static int RenderScene(Scene *scene)
+{
+    ALCint attrs[] = {
+        ALC_FORMAT_CHANNELS_SOFT, OutChannels,
+        ALC_FORMAT_TYPE_SOFT, OutType,
+        ALC_FREQUENCY, OutRate,
+        0
+    };
+    ALuint *buffers = NULL, *sources = NULL;
+    Event **ramps = NULL;
+    int numramps = 0;
+    ALCdevice *device = NULL;
+    ALCcontext *context = NULL;
+    void *samples = NULL;
+    FILE *outfile = NULL;
+    WaveFormat fmt;
+    long long datastart;
+    ALuint64SOFT total, done;
+    unsigned int framesize;
+    int nextevt = 0;
+    int ret = 0;
+    int i;
+
+    fmt.Channels = (OutChannels == ALC_MONO_SOFT) ? 1 : (OutChannels == ALC_STEREO_SOFT) ? 2 :
+                   (OutChannels == ALC_QUAD_SOFT) ? 4 : (OutChannels == ALC_5POINT1_SOFT) ? 6 :
+                   (OutChannels == ALC_6POINT1_SOFT) ? 7 : 8;
+    fmt.ChannelMask = (OutChannels == ALC_MONO_SOFT) ? 0x04 :
+                      (OutChannels == ALC_STEREO_SOFT) ? 0x01 | 0x02 :
+                      (OutChannels == ALC_QUAD_SOFT) ? 0x01 | 0x02 | 0x10 | 0x20 :
+                      (OutChannels == ALC_5POINT1_SOFT) ? 0x01 | 0x02 | 0x04 | 0x08 | 0x200 | 0x400 :
+                      (OutChannels == ALC_6POINT1_SOFT) ? 0x01 | 0x02 | 0x04 | 0x08 | 0x100 | 0x200 | 0x400 :
+                      0x01 | 0x02 | 0x04 | 0x08 | 0x010 | 0x020 | 0x200 | 0x400;
+    fmt.Bits = (OutType == ALC_SHORT_SOFT) ? 16 : 32;
+    fmt.IsFloat = (OutType == ALC_FLOAT_SOFT);
+    fmt.IsBFormat = 0;
+    fmt.SampleRate = (unsigned int)OutRate;
+    framesize = fmt.Channels * fmt.Bits / 8;
+
+    device = palcLoopbackOpenDeviceSOFT(NULL);
+    if(!device)
+    {
+        fprintf(stderr, "%s: Failed to open loopback device\n", scene->Filename);
+        return 0;
+    }
+    context = alcCreateContext(device, attrs);
+    if(!context || !palcSetThreadContext(context))
+    {
+        fprintf(stderr, "%s: Failed to set up the render context\n", scene->Filename);
+        goto done;
+    }
+
+    buffers = calloc(scene->NumBuffers+1, sizeof(ALuint));
+    sources = calloc(scene->NumSources+1, sizeof(ALuint));
+    ramps = calloc(scene->NumEvents+1, sizeof(Event*));
+    samples = malloc((size_t)BlockSize * framesize);
+    if(!buffers || !sources || !ramps || !samples)
+        goto done;
+
+    alGenBuffers(scene->NumBuffers, buffers);
+    for(i = 0;i < scene->NumBuffers;i++)
+    {
+        const BufferDef *def = &scene->Buffers[i];
+        if(!(def->Filename ? LoadWaveFile(buffers[i], def->Filename) :
+                             GenerateSine(buffers[i], def->SineFreq, def->SineLength)))
+        {
+            fprintf(stderr, "%s: Failed to load buffer '%s'\n", scene->Filename, def->Name);
+            goto done;
+        }
+    }
+    alGenSources(scene->NumSources, sources);
+    for(i = 0;i < scene->NumSources;i++)
+        alSourcei(sources[i], AL_BUFFER, (ALint)buffers[scene->Sources[i].Buffer]);
+    if(alGetError() != AL_NO_ERROR)
+    {
+        fprintf(stderr, "%s: Failed to set up sources\n", scene->Filename);
+        goto done;
+    }
+
+    outfile = fopen(scene->OutName, "wb");
+    if(!outfile)
+    {
+        fprintf(stderr, "Failed to create %s\n", scene->OutName);
+        goto done;
+    }
+    datastart = WriteWaveHeader(outfile, OutFileType, &fmt);
+    if(datastart < 0)
+    {
+        fprintf(stderr, "%s: Failed to write header\n", scene->OutName);
+        goto done;
+    }
+
+    total = (ALuint64SOFT)(scene->Length*OutRate + 0.5);
+    done = 0;
+    while(done < total)
+    {
+        double now = (double)done / OutRate;
+        ALuint64SOFT todo;
+
+        while(nextevt < scene->NumEvents && scene->Events[nextevt].Time <= now)
+        {
+            Event *evt = &scene->Events[nextevt++];
+            StartEvent(evt, sources);
+            if(evt->Cmd == CmdRamp)
+                ramps[numramps++] = evt;
+        }
+        for(i = 0;i < numramps;)
+        {
+            UpdateRamp(ramps[i], sources, now);
+            if(ramps[i]->EndTime <= now)
+                ramps[i] = ramps[--numramps];
+            else
+                i++;
+        }
+
+        todo = total - done;
+        if(todo > (ALuint64SOFT)BlockSize)
+            todo = BlockSize;
+        /* Don't render past the start of the next statement, or too far into
+         * an active ramp. */
+        if(nextevt < scene->NumEvents)
+        {
+            ALuint64SOFT next = (ALuint64SOFT)ceil(scene->Events[nextevt].Time * OutRate);
+            if(next > done && next-done < todo)
+                todo = next - done;
+        }
+
+        palcRenderSamplesSOFT(device, samples, (ALCsizei)todo);
+        if(IsBigEndian())
+            SwapBytes(samples, (size_t)todo*framesize, fmt.Bits/8);
+        if(fwrite(samples, framesize, (size_t)todo, outfile) != todo)
+        {
+            fprintf(stderr, "%s: Write error\n", scene->OutName);
+            goto done;
+        }
+        done += todo;
+    }
+    FinishWaveFile(outfile, OutFileType, datastart);
+    ret = 1;
+
+done:
+    if(outfile)
+        fclose(outfile);
+    if(context)
+    {
+        if(sources) alDeleteSources(scene->NumSources, sources);
+        if(buffers) alDeleteBuffers(scene->NumBuffers, buffers);
+        palcSetThreadContext(NULL);
+        alcDestroyContext(context);
+    }
+    alcCloseDevice(device);
+    free(samples);
+    free(ramps);
+    free(sources);
+    free(buffers);
+    return ret;
+}
+
+static int RenderThread(void *arg)
+{
+    (void)arg;
+    while(1)
+    {
+        Scene *scene;
+        double start;
+
+        almtx_lock(&SceneLock);
+        scene = (NextScene < NumScenes) ? &Scenes[NextScene++] : NULL;
+        almtx_unlock(&SceneLock);
+        if(!scene) break;
+
+        start = GetTimeSeconds();
+        scene->Failed = !RenderScene(scene);
+        scene->RenderTime = GetTimeSeconds() - start;
+    }
+    return 0;
+}
+
+
+static void PrintUsage(const char *name)
+{
+    printf("Usage: %s [options] <scene files...>\n\n"
+           "Options:\n"
+           "  -r <rate>       Output sample rate (default 48000)\n"
+           "  -c <channels>   Output channels: mono, stereo, quad, 5.1, 6.1, 7.1\n"
+           "                  (default stereo)\n"
+           "  -t <type>       Output sample type: short, int, float (default float)\n"
+           "  -w64            Write Sony Wave64 files instead of RIFF WAVE\n"
+           "  -rf64           Write RF64 files instead of RIFF WAVE\n"
+           "  -b <frames>     Render block size (default 1024)\n"
+           "  -j <threads>    Number of scenes to render at once (default 1)\n",
+           name);
+}
+
+int main(int argc, char *argv[])
+{
+    althrd_t *threads;
+    int numthreads = 1;
+    double start, elapsed, audiotime;
+    int failed = 0;
+    int i;
+
+    for(i = 1;i < argc && argv[i][0] == '-';i++)
+    {
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+        {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[i], "-w64") == 0)
+        {
+            OutFileType = WaveFile_W64;
+            continue;
+        }
+        if(strcmp(argv[i], "-rf64") == 0)
+        {
+            OutFileType = WaveFile_RF64;
+            continue;
+        }
+        if(i+1 >= argc)
+        {
+            fprintf(stderr, "Missing argument for %s\n", argv[i]);
+            return 1;
+        }
+        if(strcmp(argv[i], "-r") == 0)
+            OutRate = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-b") == 0)
+            BlockSize = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-j") == 0)
+            numthreads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-c") == 0)
+        {
+            const char *chans = argv[++i];
+            if(strcmp(chans, "mono") == 0) OutChannels = ALC_MONO_SOFT;
+            else if(strcmp(chans, "stereo") == 0) OutChannels = ALC_STEREO_SOFT;
+            else if(strcmp(chans, "quad") == 0) OutChannels = ALC_QUAD_SOFT;
+            else if(strcmp(chans, "5.1") == 0) OutChannels = ALC_5POINT1_SOFT;
+            else if(strcmp(chans, "6.1") == 0) OutChannels = ALC_6POINT1_SOFT;
+            else if(strcmp(chans, "7.1") == 0) OutChannels = ALC_7POINT1_SOFT;
+            else
+            {
+                fprintf(stderr, "Unknown channel configuration: %s\n", chans);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-t") == 0)
+        {
+            const char *type = argv[++i];
+            if(strcmp(type, "short") == 0) OutType = ALC_SHORT_SOFT;
+            else if(strcmp(type, "int") == 0) OutType = ALC_INT_SOFT;
+            else if(strcmp(type, "float") == 0) OutType = ALC_FLOAT_SOFT;
+            else
+            {
+                fprintf(stderr, "Unknown sample type: %s\n", type);
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(i >= argc)
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if(OutRate <= 0 || BlockSize <= 0 || numthreads <= 0)
+    {
+        fprintf(stderr, "Invalid rate, block size, or thread count\n");
+        return 1;
+    }
+
+    if(!alcIsExtensionPresent(NULL, "ALC_SOFT_loopback") ||
+       !alcIsExtensionPresent(NULL, "ALC_EXT_thread_local_context"))
+    {
+        fprintf(stderr, "Loopback or thread-local context support is missing\n");
+        return 1;
+    }
+    palcLoopbackOpenDeviceSOFT = (LPALCLOOPBACKOPENDEVICESOFT)
+        alcGetProcAddress(NULL, "alcLoopbackOpenDeviceSOFT");
+    palcRenderSamplesSOFT = (LPALCRENDERSAMPLESSOFT)alcGetProcAddress(NULL, "alcRenderSamplesSOFT");
+    palcSetThreadContext = (PFNALCSETTHREADCONTEXTPROC)
+        alcGetProcAddress(NULL, "alcSetThreadContext");
+
+    NumScenes = argc - i;
+    Scenes = calloc(NumScenes, sizeof(Scene));
+    if(!Scenes) return 1;
+    for(NextScene = 0;NextScene < NumScenes;NextScene++)
+    {
+        if(!LoadScene(&Scenes[NextScene], argv[i+NextScene]))
+            return 1;
+    }
+    NextScene = 0;
+
+    if(numthreads > NumScenes)
+        numthreads = NumScenes;
+    threads = calloc(numthreads, sizeof(althrd_t));
+    if(!threads) return 1;
+    almtx_init(&SceneLock, almtx_plain);
+
+    start = GetTimeSeconds();
+    for(i = 0;i < numthreads;i++)
+    {
+        if(althrd_create(&threads[i], RenderThread, NULL) != althrd_success)
+        {
+            fprintf(stderr, "Failed to start render thread\n");
+            numthreads = i;
+            break;
+        }
+    }
+    /* Render on this thread too if none could be started. */
+    if(numthreads == 0)
+        RenderThread(NULL);
+    for(i = 0;i < numthreads;i++)
+    {
+        int res;
+        althrd_join(threads[i], &res);
+    }
+    elapsed = GetTimeSeconds() - start;
+
+    audiotime = 0.0;
+    for(i = 0;i < NumScenes;i++)
+    {
+        const Scene *scene = &Scenes[i];
+        if(scene->Failed)
+        {
+            printf("%s: failed\n", scene->Filename);
+            failed = 1;
+            continue;
+        }
+        printf("%s -> %s: %.3fs rendered in %.3fs (%.1fx realtime)\n", scene->Filename,
+               scene->OutName, scene->Length, scene->RenderTime,
+               (scene->RenderTime > 0.0) ? scene->Length/scene->RenderTime : 0.0);
+        audiotime += scene->Length;
+    }
+    printf("Total: %.3fs rendered in %.3fs on %d thread%s (%.1fx realtime)\n", audiotime,
+           elapsed, numthreads, (numthreads==1) ? "" : "s",
+           (elapsed > 0.0) ? audiotime/elapsed : 0.0);
+
+    almtx_destroy(&SceneLock);
+    free(threads);
+    for(i = 0;i < NumScenes;i++)
+        FreeScene(&Scenes[i]);
+    free(Scenes);
+
+    return failed;
+}